@@ -0,0 +1,232 @@
+#include "updater.hpp"
+#include "applyplan.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
+
+#ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+    #define NOMINMAX
+#endif
+#include <windows.h>
+
+/*
+ * GRUpdaterApply:
+ * Lean "GRUpdaterCmd apply" started by RequestApplyUpdate(..., ApplyMode::Lean) while the application is down.
+ * Only std and the OS are linked (no GRUpdater library, TLS, zip, JSON nor CLI11) so the start is short,
+ * the files to copy and to keep come from the apply plan written by RequestApplyUpdate() just before the launch.
+ */
+
+namespace
+{
+
+struct ApplyOptions
+{
+    std::filesystem::path _target;
+    std::filesystem::path _caller;
+    uint32_t _pid{0};
+};
+
+//Messages go to the console like the default sink of the Logger
+void Print(bool error, std::string_view message)
+{
+    auto* stream = error ? stderr : stdout;
+    std::fwrite(message.data(), 1, message.size(), stream);
+    std::fputc('\n', stream);
+}
+void Print(bool error, std::string_view message, std::filesystem::path const& path)
+{
+    auto const str = path.u8string();
+    std::string line{message};
+    line.append(str.begin(), str.end());
+    Print(error, line);
+}
+
+std::optional<ApplyOptions> ParseArguments(int argc, char** argv)
+{
+    ApplyOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view const argument = argv[i];
+        if (argument == "--version")
+        {
+            Print(false, "GRUpdaterApply " GRUPDATER_TAG_STR);
+            std::exit(0);
+        }
+        if (i + 1 == argc)
+        {
+            return std::nullopt;
+        }
+
+        std::string_view const value = argv[++i];
+        if (argument == "-t" || argument == "--target")
+        {
+            options._target = value;
+        }
+        else if (argument == "--caller")
+        {
+            options._caller = value;
+        }
+        else if (argument == "--pid")
+        {
+            auto const [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options._pid);
+            if (ec != std::errc{} || ptr != value.data() + value.size())
+            {
+                return std::nullopt;
+            }
+        }
+        else
+        {
+            return std::nullopt;
+        }
+    }
+    if (options._target.empty())
+    {
+        return std::nullopt;
+    }
+    return options;
+}
+
+bool WaitCaller(uint32_t pid)
+{
+    HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (hProcess == nullptr)
+    {
+        Print(true, "Failed to open process " + std::to_string(pid));
+        return true;
+    }
+    DWORD ret = WaitForSingleObject(hProcess, GRUPDATER_WAIT_PID_TIMEOUT_MS);
+    CloseHandle(hProcess);
+    if (ret != WAIT_OBJECT_0)
+    {
+        Print(true, "Failed to wait for process " + std::to_string(pid));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Apply:
+ * Same work as ApplyFiles: the regular files of target are removed unless kept by the plan,
+ * then the files of the plan are copied from source (a kept dynamic file already in target is left untouched).
+ */
+bool Apply(updater::ApplyPlan const& plan, std::filesystem::path const& source, std::filesystem::path const& target)
+{
+    std::error_code errorCode;
+    std::vector<std::filesystem::path> removedFiles;
+    std::filesystem::recursive_directory_iterator it(target, errorCode);
+    for (; !errorCode && it != std::filesystem::recursive_directory_iterator{}; it.increment(errorCode))
+    {
+        std::error_code statusError;
+        if (it->is_regular_file(statusError)
+            && !updater::IsKept(plan._keep, it->path().lexically_relative(target).lexically_normal()))
+        {
+            removedFiles.push_back(it->path());
+        }
+    }
+    if (errorCode)
+    {
+        Print(true, "Failed to list the files of ", target);
+        return false;
+    }
+    for (auto const& file : removedFiles)
+    {
+        if (!std::filesystem::remove(file, errorCode) && errorCode)
+        {
+            Print(true, "Failed to remove file ", file);
+            return false;
+        }
+    }
+
+    for (auto const& file : plan._copy)
+    {
+        auto const resultFilePath = target / file;
+        if (std::filesystem::exists(resultFilePath, errorCode))
+        {//A kept dynamic file
+            continue;
+        }
+        std::filesystem::create_directories(resultFilePath.parent_path(), errorCode);
+        if (errorCode || !std::filesystem::copy_file(source / file, resultFilePath, errorCode))
+        {
+            Print(true, "Failed to copy file ", source / file);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LaunchCaller(std::filesystem::path const& callerExecutable)
+{
+    std::wstring callerExecutableW = callerExecutable.wstring();
+    STARTUPINFOW si{};
+    si.cb = sizeof(si);
+    PROCESS_INFORMATION pi{};
+    if (!CreateProcessW(callerExecutableW.c_str(), nullptr,
+        nullptr, nullptr, FALSE,
+        CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS, nullptr,
+        callerExecutable.parent_path().wstring().c_str(), &si, &pi))
+    {
+        return false;
+    }
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return true;
+}
+
+}//namespace
+
+int main(int argc, char** argv)
+{
+    auto const options = ParseArguments(argc, argv);
+    if (!options)
+    {
+        Print(true, "Usage: " GRUPDATER_APPLY_EXECUTABLE_NAME " --target <absolute directory> [--pid <caller pid>] [--caller <caller executable>]");
+        return 1;
+    }
+
+    //Wait for the caller to close
+    if (options->_pid != 0 && !WaitCaller(options->_pid))
+    {
+        return 1;
+    }
+    //The application is down from here until the files are copied
+    auto const downtimeBegin = std::chrono::steady_clock::now();
+
+    std::error_code errorCode;
+    if (!options->_target.is_absolute() || !std::filesystem::is_directory(options->_target, errorCode))
+    {
+        Print(true, "Invalid target path");
+        return 1;
+    }
+
+    //The plan is in the extracted root, the working directory set by RequestApplyUpdate
+    auto const source = std::filesystem::current_path(errorCode);
+    auto const plan = updater::ReadApplyPlan(source / GRUPDATER_APPLY_PLAN_FILE);
+    if (errorCode || !plan)
+    {
+        Print(true, "Failed to read the apply plan written by RequestApplyUpdate()");
+        return 1;
+    }
+
+    Print(false, "Applying update to ", options->_target);
+    if (!Apply(*plan, source, options->_target))
+    {
+        Print(true, "Failed to apply update");
+        return 1;
+    }
+    auto const downtime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - downtimeBegin);
+    Print(false, "Successfully applied update (" + std::to_string(plan->_copy.size()) + " files in "
+                 + std::to_string(downtime.count()) + " ms)");
+
+    if (!options->_caller.empty())
+    {
+        Print(false, "Caller executable: ", options->_caller);
+        if (!LaunchCaller(options->_caller))
+        {
+            Print(true, "Failed to create process");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "applyplan.hpp"
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+namespace updater
+{
+
+namespace
+{
+
+constexpr std::string_view PlanHeader = "GRUpdaterApplyPlan ";
+constexpr std::string_view KeepPrefix = "keep ";
+constexpr std::string_view CopyPrefix = "copy ";
+static_assert(KeepPrefix.size() == CopyPrefix.size());
+
+std::string ToUtf8(std::filesystem::path const& path)
+{
+    auto const str = path.generic_u8string();
+    return {str.begin(), str.end()};
+}
+std::filesystem::path FromUtf8(std::string_view str)
+{
+    return std::filesystem::path{std::u8string{str.begin(), str.end()}}.lexically_normal();
+}
+
+//A relative path without "..", that can be written on one line
+bool IsPlanPath(std::filesystem::path const& path)
+{
+    if (path.empty() || path.has_root_path())
+    {
+        return false;
+    }
+    if (std::ranges::find(path, std::filesystem::path{".."}) != path.end())
+    {
+        return false;
+    }
+    auto const str = ToUtf8(path);
+    return str.find_first_of("\r\n") == std::string::npos;
+}
+
+}//namespace
+
+bool WriteApplyPlan(ApplyPlan const& plan, std::filesystem::path const& planFile)
+{
+    std::ofstream file(planFile, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << PlanHeader << GRUPDATER_APPLY_PLAN_VERSION << '\n';
+    auto const writeEntries = [&file](std::string_view prefix, std::vector<std::filesystem::path> const& paths) {
+        for (auto const& path : paths)
+        {
+            auto const normalPath = path.lexically_normal();
+            if (!IsPlanPath(normalPath))
+            {
+                return false;
+            }
+            file << prefix << ToUtf8(normalPath) << '\n';
+        }
+        return true;
+    };
+    if (!writeEntries(KeepPrefix, plan._keep) || !writeEntries(CopyPrefix, plan._copy))
+    {
+        return false;
+    }
+    file.close();
+    return !file.fail();
+}
+std::optional<ApplyPlan> ReadApplyPlan(std::filesystem::path const& planFile)
+{
+    std::ifstream file(planFile, std::ios::binary);
+    if (!file.is_open())
+    {
+        return std::nullopt;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != std::string{PlanHeader} + std::to_string(GRUPDATER_APPLY_PLAN_VERSION))
+    {
+        return std::nullopt;
+    }
+
+    ApplyPlan plan;
+    while (std::getline(file, line))
+    {
+        std::string_view entry{line};
+        auto* paths = entry.starts_with(KeepPrefix) ? &plan._keep : (entry.starts_with(CopyPrefix) ? &plan._copy : nullptr);
+        if (paths == nullptr)
+        {
+            return std::nullopt;
+        }
+        auto path = FromUtf8(entry.substr(KeepPrefix.size()));
+        if (!IsPlanPath(path))
+        {
+            return std::nullopt;
+        }
+        paths->push_back(std::move(path));
+    }
+    if (file.bad())
+    {
+        return std::nullopt;
+    }
+    return plan;
+}
+
+bool IsKept(std::vector<std::filesystem::path> const& keep, std::filesystem::path path)
+{
+    while (!path.empty())
+    {
+        if (std::ranges::find(keep, path) != keep.end())
+        {
+            return true;
+        }
+        path = path.parent_path();
+    }
+    return false;
+}
+
+}//namespace updater
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+//Only std and the OS here, this part is also built into the lean GRUpdaterApply executable
+
+#define GRUPDATER_APPLY_PLAN_FILE "./applyPlan.txt"
+#define GRUPDATER_APPLY_PLAN_VERSION 1
+
+namespace updater
+{
+
+/*
+ * ApplyPlan:
+ * Work of the apply step prepared by RequestApplyUpdate (PrepareApply), so the process running while the application
+ * is down doesn't parse JSON nor walk the extracted files. Written in the extracted root as UTF-8 lines:
+ * the header "GRUpdaterApplyPlan <version>", then one "keep <path>" or "copy <path>" by entry.
+ */
+struct ApplyPlan
+{
+    std::vector<std::filesystem::path> _keep; //Relative to the target, the files and directories never removed
+    std::vector<std::filesystem::path> _copy; //Relative to the extracted root, the regular files copied into the target
+};
+
+[[nodiscard]] bool WriteApplyPlan(ApplyPlan const& plan, std::filesystem::path const& planFile);
+//nullopt if missing, of another version or malformed
+[[nodiscard]] std::optional<ApplyPlan> ReadApplyPlan(std::filesystem::path const& planFile);
+
+//True if path (relative to the target) is a kept entry or below one
+[[nodiscard]] bool IsKept(std::vector<std::filesystem::path> const& keep, std::filesystem::path path);
+
+}//namespace updater
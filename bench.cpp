@@ -0,0 +1,599 @@
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.h"
+#include "updater.hpp"
+#include "mockgithub.hpp"
+#include "json.hpp"
+#include "CLI11.hpp"
+#include <zip.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <numeric>
+#include <cmath>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct ZipEntry
+{
+    std::string _name;
+    std::string _data;
+    bool _compress{true};
+};
+
+/* Name: ZipProfile
+ * Description: A synthetic release asset, every entry is inside the "app/" root directory
+ */
+struct ZipProfile
+{
+    std::string _name;
+    std::vector<ZipEntry> _entries;
+
+    [[nodiscard]] uint64_t getSize() const
+    {
+        return std::accumulate(this->_entries.begin(), this->_entries.end(), uint64_t{0}, [](uint64_t size, ZipEntry const& entry) {
+            return size + entry._data.size();
+        });
+    }
+};
+
+struct BenchOptions
+{
+    unsigned int _iterations{5};
+    double _scale{1.0};
+    std::string _filter;
+    unsigned int _latency{0}; //Milliseconds injected by the mock GitHub server
+};
+
+std::string RandomData(std::mt19937_64& random, std::size_t size)
+{
+    std::string data(size, '\0');
+    for (std::size_t i = 0; i < size; i += sizeof(uint64_t))
+    {
+        auto const value = random();
+        std::memcpy(data.data() + i, &value, std::min(sizeof(value), size - i));
+    }
+    return data;
+}
+//Compressible data (repeated lines of text)
+std::string TextData(std::size_t size)
+{
+    static constexpr std::string_view Line = "GRUpdater synthetic payload line, the quick brown fox jumps over the lazy dog 0123456789\n";
+    std::string data;
+    data.reserve(size + Line.size());
+    while (data.size() < size)
+    {
+        data.append(Line);
+    }
+    data.resize(size);
+    return data;
+}
+
+std::size_t Scaled(std::size_t value, double scale)
+{
+    return std::max<std::size_t>(1, static_cast<std::size_t>(static_cast<double>(value) * scale));
+}
+
+std::vector<ZipProfile> MakeProfiles(double scale)
+{
+    std::mt19937_64 random{42};
+    std::vector<ZipProfile> profiles;
+
+    //Many tiny compressible files, the per-entry cost dominates
+    auto& tiny = profiles.emplace_back(ZipProfile{"tinyFiles", {}});
+    for (std::size_t i = 0; i < Scaled(5000, scale); ++i)
+    {
+        tiny._entries.push_back({"app/dir" + std::to_string(i % 50) + "/file" + std::to_string(i) + ".txt", TextData(1024), true});
+    }
+
+    //Few huge incompressible files, the bandwidth dominates
+    auto& huge = profiles.emplace_back(ZipProfile{"hugeFiles", {}});
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        huge._entries.push_back({"app/data" + std::to_string(i) + ".bin", RandomData(random, Scaled(16 * 1024 * 1024, scale)), false});
+    }
+
+    //Stored, deflated text and deflated random (incompressible) entries
+    auto& mixed = profiles.emplace_back(ZipProfile{"mixed", {}});
+    for (std::size_t i = 0; i < Scaled(300, scale); ++i)
+    {
+        auto const name = "app/mixed/file" + std::to_string(i);
+        switch (i % 3)
+        {
+        case 0:
+            mixed._entries.push_back({name + ".bin", RandomData(random, 256 * 1024), false});
+            break;
+        case 1:
+            mixed._entries.push_back({name + ".txt", TextData(256 * 1024), true});
+            break;
+        default:
+            mixed._entries.push_back({name + ".dat", RandomData(random, 64 * 1024), true});
+            break;
+        }
+    }
+
+    return profiles;
+}
+
+bool WriteZip(std::filesystem::path const& zipPath, ZipProfile const& profile)
+{
+    int err = 0;
+    auto* zip = zip_open(zipPath.string().c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
+    if (zip == nullptr)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to create zip archive " << zipPath;
+        return false;
+    }
+
+    //The buffers are read by zip_close(), profile outlives it
+    for (auto const& entry : profile._entries)
+    {
+        auto* source = zip_source_buffer(zip, entry._data.data(), entry._data.size(), 0);
+        if (source == nullptr)
+        {
+            zip_discard(zip);
+            return false;
+        }
+        auto const index = zip_file_add(zip, entry._name.c_str(), source, ZIP_FL_OVERWRITE);
+        if (index < 0)
+        {
+            zip_source_free(source);
+            zip_discard(zip);
+            return false;
+        }
+        zip_set_file_compression(zip, static_cast<zip_uint64_t>(index), entry._compress ? ZIP_CM_DEFLATE : ZIP_CM_STORE, 0);
+    }
+
+    if (zip_close(zip) != 0)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to write zip archive " << zipPath << ": " << zip_error_strerror(zip_get_error(zip));
+        zip_discard(zip);
+        return false;
+    }
+    return true;
+}
+
+//Write the files of the profile as an installed (or extracted) tree under root
+bool WriteTree(updater::FileSystem& fileSystem, std::filesystem::path const& root, ZipProfile const& profile)
+{
+    auto const writeFile = [&fileSystem](std::filesystem::path const& path, std::string_view data) {
+        if (!fileSystem.createDirectories(path.parent_path()))
+        {
+            return false;
+        }
+        auto const file = fileSystem.openWrite(path);
+        return file && file->write(data.data(), data.size()) && file->close();
+    };
+    for (auto const& entry : profile._entries)
+    {
+        if (!writeFile(root / std::filesystem::path{entry._name}.lexically_relative("app"), entry._data))
+        {
+            return false;
+        }
+    }
+    return writeFile(root / GRUPDATER_EXECUTABLE_NAME, "GRUpdater");
+}
+
+//Nearest rank percentile of sorted values
+double Percentile(std::vector<double> const& sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    auto const rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+nlohmann::json Distribution(std::vector<double> values)
+{
+    std::ranges::sort(values);
+    auto const mean = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    return {{"min", values.empty() ? 0.0 : values.front()},
+            {"p50", Percentile(values, 50)},
+            {"p90", Percentile(values, 90)},
+            {"p99", Percentile(values, 99)},
+            {"max", values.empty() ? 0.0 : values.back()},
+            {"mean", mean}};
+}
+
+/* Name: Report
+ * Description: Latency percentiles (milliseconds) of the iterations, and the throughput of the median iteration
+ */
+nlohmann::json Report(std::string const& name, std::vector<double> const& seconds, uint64_t bytes, uint64_t operations)
+{
+    std::vector<double> milliseconds;
+    milliseconds.reserve(seconds.size());
+    for (auto const value : seconds)
+    {
+        milliseconds.push_back(value * 1000.0);
+    }
+    auto sorted = seconds;
+    std::ranges::sort(sorted);
+    auto const median = Percentile(sorted, 50);
+
+    nlohmann::json result{{"name", name},
+                          {"iterations", seconds.size()},
+                          {"bytes", bytes},
+                          {"operations", operations},
+                          {"latencyMs", Distribution(std::move(milliseconds))}};
+    if (median > 0.0)
+    {
+        if (bytes != 0)
+        {
+            result["throughputMBps"] = static_cast<double>(bytes) / median / (1024.0 * 1024.0);
+        }
+        result["operationsPerSecond"] = static_cast<double>(operations) / median;
+    }
+    std::cerr << "  " << name << ": p50 " << result["latencyMs"]["p50"].get<double>() << " ms\n";
+    return result;
+}
+
+/* Name: Measure
+ * Description: Time run over the iterations (plus one warmup), prepare is called before every run and is not timed.
+ *              Return nullopt as soon as a run fails.
+ */
+template<class TPrepare, class TRun>
+std::optional<std::vector<double>> Measure(unsigned int iterations, TPrepare const& prepare, TRun const& run)
+{
+    std::vector<double> seconds;
+    for (unsigned int i = 0; i <= iterations; ++i)
+    {
+        prepare();
+        auto const begin = Clock::now();
+        if (!run())
+        {
+            return std::nullopt;
+        }
+        std::chrono::duration<double> const elapsed = Clock::now() - begin;
+        if (i != 0)
+        {
+            seconds.push_back(elapsed.count());
+        }
+    }
+    return seconds;
+}
+
+void BenchParseTag(BenchOptions const& options, nlohmann::json& results)
+{
+    std::vector<std::string> tags;
+    std::mt19937_64 random{7};
+    for (std::size_t i = 0; i < 10000; ++i)
+    {
+        auto tag = "v" + std::to_string(random() % 20) + '.' + std::to_string(random() % 100) + '.' + std::to_string(random() % 1000);
+        switch (i % 4)
+        {
+        case 1:
+            tag += "-beta." + std::to_string(random() % 10);
+            break;
+        case 2:
+            tag += "-rc." + std::to_string(random() % 10) + "+build." + std::to_string(random() % 1000);
+            break;
+        case 3:
+            tag += "-alpha.x-y.7";
+            break;
+        default:
+            break;
+        }
+        tags.push_back(std::move(tag));
+    }
+
+    std::size_t parsed = 0;
+    auto const seconds = Measure(options._iterations, [] {}, [&] {
+        for (auto const& tag : tags)
+        {
+            parsed += updater::ParseTag(tag).has_value() ? 1 : 0;
+        }
+        return parsed != 0;
+    });
+    if (seconds)
+    {
+        results.push_back(Report("parseTag", *seconds, 0, tags.size()));
+    }
+}
+
+void BenchExtract(BenchOptions const& options, ZipProfile const& profile, std::filesystem::path const& workDirectory, nlohmann::json& results)
+{
+    auto const directory = workDirectory / ("extract_" + profile._name);
+    std::filesystem::create_directories(directory);
+    auto const zipPath = directory / "asset.zip";
+    if (!WriteZip(zipPath, profile))
+    {
+        return;
+    }
+    auto const zipSize = std::filesystem::file_size(zipPath);
+
+    auto const seconds = Measure(options._iterations, [&] {
+        std::filesystem::remove_all(directory / "app");
+    }, [&] {
+        return updater::ExtractAsset(zipPath).has_value();
+    });
+    if (!seconds)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to extract " << zipPath;
+        return;
+    }
+
+    auto report = Report("extract/" + profile._name, *seconds, profile.getSize(), profile._entries.size());
+    report["compressedBytes"] = zipSize;
+    results.push_back(std::move(report));
+}
+
+void BenchApply(BenchOptions const& options, ZipProfile const& profile, std::filesystem::path const& workDirectory, nlohmann::json& results)
+{
+    auto const target = std::filesystem::absolute(workDirectory / ("apply_" + profile._name)).lexically_normal();
+    auto const extracted = target / "temp" / "app";
+    auto const currentPath = std::filesystem::current_path();
+
+    //An installed tree with the files of the profile, updated by the same files
+    auto const seconds = Measure(options._iterations, [&] {
+        std::filesystem::remove_all(target);
+        WriteTree(*updater::GetOsFileSystem(), target, profile);
+        WriteTree(*updater::GetOsFileSystem(), extracted, profile);
+    }, [&] {
+        std::filesystem::current_path(extracted);
+        bool const success = updater::ApplyUpdate(target, {}, std::nullopt);
+        std::filesystem::current_path(currentPath);
+        return success;
+    });
+    if (!seconds)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to apply into " << target;
+        return;
+    }
+
+    results.push_back(Report("apply/" + profile._name, *seconds, profile.getSize(), profile._entries.size() + 1));
+}
+
+//Same extraction into a MemoryFileSystem, only the archive is read from the disk
+void BenchExtractMemory(BenchOptions const& options, ZipProfile const& profile, std::filesystem::path const& workDirectory, nlohmann::json& results)
+{
+    auto const directory = workDirectory / ("extractMemory_" + profile._name);
+    std::filesystem::create_directories(directory);
+    auto const zipPath = directory / "asset.zip";
+    if (!WriteZip(zipPath, profile))
+    {
+        return;
+    }
+
+    //The files are truncated and written again by every run
+    auto const fileSystem = std::make_shared<updater::MemoryFileSystem>();
+    updater::SessionConfig config;
+    config._fileSystem = fileSystem;
+    updater::Session session{std::move(config)};
+    auto const seconds = Measure(options._iterations, [] {}, [&] {
+        return session.extractAsset(zipPath).has_value();
+    });
+    if (!seconds)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to extract " << zipPath << " in memory";
+        return;
+    }
+
+    auto report = Report("extractMemory/" + profile._name, *seconds, profile.getSize(), profile._entries.size());
+    report["memoryBytes"] = fileSystem->getSize();
+    results.push_back(std::move(report));
+}
+
+//ApplyFiles over a MemoryFileSystem, the planning and the data structures without the disk
+void BenchApplyMemory(BenchOptions const& options, ZipProfile const& profile, nlohmann::json& results)
+{
+    std::filesystem::path const target = "/apply";
+    auto const extracted = target / "temp" / "app";
+
+    std::shared_ptr<updater::MemoryFileSystem> fileSystem;
+    auto const seconds = Measure(options._iterations, [&] {
+        fileSystem = std::make_shared<updater::MemoryFileSystem>();
+        WriteTree(*fileSystem, target, profile);
+        WriteTree(*fileSystem, extracted, profile);
+    }, [&] {
+        return updater::ApplyFiles(*fileSystem, extracted, target);
+    });
+    if (!seconds)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to apply into " << target << " in memory";
+        return;
+    }
+
+    results.push_back(Report("applyMemory/" + profile._name, *seconds, profile.getSize(), profile._entries.size() + 1));
+}
+
+void BenchRetrieve(BenchOptions const& options, updater::MockGitHubServer& server, bool cached, nlohmann::json& results)
+{
+    //A full first page of releases, the newest one is selected
+    std::string const assetName = sizeof(void*) == 8 ? "app-windows-x64.zip" : "app-windows-x86_32.zip";
+    std::vector<updater::MockRelease> releases;
+    for (uint64_t i = GRUPDATER_RELEASES_PER_PAGE; i > 0; --i)
+    {
+        releases.push_back({i, "v1." + std::to_string(i) + ".0", false, false, "2024-01-01T00:00:00Z", {{assetName, "data"}}});
+    }
+    server.setReleases("owner", "bench", std::move(releases));
+
+    //Without the cache every run is a new session and index, with it every run after the warmup is a 304
+    std::string const name = cached ? "retrieve/notModified" : "retrieve/fresh";
+    std::optional<updater::Session> session;
+    auto const seconds = Measure(options._iterations, [&] {
+        if (!cached)
+        {
+            std::error_code errorCode;
+            std::filesystem::remove(GRUPDATER_DEFAULT_RELEASE_INDEX_FILE, errorCode);
+            session.emplace();
+        }
+    }, [&] {
+        auto& target = cached ? updater::Session::getDefault() : *session;
+        auto const context = target.retrieveContext("owner", "bench", false, {});
+        return context && context->_latestTag == updater::Tag{1, GRUPDATER_RELEASES_PER_PAGE, 0};
+    });
+    if (!seconds)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to retrieve the context from the mock GitHub server";
+        return;
+    }
+    results.push_back(Report(name, *seconds, 0, 1));
+}
+
+void BenchDownload(BenchOptions const& options, updater::MockGitHubServer& server, std::size_t size, nlohmann::json& results)
+{
+    std::mt19937_64 random{11};
+    auto blob = RandomData(random, size);
+    auto const blobSize = blob.size();
+    server.setReleases("owner", "repo", {{1, "v1.0.0", false, false, {}, {{"asset.zip", std::move(blob)}}}});
+
+    //From the origin, through the redirect to /objects/ like github.com
+    updater::RepoContext context;
+    context._owner = "owner";
+    context._repo = "repo";
+    context._asset = "asset.zip";
+    context._assetUrl = server.getBaseUrl() + "/owner/repo/releases/download/v1.0.0/asset.zip";
+    context._latestTag = {1, 0, 0};
+
+    std::vector<double> ttfb;
+    auto const seconds = Measure(options._iterations, [] {}, [&] {
+        updater::UpdateMetrics metrics;
+        std::optional<std::filesystem::path> assetPath;
+        {
+            updater::MetricsScope scope{&metrics, "download"};
+            assetPath = updater::DownloadAsset(context, "download/", {});
+        }
+        auto const& http = metrics._phases.front()._http;
+        if (http._requests != 0)
+        {
+            ttfb.push_back(static_cast<double>(http._ttfb.count()) / 1000.0 / http._requests);
+        }
+        return assetPath && std::filesystem::file_size(*assetPath) == blobSize;
+    });
+
+    if (!seconds)
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to download from the mock GitHub server";
+        return;
+    }
+    auto report = Report("download/" + std::to_string(size / 1024) + "KiB", *seconds, blobSize, 1);
+    //Without the warmup
+    if (!ttfb.empty())
+    {
+        ttfb.erase(ttfb.begin());
+    }
+    report["ttfbMs"] = Distribution(std::move(ttfb));
+    results.push_back(std::move(report));
+}
+
+}//namespace
+
+int main(int argc, char** argv)
+{
+    CLI::App app{"Benchmarks of the GRUpdater update pipeline (results as JSON)", "GRUpdaterBench"};
+
+    BenchOptions options;
+    std::filesystem::path workDirectory = "./bench/";
+    std::filesystem::path outputPath;
+    bool keep = false;
+    app.add_option("-i,--iterations", options._iterations, "Timed iterations of every benchmark (default: 5)")
+        ->check(CLI::PositiveNumber);
+    app.add_option("-s,--scale", options._scale, "Size multiplier of the synthetic assets (default: 1.0)")
+        ->check(CLI::PositiveNumber);
+    app.add_option("-f,--filter", options._filter, "Only run the benchmarks whose name contains this string");
+    app.add_option("-l,--latency", options._latency, "Latency injected by the mock GitHub server in milliseconds (default: 0)");
+    app.add_option("-w,--work", workDirectory, "The relative working directory, removed at the end (default: ./bench/)");
+    app.add_option("-o,--output", outputPath, "Write the JSON results to this file instead of stdout");
+    app.add_flag("--keep", keep, "Keep the working directory");
+
+    CLI11_PARSE(app, argc, argv);
+
+    //The per-file messages would be measured too
+    updater::Logger::get().setLevel(updater::LogLevel::Warning);
+
+    std::filesystem::create_directories(workDirectory);
+    auto const rootPath = std::filesystem::current_path();
+    //DownloadAsset only accepts a relative directory, the schedule file is also written there
+    std::filesystem::current_path(workDirectory);
+
+    auto const selected = [&options](std::string_view name) {
+        return options._filter.empty() || name.find(options._filter) != std::string_view::npos;
+    };
+
+    //The network benchmarks go through the real HTTP code to a local GitHub stand-in
+    updater::MockGitHubOptions mockOptions;
+    mockOptions._latency = std::chrono::milliseconds{options._latency};
+    mockOptions._rateLimit = std::numeric_limits<uint32_t>::max();
+    updater::MockGitHubServer server{mockOptions};
+    if (!server.start())
+    {
+        updater::Log(updater::LogLevel::Error) << "Failed to start the mock GitHub server";
+        return 1;
+    }
+    updater::SetOrigins({server.getBaseUrl(), server.getBaseUrl()});
+
+    nlohmann::json results = nlohmann::json::array();
+    if (selected("parseTag"))
+    {
+        BenchParseTag(options, results);
+    }
+
+    auto const profiles = MakeProfiles(options._scale);
+    for (auto const& profile : profiles)
+    {
+        if (selected("extract/" + profile._name))
+        {
+            BenchExtract(options, profile, ".", results);
+        }
+    }
+    for (auto const& profile : profiles)
+    {
+        if (selected("extractMemory/" + profile._name))
+        {
+            BenchExtractMemory(options, profile, ".", results);
+        }
+    }
+    for (auto const& profile : profiles)
+    {
+        if (selected("apply/" + profile._name))
+        {
+            BenchApply(options, profile, ".", results);
+        }
+    }
+    for (auto const& profile : profiles)
+    {
+        if (selected("applyMemory/" + profile._name))
+        {
+            BenchApplyMemory(options, profile, results);
+        }
+    }
+    for (std::size_t const size : {std::size_t{64 * 1024}, Scaled(64 * 1024 * 1024, options._scale)})
+    {
+        if (selected("download/" + std::to_string(size / 1024) + "KiB"))
+        {
+            BenchDownload(options, server, size, results);
+        }
+    }
+    for (bool const cached : {false, true})
+    {
+        if (selected(cached ? "retrieve/notModified" : "retrieve/fresh"))
+        {
+            BenchRetrieve(options, server, cached, results);
+        }
+    }
+    server.stop();
+
+    std::filesystem::current_path(rootPath);
+    if (!keep)
+    {
+        std::error_code errorCode;
+        std::filesystem::remove_all(workDirectory, errorCode);
+    }
+
+    nlohmann::json const report{{"version", GRUPDATER_TAG_STR},
+                                {"iterations", options._iterations},
+                                {"scale", options._scale},
+                                {"results", std::move(results)}};
+    if (outputPath.empty())
+    {
+        std::cout << report.dump(4) << '\n';
+        return 0;
+    }
+    std::ofstream file(outputPath, std::ios::trunc);
+    file << report.dump(4) << '\n';
+    return file.good() ? 0 : 1;
+}
@@ -1,8 +1,97 @@
 #include "updater.hpp"
 #include "CLI11.hpp"
 #include <iostream>
+#include <fstream>
+#include <csignal>
 #include <bits/this_thread_sleep.h>
 
+namespace
+{
+
+updater::Daemon* gDaemon = nullptr;
+
+void StopDaemon([[maybe_unused]] int signal)
+{
+    if (gDaemon != nullptr)
+    {
+        gDaemon->stop();
+    }
+}
+
+/* Name: MetricsWriter
+ * Description: Collect the phase metrics of a command and write them as JSON at the end of it,
+ *              even when the command fails. Nothing is collected nor written if the path is empty.
+ */
+class MetricsWriter
+{
+public:
+    explicit MetricsWriter(std::filesystem::path path) :
+            _g_path(std::move(path))
+    {}
+    ~MetricsWriter()
+    {
+        if (this->_g_path.empty())
+        {
+            return;
+        }
+        std::ofstream file{this->_g_path, std::ios::trunc};
+        file << updater::ToJson(this->_g_metrics) << '\n';
+        if (!file)
+        {
+            updater::Log(updater::LogLevel::Error) << "Failed to write the metrics to " << this->_g_path;
+        }
+    }
+
+    MetricsWriter(MetricsWriter const&) = delete;
+    MetricsWriter& operator=(MetricsWriter const&) = delete;
+
+    [[nodiscard]] updater::UpdateMetrics* get()
+    {
+        return this->_g_path.empty() ? nullptr : &this->_g_metrics;
+    }
+
+private:
+    std::filesystem::path _g_path;
+    updater::UpdateMetrics _g_metrics;
+};
+
+/* Name: TraceWriter
+ * Description: Enable the tracer for a command and write its Chrome trace at the end of it,
+ *              even when the command fails. Nothing is traced if the path is empty.
+ */
+class TraceWriter
+{
+public:
+    explicit TraceWriter(std::filesystem::path path) :
+            _g_path(std::move(path))
+    {
+        if (!this->_g_path.empty())
+        {
+            updater::Tracer::setEnabled(true);
+        }
+    }
+    ~TraceWriter()
+    {
+        if (this->_g_path.empty())
+        {
+            return;
+        }
+        updater::Tracer::setEnabled(false);
+        if (!updater::Tracer::dump(this->_g_path))
+        {
+            updater::Log(updater::LogLevel::Error) << "Failed to write the trace to " << this->_g_path;
+        }
+    }
+
+    TraceWriter(TraceWriter const&) = delete;
+    TraceWriter& operator=(TraceWriter const&) = delete;
+
+private:
+    std::filesystem::path _g_path;
+};
+
+}//namespace
+
 int main (int argc, char **argv)
 {
     using namespace updater;
@@ -14,18 +103,45 @@ int main (int argc, char **argv)
         throw CLI::Success{};
     }, "Print the version (and do nothing else)");
 
+    app.add_option_function<std::string>("--log-level", [](std::string const& level) {
+        Logger::get().setLevel(*ParseLogLevel(level));
+    }, "Minimum level of the messages (default: info, debug also lists every extracted and copied file)")
+        ->check(CLI::IsMember({"debug", "info", "warning", "error", "off"}));
+    bool logToFile = false;
+    app.add_option_function<std::filesystem::path>("--log-file", [&logToFile](std::filesystem::path const& logFile) {
+        auto sink = Logger::fileSink(logFile);
+        if (!sink)
+        {
+            throw CLI::ValidationError{"--log-file", "Failed to open " + logFile.string()};
+        }
+        Logger::get().setSink(std::move(sink));
+        logToFile = true;
+    }, "Write the messages to this file instead of the console");
+    app.add_option_function<std::string>("--github-api", [](std::string const& origin) {
+        auto origins = GetOrigins();
+        origins._api = origin;
+        SetOrigins(std::move(origins));
+    }, "Base URL of the GitHub API (default: " GRUPDATER_ORIGIN_API ", for GitHub Enterprise or a local mock)");
+    app.add_option_function<std::string>("--github-download", [](std::string const& origin) {
+        auto origins = GetOrigins();
+        origins._download = origin;
+        SetOrigins(std::move(origins));
+    }, "Base URL of the release downloads (default: " GRUPDATER_ORIGIN_DOWNLOAD ")");
+
     std::string currentTagString;
     std::string owner;
     std::string repo;
 
     auto subcommandFetch = app.add_subcommand("fetch", "Fetch the latest release from GitHub");
 
-    subcommandFetch->add_option("-c,--current", currentTagString, "The current version tag of the software")
-        ->required();
-    subcommandFetch->add_option("-o,--owner", owner, "The owner of the repository")
-        ->required();
-    subcommandFetch->add_option("-r,--repo", repo, "The repository name")
-        ->required();
+    auto currentOption = subcommandFetch->add_option("-c,--current", currentTagString, "The current version tag of the software");
+    auto ownerOption = subcommandFetch->add_option("-o,--owner", owner, "The owner of the repository");
+    auto repoOption = subcommandFetch->add_option("-r,--repo", repo, "The repository name");
+
+    std::filesystem::path manifestPath;
+    subcommandFetch->add_option("-m,--manifest", manifestPath, "Check all the repositories of this manifest in one pass")
+        ->check(CLI::ExistingFile)
+        ->excludes(currentOption, ownerOption, repoOption);
 
     std::filesystem::path tempDir = "./temp/";
     subcommandFetch->add_option("-t,--temp", tempDir, "The relative temporary directory to store the asset (default: ./temp/)");
@@ -40,86 +156,459 @@ int main (int argc, char **argv)
     subcommandFetch->add_flag("--extract", extractAsset, "Extract the asset");
     subcommandFetch->add_flag("--prerelease", allowPrerelease, "Allow prerelease tag");
 
-    subcommandFetch->callback([&] {
-        auto currentTag = ParseTag(currentTagString);
-        if (!currentTag)
+    std::vector<std::string> mirrors;
+    subcommandFetch->add_option("--mirror", mirrors, "A peer/mirror base URL ranked with GitHub by measured latency and throughput, e.g. http://cache.local:8080 (can be repeated)");
+
+    std::string rangeString;
+    std::optional<std::string> channel;
+    auto rangeOption = subcommandFetch->add_option("--range", rangeString, "Only consider tags within this range (e.g. ^1.4, ~1.4.2, 1.4.2, *)");
+    subcommandFetch->add_option("--channel", channel, "Only consider prerelease tags of this channel (e.g. beta)")
+        ->excludes(rangeOption);
+
+    uint64_t limitRate = 0;
+    uint64_t limitBurst = GRUPDATER_DEFAULT_BANDWIDTH_BURST;
+    std::vector<std::string> limitProfileStrings;
+    auto const addBandwidthOptions = [&](CLI::App* subcommand) {
+        subcommand->add_option("--limit-rate", limitRate, "Maximum download rate in bytes per second, e.g. 512K or 2M (default: unlimited)")
+            ->transform(CLI::AsSizeValue(false));
+        subcommand->add_option("--limit-burst", limitBurst, "Burst size of the download rate limit (default: 256K)")
+            ->transform(CLI::AsSizeValue(false));
+        subcommand->add_option("--limit-profile", limitProfileStrings, "Download rate between two local times as HH:MM-HH:MM=rate, e.g. 08:00-18:00=512K (can be repeated, the first match is used)");
+    };
+    auto const applyBandwidthLimit = [&]() {
+        std::vector<BandwidthProfile> profiles;
+        for (auto const& profileString : limitProfileStrings)
+        {
+            auto profile = ParseBandwidthProfile(profileString);
+            if (!profile)
+            {
+                Log(LogLevel::Error) << "Invalid download rate profile \"" << profileString << "\", expected HH:MM-HH:MM=rate";
+                throw CLI::RuntimeError{1};
+            }
+            profiles.push_back(*profile);
+        }
+        GetBandwidthLimiter().setLimit(limitRate, limitBurst);
+        GetBandwidthLimiter().setProfiles(std::move(profiles));
+    };
+    addBandwidthOptions(subcommandFetch);
+
+    std::string metricsHost = "0.0.0.0";
+    int metricsPort = 0;
+    auto const addMetricsServerOptions = [&](CLI::App* subcommand) {
+        subcommand->add_option("--metrics-host", metricsHost, "The address of the /metrics endpoint (default: 0.0.0.0)");
+        subcommand->add_option("--metrics-port", metricsPort, "Serve the counters and histograms in the OpenMetrics format on /metrics at this port (default: disabled)")
+            ->check(CLI::Range(1, 65535));
+    };
+    auto const startMetricsServer = [&](MetricsServer& server) {
+        if (metricsPort == 0)
+        {
+            return;
+        }
+        if (!server.start(metricsHost, metricsPort))
         {
-            std::cerr << "Failed to parse current tag\n";
+            Log(LogLevel::Error) << "Failed to listen on " << metricsHost << ':' << metricsPort << " for /metrics";
             throw CLI::RuntimeError{1};
         }
+        Log(LogLevel::Info) << "Serving /metrics on " << metricsHost << ':' << metricsPort;
+    };
+
+    std::filesystem::path tracePath;
+    auto const addTraceOption = [&](CLI::App* subcommand) {
+        subcommand->add_option("--trace", tracePath, "Record a timeline of the retrieve, HTTP, download, extract and apply steps into this Chrome trace JSON file (chrome://tracing, Perfetto)");
+    };
+    addTraceOption(subcommandFetch);
+
+    std::filesystem::path metricsPath;
+    subcommandFetch->add_option("--metrics-json", metricsPath, "Write the timings, CPU, I/O and HTTP measures of every phase to this JSON file");
+    UpdateMetrics* metrics = nullptr;
+
+    std::string progressFormat;
+    subcommandFetch->add_option("--progress", progressFormat, "Report the download and extraction progress as log lines (text) or one JSON object per line on the standard output (json, the messages then go to stderr)")
+        ->check(CLI::IsMember({"text", "json"}));
+    auto const makeProgressObserver = [&]() -> ProgressObserver {
+        if (progressFormat == "json")
+        {
+            //Only these lines are written on the standard output (the messages go to stderr), each one at once
+            if (!logToFile)
+            {
+                Logger::get().setSink([](LogLevel, std::string_view message) {
+                    std::cerr << message << '\n';
+                });
+            }
+            return [](Progress const& progress) {
+                std::ostringstream line;
+                line << "{\"phase\":\"" << ToString(progress._phase) << "\",\"done\":" << progress._bytesDone
+                     << ",\"total\":" << (progress._bytesTotal ? std::to_string(*progress._bytesTotal) : "null")
+                     << ",\"rate\":" << static_cast<uint64_t>(progress._bytesPerSecond)
+                     << ",\"eta\":" << (progress._eta ? std::to_string(progress._eta->count()) : "null")
+                     << ",\"entry\":" << progress._entryIndex << ",\"entries\":" << progress._entryCount
+                     << ",\"finished\":" << (progress._finished ? "true" : "false") << "}\n";
+                std::cout << line.str() << std::flush;
+            };
+        }
+        return [](Progress const& progress) {
+            auto log = Log(LogLevel::Info);
+            log << ToString(progress._phase) << ' ' << progress._bytesDone << " bytes";
+            if (progress._bytesTotal && *progress._bytesTotal > 0)
+            {
+                log << " (" << progress._bytesDone * 100 / *progress._bytesTotal << "%)";
+            }
+            log << ", " << static_cast<uint64_t>(progress._bytesPerSecond / 1024) << " KiB/s";
+            if (progress._eta)
+            {
+                log << ", " << progress._eta->count() << "s left";
+            }
+            if (progress._finished)
+            {
+                log << ", done";
+            }
+        };
+    };
+
+    auto const downloadAndExtract = [&](RepoContext const& context, std::filesystem::path const& directory) {
+        std::optional<std::filesystem::path> zipFile;
+        {
+            MetricsScope scope{metrics, "download"};
+            zipFile = DownloadAsset(context, directory, mirrors);
+            scope.setSuccess(zipFile.has_value());
+        }
+        if (!zipFile)
+        {
+            Log(LogLevel::Error) << "Failed to download asset";
+            return false;
+        }
+        Log(LogLevel::Info) << "Asset downloaded to " << *zipFile;
+
+        std::optional<std::filesystem::path> extractRoot;
+        {
+            MetricsScope scope{metrics, "extract"};
+            extractRoot = ExtractAsset(*zipFile);
+            scope.setSuccess(extractRoot.has_value());
+        }
+        if (!extractRoot)
+        {
+            Log(LogLevel::Error) << "Failed to extract asset";
+            return false;
+        }
+        Log(LogLevel::Info) << "Asset extracted to " << *extractRoot;
+        return true;
+    };
+
+    subcommandFetch->callback([&] {
+        applyBandwidthLimit();
+
+        TraceWriter traceWriter{tracePath};
+        MetricsWriter metricsWriter{metricsPath};
+        metrics = metricsWriter.get();
+
+        std::optional<ProgressScope> progressScope;
+        if (!progressFormat.empty())
+        {
+            progressScope.emplace(makeProgressObserver());
+        }
+
+        std::optional<std::vector<WatchEntry>> manifest;
+        std::optional<Tag> currentTag;
+        if (!manifestPath.empty())
+        {
+            manifest = LoadManifest(manifestPath);
+            if (!manifest)
+            {
+                Log(LogLevel::Error) << "Failed to load the manifest";
+                throw CLI::RuntimeError{1};
+            }
+        }
+        else
+        {
+            if (owner.empty() || repo.empty() || currentTagString.empty())
+            {
+                Log(LogLevel::Error) << "--current, --owner and --repo are required without --manifest";
+                throw CLI::RuntimeError{1};
+            }
+            currentTag = ParseTag(currentTagString);
+            if (!currentTag)
+            {
+                Log(LogLevel::Error) << "Failed to parse current tag";
+                throw CLI::RuntimeError{1};
+            }
+        }
 
         //Verify schedule time in order to avoid spamming GitHub API requests
-        auto scheduleTime = GetScheduleTime();
-        if (scheduleTime && !VerifyScheduleTime(*scheduleTime))
+        auto scheduleState = GetScheduleState();
+        if (scheduleState)
         {
-            std::cerr << "Schedule time not reached yet, remaining "
-                      << GRUPDATER_DEFAULT_SCHEDULE_DELAY_HOURS * 60 - std::chrono::duration_cast<std::chrono::minutes>(std::chrono::system_clock::now() - *scheduleTime).count() << " minutes\n";
-            throw CLI::RuntimeError{1};
+            auto const nextTime = GetNextScheduleTime(*scheduleState);
+            auto const now = std::chrono::system_clock::now();
+            if (now < nextTime)
+            {
+                Log(LogLevel::Error) << "Schedule time not reached yet, remaining "
+                                     << std::chrono::duration_cast<std::chrono::minutes>(nextTime - now).count() + 1 << " minutes";
+                throw CLI::RuntimeError{1};
+            }
         }
         if (!SetScheduleTime())
         {
-            std::cerr << "Failed to set schedule time (will continue anyway)\n";
+            Log(LogLevel::Warning) << "Failed to set schedule time (will continue anyway)";
+        }
+
+        if (manifest)
+        {
+            std::vector<RepoRequest> requests;
+            requests.reserve(manifest->size());
+            for (auto const& entry : *manifest)
+            {
+                requests.push_back({entry._owner, entry._repo, entry._allowPrerelease || allowPrerelease});
+            }
+
+            std::vector<std::optional<RepoContext>> contexts;
+            {
+                MetricsScope scope{metrics, "retrieve"};
+                contexts = RetrieveContexts(requests, GRUPDATER_DEFAULT_MAX_CONNECTIONS, mirrors);
+                scope.setSuccess(std::ranges::all_of(contexts, [](auto const& context) { return context.has_value(); }));
+            }
+
+            bool success = true;
+            for (std::size_t i = 0; i < manifest->size(); ++i)
+            {
+                auto const& entry = (*manifest)[i];
+                if (!contexts[i])
+                {
+                    Log(LogLevel::Error) << entry._owner << '/' << entry._repo << ": failed to retrieve context";
+                    success = false;
+                    continue;
+                }
+
+                auto const status = VerifyTag(*contexts[i], entry._currentTag);
+                Log(LogLevel::Info) << entry._owner << '/' << entry._repo << ": " << ToString(contexts[i]->_latestTag) << " (" << ToString(status) << ")";
+
+                if (status == TagStatus::NewerTag && downloadAsset && VerifyRolloutTime(*contexts[i], scheduleState ? scheduleState->_rolloutWindow : std::chrono::hours{GRUPDATER_DEFAULT_ROLLOUT_WINDOW_HOURS}))
+                {
+                    success = downloadAndExtract(*contexts[i], tempDir / (entry._owner + '_' + entry._repo) / "") && success;
+                }
+            }
+
+            if (!success)
+            {
+                throw CLI::RuntimeError{1};
+            }
+            throw CLI::Success{};
+        }
+
+        std::optional<RepoContext> context;
+        std::optional<MetricsScope> retrieveScope;
+        retrieveScope.emplace(metrics, "retrieve");
+        if (rangeString.empty() && !channel)
+        {
+            context = RetrieveContext(owner, repo, allowPrerelease, mirrors);
         }
+        else
+        {
+            auto const range = ParseTagRange(rangeString.empty() ? "*" : rangeString);
+            if (!range)
+            {
+                Log(LogLevel::Error) << "Failed to parse tag range";
+                throw CLI::RuntimeError{1};
+            }
 
-        auto context = RetrieveContext(owner, repo, allowPrerelease);
+            auto const selector = LoadMirrorSelector(mirrors);
+            ReleaseIndex index{owner, repo};
+            index.setMirrors(selector);
+            if (!index.load())
+            {
+                Log(LogLevel::Info) << "No usable release index cache, starting a new one";
+            }
+            if (index.update())
+            {
+                auto const* entry = channel ? index.latestChannel(*channel) : index.latestWithin(*range, allowPrerelease);
+                if (entry != nullptr)
+                {
+                    context = index.makeContext(*entry);
+                }
+                if (!index.save())
+                {
+                    Log(LogLevel::Warning) << "Failed to save the release index cache";
+                }
+            }
+            if (!RecordRateLimit(owner, repo, index.getRateLimit()))
+            {
+                Log(LogLevel::Warning) << "Failed to record the rate limit in the schedule file";
+            }
+            if (!RecordReleaseTimes(index.getEntries()))
+            {
+                Log(LogLevel::Warning) << "Failed to record the release times in the schedule file";
+            }
+            if (!RecordMirrorStats(*selector))
+            {
+                Log(LogLevel::Warning) << "Failed to record the mirror measures in the schedule file";
+            }
+        }
+        retrieveScope->setSuccess(context.has_value());
+        retrieveScope.reset();
         if (!context)
         {
-            std::cerr << "Failed to retrieve context\n";
+            Log(LogLevel::Error) << "Failed to retrieve context";
             throw CLI::RuntimeError{1};
         }
-        std::cout << "Context retrieved :\n";
-        std::cout << "\tOwner: " << context->_owner << '\n';
-        std::cout << "\tRepo: " << context->_repo << '\n';
-        std::cout << "\tAsset: " << context->_asset << '\n';
-        std::cout << "\tAsset URL: " << context->_assetUrl << '\n';
-        std::cout << "\tLatest Tag: " << context->_latestTag.major << '.' << context->_latestTag.minor << '.' << context->_latestTag.patch << '\n';
+        Log(LogLevel::Info) << "Context retrieved :";
+        Log(LogLevel::Info) << "\tOwner: " << context->_owner;
+        Log(LogLevel::Info) << "\tRepo: " << context->_repo;
+        Log(LogLevel::Info) << "\tAsset: " << context->_asset;
+        Log(LogLevel::Info) << "\tAsset URL: " << context->_assetUrl;
+        Log(LogLevel::Info) << "\tLatest Tag: " << ToString(context->_latestTag);
 
         if (verifyTag)
         {
             if (VerifyTag(*context, *currentTag) != TagStatus::NewerTag)
             {
-                std::cerr << "No newer tag available\n";
+                Log(LogLevel::Error) << "No newer tag available";
+                throw CLI::RuntimeError{1};
+            }
+            Log(LogLevel::Info) << "Newer tag available";
+
+            auto const rolloutWindow = scheduleState ? scheduleState->_rolloutWindow : std::chrono::hours{GRUPDATER_DEFAULT_ROLLOUT_WINDOW_HOURS};
+            if (!VerifyRolloutTime(*context, rolloutWindow))
+            {
+                Log(LogLevel::Error) << "Rollout time of this machine not reached yet";
                 throw CLI::RuntimeError{1};
             }
-            std::cout << "Newer tag available\n";
         }
 
         std::optional<std::filesystem::path> zipFile;
         if (downloadAsset)
         {
-            zipFile = DownloadAsset(*context, tempDir);
+            MetricsScope scope{metrics, "download"};
+            zipFile = DownloadAsset(*context, tempDir, mirrors);
+            scope.setSuccess(zipFile.has_value());
             if (!zipFile)
             {
-                std::cerr << "Failed to download asset\n";
+                Log(LogLevel::Error) << "Failed to download asset";
                 throw CLI::RuntimeError{1};
             }
         }
         else
         {
-            std::cerr << "Not implemented\n";
+            Log(LogLevel::Error) << "Not implemented";
             throw CLI::RuntimeError{1};
         }
 
-        std::cout << "Asset downloaded to " << *zipFile << '\n';
+        Log(LogLevel::Info) << "Asset downloaded to " << *zipFile;
 
         std::optional<std::filesystem::path> extractRoot;
         if (extractAsset)
         {
+            MetricsScope scope{metrics, "extract"};
             extractRoot = ExtractAsset(*zipFile);
+            scope.setSuccess(extractRoot.has_value());
             if (!extractRoot)
             {
-                std::cerr << "Failed to extract asset\n";
+                Log(LogLevel::Error) << "Failed to extract asset";
                 throw CLI::RuntimeError{1};
             }
         }
         else
         {
-            std::cerr << "Not implemented\n";
+            Log(LogLevel::Error) << "Not implemented";
             throw CLI::RuntimeError{1};
         }
 
-        std::cout << "Asset extracted to " << *extractRoot << '\n';
+        Log(LogLevel::Info) << "Asset extracted to " << *extractRoot;
+
+        throw CLI::Success{};
+    });
+
+    auto subcommandDaemon = app.add_subcommand("daemon", "Keep checking many repositories for newer releases");
+
+    std::vector<std::string> watchStrings;
+    subcommandDaemon->add_option("-w,--watch", watchStrings, "A repository to watch as owner/repo@currentTag (can be repeated)")
+        ->required();
+    subcommandDaemon->add_flag("--prerelease", allowPrerelease, "Allow prerelease tag");
+    subcommandDaemon->add_flag("--download", downloadAsset, "Download and extract the newer assets");
+    subcommandDaemon->add_option("-t,--temp", tempDir, "The relative temporary directory to store the assets (default: ./temp/)");
+    addBandwidthOptions(subcommandDaemon);
+    addMetricsServerOptions(subcommandDaemon);
+    addTraceOption(subcommandDaemon);
+
+    subcommandDaemon->callback([&] {
+        applyBandwidthLimit();
+
+        TraceWriter traceWriter{tracePath};
+
+        MetricsServer metricsServer;
+        startMetricsServer(metricsServer);
+
+        Daemon daemon{[&](WatchEntry const& entry, RepoContext const& context) {
+            Log(LogLevel::Info) << "Newer tag available for " << entry._owner << '/' << entry._repo << ": "
+                                << ToString(context._latestTag) << " (current " << ToString(entry._currentTag) << ")";
+            if (downloadAsset)
+            {
+                return downloadAndExtract(context, tempDir / (entry._owner + '_' + entry._repo) / "");
+            }
+            return true;
+        }, GetScheduleState().value_or(ScheduleState{})};
+
+        for (auto const& watchString : watchStrings)
+        {
+            auto const slash = watchString.find('/');
+            auto const at = watchString.find('@', slash == std::string::npos ? 0 : slash);
+            if (slash == std::string::npos || at == std::string::npos)
+            {
+                Log(LogLevel::Error) << "Invalid watch entry \"" << watchString << "\", expected owner/repo@currentTag";
+                throw CLI::RuntimeError{1};
+            }
+
+            auto currentTag = ParseTag(std::string_view{watchString}.substr(at + 1));
+            if (!currentTag)
+            {
+                Log(LogLevel::Error) << "Failed to parse current tag of \"" << watchString << "\"";
+                throw CLI::RuntimeError{1};
+            }
+
+            daemon.watch({watchString.substr(0, slash), watchString.substr(slash + 1, at - slash - 1), *currentTag, allowPrerelease});
+        }
+
+        gDaemon = &daemon;
+        std::signal(SIGINT, StopDaemon);
+        std::signal(SIGTERM, StopDaemon);
+
+        Log(LogLevel::Info) << "Watching " << watchStrings.size() << " repositories, press Ctrl+C to stop";
+        daemon.run();
+
+        gDaemon = nullptr;
+        throw CLI::Success{};
+    });
+
+    auto subcommandServe = app.add_subcommand("serve", "Serve the releases and assets to the other nodes of the LAN (peer cache)");
 
+    std::filesystem::path cacheDir = GRUPDATER_DEFAULT_PEER_CACHE_DIRECTORY;
+    std::string host = "0.0.0.0";
+    int port = GRUPDATER_DEFAULT_PEER_PORT;
+    int assetPort = 0;
+    unsigned int refreshMinutes = GRUPDATER_DEFAULT_PEER_REFRESH_MINUTES;
+    subcommandServe->add_option("--cache", cacheDir, "The directory of the cached assets (default: " GRUPDATER_DEFAULT_PEER_CACHE_DIRECTORY ")");
+    subcommandServe->add_option("--host", host, "The address to listen on (default: 0.0.0.0)");
+    subcommandServe->add_option("-p,--port", port, "The port to listen on (default: " GRUPDATER_TOSTRING(GRUPDATER_DEFAULT_PEER_PORT) ")")
+        ->check(CLI::Range(1, 65535));
+    subcommandServe->add_option("--asset-port", assetPort, "The port of the zero-copy plain HTTP asset endpoint (default: disabled)")
+        ->check(CLI::Range(1, 65535));
+    subcommandServe->add_option("--refresh", refreshMinutes, "Minimum delay in minutes between two refresh of a release list (default: " GRUPDATER_TOSTRING(GRUPDATER_DEFAULT_PEER_REFRESH_MINUTES) ")");
+
+    addMetricsServerOptions(subcommandServe);
+
+    subcommandServe->callback([&] {
+        MetricsServer metricsServer;
+        startMetricsServer(metricsServer);
+
+        PeerServer server{cacheDir, std::chrono::minutes{refreshMinutes}};
+        Log(LogLevel::Info) << "Serving " << cacheDir << " on " << host << ':' << port;
+        if (assetPort != 0)
+        {
+            Log(LogLevel::Info) << "Serving the assets (zero-copy) on " << host << ':' << assetPort;
+        }
+        if (!server.listen(host, port, assetPort))
+        {
+            Log(LogLevel::Error) << "Failed to listen on " << host << ':' << port;
+            throw CLI::RuntimeError{1};
+        }
         throw CLI::Success{};
     });
 
@@ -139,10 +628,16 @@ int main (int argc, char **argv)
     subcommandApply->add_option("--caller", callerExecutable, "The caller executable path")
         ->check(CLI::ExistingFile);
 
+    subcommandApply->add_option("--metrics-json", metricsPath, "Write the timings, CPU, I/O and throughput measures of the apply phase to this JSON file");
+
+    addTraceOption(subcommandApply);
+
     subcommandApply->callback([&] {
-        if (!ApplyUpdate(targetDir, callerExecutable, callerPid==0 ? std::nullopt : std::optional{callerPid}))
+        TraceWriter traceWriter{tracePath};
+        MetricsWriter metricsWriter{metricsPath};
+        if (!ApplyUpdate(targetDir, callerExecutable, callerPid==0 ? std::nullopt : std::optional{callerPid}, metricsWriter.get()))
         {
-            std::cerr << "Failed to apply update\n";
+            Log(LogLevel::Error) << "Failed to apply update";
             throw CLI::RuntimeError{1};
         }
         throw CLI::Success{};
@@ -159,15 +654,18 @@ int main (int argc, char **argv)
         ->required()
         ->check(CLI::ExistingFile);
 
+    bool leanApply = false;
+    subcommandRequestApply->add_flag("--lean", leanApply, "Apply with the lean " GRUPDATER_APPLY_EXECUTABLE_NAME " (shorter downtime)");
+
     subcommandRequestApply->callback([&] {
-        if (RequestApplyUpdate(rootAssetPath, callerExecutable))
+        if (RequestApplyUpdate(rootAssetPath, callerExecutable, leanApply ? ApplyMode::Lean : ApplyMode::Full))
         {
-            std::cout << "Request to apply update sent\n";
-            std::cout << "This process will now close in order to apply it from the called GRUpdater\n";
+            Log(LogLevel::Info) << "Request to apply update sent";
+            Log(LogLevel::Info) << "This process will now close in order to apply it from the called GRUpdater";
             std::this_thread::sleep_for(std::chrono::seconds{2});
             throw CLI::Success{};
         }
-        std::cerr << "Failed to call RequestApplyUpdate()\n";
+        Log(LogLevel::Error) << "Failed to call RequestApplyUpdate()";
         throw CLI::RuntimeError{1};
     });
 
@@ -0,0 +1,357 @@
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.h"
+#include "mockgithub.hpp"
+#include "json.hpp"
+#include <charconv>
+
+//Bodies are written by chunks of this size when the bandwidth is limited
+#define GRUPDATER_MOCK_CHUNK_SIZE (64 * 1024)
+
+namespace updater
+{
+
+namespace
+{
+
+std::size_t ReadParam(httplib::Request const& req, char const* key, std::size_t defaultValue)
+{
+    if (!req.has_param(key))
+    {
+        return defaultValue;
+    }
+    auto const value = req.get_param_value(key);
+    std::size_t result = 0;
+    auto const [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc{} || ptr == value.data())
+    {
+        return defaultValue;
+    }
+    return result;
+}
+
+std::string MakeEtag(std::string const& body)
+{
+    std::array<char, 16> buffer{};
+    auto const [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), std::hash<std::string>{}(body), 16);
+    return "\"" + std::string(buffer.data(), ptr) + "\"";
+}
+
+void SetMessage(httplib::Response& res, int status, std::string const& message)
+{
+    res.status = status;
+    res.set_content(nlohmann::json{{"message", message}}.dump(), "application/json");
+}
+
+}//namespace
+
+struct MockGitHubServer::Repo
+{
+    nlohmann::json _releases = nlohmann::json::array(); //browser_download_url without the base URL
+    std::optional<std::string> _payload;
+    std::map<std::string, std::shared_ptr<MockAsset const>> _assets; //By tag/name
+};
+
+MockGitHubServer::MockGitHubServer(MockGitHubOptions options) :
+        _g_options(std::move(options))
+{
+    this->resetRateLimit();
+}
+MockGitHubServer::~MockGitHubServer()
+{
+    this->stop();
+}
+
+bool MockGitHubServer::start(std::string const& host)
+{
+    this->stop();
+
+    this->_g_server = std::make_unique<httplib::Server>();
+    this->route();
+    auto const port = this->_g_server->bind_to_any_port(host);
+    if (port <= 0)
+    {
+        this->_g_server.reset();
+        return false;
+    }
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_baseUrl = "http://" + host + ":" + std::to_string(port);
+    }
+
+    this->_g_thread = std::thread([server = this->_g_server.get()] {
+        server->listen_after_bind();
+    });
+    this->_g_server->wait_until_ready();
+    return true;
+}
+void MockGitHubServer::stop()
+{
+    if (this->_g_server)
+    {
+        this->_g_server->stop();
+    }
+    if (this->_g_thread.joinable())
+    {
+        this->_g_thread.join();
+    }
+    this->_g_server.reset();
+
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_baseUrl.clear();
+}
+
+std::string MockGitHubServer::getBaseUrl() const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    return this->_g_baseUrl;
+}
+
+void MockGitHubServer::setOptions(MockGitHubOptions options)
+{
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_options = std::move(options);
+    }
+    this->resetRateLimit();
+}
+void MockGitHubServer::setReleases(std::string const& owner, std::string const& repo, std::vector<MockRelease> releases)
+{
+    auto entry = std::make_shared<Repo>();
+    for (auto& release : releases)
+    {
+        nlohmann::json assets = nlohmann::json::array();
+        for (auto& asset : release._assets)
+        {
+            assets.push_back({{"name", asset._name},
+                              {"content_type", asset._contentType},
+                              {"size", asset._data.size()},
+                              {"browser_download_url", "/" + owner + "/" + repo + "/releases/download/" + release._tag + "/" + asset._name}});
+            auto key = release._tag + "/" + asset._name;
+            entry->_assets[std::move(key)] = std::make_shared<MockAsset const>(std::move(asset));
+        }
+        entry->_releases.push_back({{"id", release._id},
+                                    {"tag_name", release._tag},
+                                    {"draft", release._draft},
+                                    {"prerelease", release._prerelease},
+                                    {"published_at", release._publishedAt},
+                                    {"assets", std::move(assets)}});
+    }
+
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_repos[owner + "/" + repo] = std::move(entry);
+}
+void MockGitHubServer::setPayload(std::string const& owner, std::string const& repo, std::string payload)
+{
+    auto entry = std::make_shared<Repo>();
+    entry->_payload = std::move(payload);
+
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_repos[owner + "/" + repo] = std::move(entry);
+}
+void MockGitHubServer::resetRateLimit()
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_remaining = this->_g_options._rateLimit;
+    this->_g_reset = std::chrono::system_clock::now() + this->_g_options._rateLimitWindow;
+}
+
+MockGitHubCounters MockGitHubServer::getCounters() const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    return this->_g_counters;
+}
+
+void MockGitHubServer::route()
+{
+    using namespace httplib;
+
+    //The latency is waited outside of the lock so the concurrent requests overlap like on a real network
+    this->_g_server->set_pre_routing_handler([this](Request const&, Response&) {
+        std::chrono::milliseconds latency{0};
+        {
+            std::scoped_lock const lock(this->_g_mutex);
+            latency = this->_g_options._latency;
+        }
+        if (latency.count() > 0)
+        {
+            std::this_thread::sleep_for(latency);
+        }
+        return Server::HandlerResponse::Unhandled;
+    });
+
+    this->_g_server->Get(R"(/repos/([^/]+)/([^/]+)/releases)", [this](Request const& req, Response& res) {
+        std::size_t const perPage = std::clamp<std::size_t>(ReadParam(req, "per_page", 30), 1, 100);
+        std::size_t const page = std::max<std::size_t>(ReadParam(req, "page", 1), 1);
+
+        std::scoped_lock const lock(this->_g_mutex);
+        auto const now = std::chrono::system_clock::now();
+        if (now >= this->_g_reset)
+        {
+            this->_g_remaining = this->_g_options._rateLimit;
+            this->_g_reset = now + this->_g_options._rateLimitWindow;
+        }
+
+        auto const rateLimitHeaders = [&] {
+            auto const reset = std::chrono::duration_cast<std::chrono::seconds>(this->_g_reset.time_since_epoch());
+            res.set_header("X-RateLimit-Limit", std::to_string(this->_g_options._rateLimit));
+            res.set_header("X-RateLimit-Remaining", std::to_string(this->_g_remaining));
+            res.set_header("X-RateLimit-Reset", std::to_string(reset.count()));
+        };
+
+        std::string body;
+        auto const found = this->_g_repos.find(req.matches[1].str() + "/" + req.matches[2].str());
+        if (found == this->_g_repos.end())
+        {
+            ++this->_g_counters._notFound;
+        }
+        else if (found->second->_payload)
+        {
+            body = page == 1 ? *found->second->_payload : "[]";
+        }
+        else
+        {
+            auto const& releases = found->second->_releases;
+            nlohmann::json json = nlohmann::json::array();
+            for (std::size_t i = (page - 1) * perPage; i < releases.size() && i < page * perPage; ++i)
+            {
+                auto release = releases[i];
+                for (auto& asset : release["assets"])
+                {
+                    asset["browser_download_url"] = this->_g_baseUrl + asset["browser_download_url"].get<std::string>();
+                }
+                json.push_back(std::move(release));
+            }
+            body = json.dump();
+        }
+
+        //A matching conditional request is free, everything else is counted
+        auto const etag = MakeEtag(body);
+        if (found != this->_g_repos.end() && req.get_header_value("If-None-Match") == etag)
+        {
+            ++this->_g_counters._notModified;
+            rateLimitHeaders();
+            res.status = StatusCode::NotModified_304;
+            res.set_header("ETag", etag);
+            return;
+        }
+        if (this->_g_remaining == 0)
+        {
+            ++this->_g_counters._rateLimited;
+            rateLimitHeaders();
+            SetMessage(res, StatusCode::Forbidden_403, "API rate limit exceeded");
+            return;
+        }
+        --this->_g_remaining;
+        rateLimitHeaders();
+        if (found == this->_g_repos.end())
+        {
+            SetMessage(res, StatusCode::NotFound_404, "Not Found");
+            return;
+        }
+
+        ++this->_g_counters._releases;
+        res.set_header("ETag", etag);
+        res.set_content(body, "application/json; charset=utf-8");
+    });
+
+    this->_g_server->Get(R"(/([^/]+)/([^/]+)/releases/download/([^/]+)/([^/]+))", [this](Request const& req, Response& res) {
+        auto asset = this->findAsset(req.matches[1], req.matches[2], req.matches[3], req.matches[4]);
+        if (!asset)
+        {
+            std::scoped_lock const lock(this->_g_mutex);
+            ++this->_g_counters._notFound;
+            SetMessage(res, StatusCode::NotFound_404, "Not Found");
+            return;
+        }
+
+        {
+            std::scoped_lock const lock(this->_g_mutex);
+            if (this->_g_options._redirect)
+            {
+                ++this->_g_counters._redirects;
+                res.set_redirect(this->_g_baseUrl + "/objects/" + req.matches[1].str() + "/" + req.matches[2].str() + "/"
+                                 + req.matches[3].str() + "/" + req.matches[4].str());
+                return;
+            }
+        }
+        this->serveAsset(req, res, std::move(asset));
+    });
+
+    auto const assetHandler = [this](Request const& req, Response& res) {
+        auto asset = this->findAsset(req.matches[1], req.matches[2], req.matches[3], req.matches[4]);
+        if (!asset)
+        {
+            std::scoped_lock const lock(this->_g_mutex);
+            ++this->_g_counters._notFound;
+            SetMessage(res, StatusCode::NotFound_404, "Not Found");
+            return;
+        }
+        this->serveAsset(req, res, std::move(asset));
+    };
+    this->_g_server->Get(R"(/objects/([^/]+)/([^/]+)/([^/]+)/([^/]+))", assetHandler);
+    this->_g_server->Get(R"(/assets/([^/]+)/([^/]+)/([^/]+)/([^/]+))", assetHandler);
+}
+
+std::shared_ptr<MockAsset const> MockGitHubServer::findAsset(std::string const& owner,
+                                                             std::string const& repo,
+                                                             std::string const& tag,
+                                                             std::string const& asset) const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto const found = this->_g_repos.find(owner + "/" + repo);
+    if (found == this->_g_repos.end())
+    {
+        return nullptr;
+    }
+    auto const foundAsset = found->second->_assets.find(tag + "/" + asset);
+    if (foundAsset == found->second->_assets.end())
+    {
+        return nullptr;
+    }
+    return foundAsset->second;
+}
+void MockGitHubServer::serveAsset(httplib::Request const& req, httplib::Response& res, std::shared_ptr<MockAsset const> asset)
+{
+    uint64_t bandwidth = 0;
+    bool interrupted = false;
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        ++this->_g_counters._downloads;
+        if (!req.ranges.empty())
+        {
+            ++this->_g_counters._rangeDownloads;
+        }
+        bandwidth = this->_g_options._bandwidth;
+        if (this->_g_options._interruptedDownloads > 0)
+        {
+            --this->_g_options._interruptedDownloads;
+            interrupted = true;
+        }
+    }
+
+    //The content provider is ranged by httplib (206 and Content-Range), the asset stays alive with the provider
+    auto const size = asset->_data.size();
+    auto const contentType = asset->_contentType;
+    //Offset of the asset where the connection is closed
+    auto const cut = interrupted ? size / 2 : std::numeric_limits<std::size_t>::max();
+    res.set_content_provider(size, contentType, [asset = std::move(asset), bandwidth, cut](std::size_t offset, std::size_t length, httplib::DataSink& sink) {
+        if (offset >= cut)
+        {
+            return false;
+        }
+        length = std::min(length, cut - offset);
+        if (bandwidth == 0)
+        {
+            return sink.write(asset->_data.data() + offset, length);
+        }
+        auto const chunk = std::min<std::size_t>(length, GRUPDATER_MOCK_CHUNK_SIZE);
+        if (!sink.write(asset->_data.data() + offset, chunk))
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds{chunk * 1000000 / bandwidth});
+        return true;
+    });
+}
+
+}//namespace updater
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "updater.hpp"
+
+namespace httplib
+{
+struct Request;
+struct Response;
+}//namespace httplib
+
+namespace updater
+{
+
+/*
+ * MockAsset:
+ * A release asset of the MockGitHubServer, the default content type is the one accepted by SelectAsset.
+ */
+struct MockAsset
+{
+    std::string _name;
+    std::string _data;
+    std::string _contentType{"application/x-zip-compressed"};
+};
+
+/*
+ * MockRelease:
+ * A release of the MockGitHubServer, the releases of a repository are listed in the given order (newest first).
+ */
+struct MockRelease
+{
+    uint64_t _id{0};
+    std::string _tag;
+    bool _prerelease{false};
+    bool _draft{false};
+    std::string _publishedAt; //ISO 8601, may be empty
+    std::vector<MockAsset> _assets;
+};
+
+/*
+ * MockGitHubOptions:
+ * Behaviour of the MockGitHubServer, changeable while it is running.
+ */
+struct MockGitHubOptions
+{
+    std::chrono::milliseconds _latency{0}; //Waited before every response
+    uint64_t _bandwidth{0};                //Bytes per second of the asset bodies, 0 for unlimited
+    bool _redirect{true};                  //The downloads answer a 302 to /objects/ like github.com
+    uint32_t _rateLimit{60};               //API requests per window, the 304 answers are free like on GitHub
+    std::chrono::seconds _rateLimitWindow{3600};
+    uint32_t _interruptedDownloads{0};     //The next asset bodies are cut in their middle, for the resumed transfers
+};
+
+/*
+ * MockGitHubCounters:
+ * Requests answered by the MockGitHubServer since its start.
+ */
+struct MockGitHubCounters
+{
+    uint64_t _releases{0};    //Release list pages answered with a 200
+    uint64_t _notModified{0}; //Release list pages answered with a 304
+    uint64_t _rateLimited{0}; //API requests answered with a 403
+    uint64_t _redirects{0};
+    uint64_t _downloads{0};      //Asset bodies, ranged ones included
+    uint64_t _rangeDownloads{0}; //Asset bodies requested with a Range
+    uint64_t _notFound{0};
+};
+
+/*
+ * MockGitHubServer:
+ * In-process GitHub stand-in for the end-to-end tests and benchmarks of the real network paths, on a free port
+ * of the loopback, used through SetOrigins({getBaseUrl(), getBaseUrl()}):
+ * - /repos/{owner}/{repo}/releases?per_page&page : the configured releases (or raw payload) with an ETag
+ *   (If-None-Match answered with a 304) and the X-RateLimit headers (403 once exhausted)
+ * - /{owner}/{repo}/releases/download/{tag}/{asset} : 302 to /objects/ (or the asset when redirects are off)
+ * - /objects/{owner}/{repo}/{tag}/{asset} and the mirror path /assets/{owner}/{repo}/{tag}/{asset} :
+ *   the asset, Range requests are supported
+ */
+class MockGitHubServer
+{
+public:
+    explicit MockGitHubServer(MockGitHubOptions options = {});
+    ~MockGitHubServer();
+
+    MockGitHubServer(MockGitHubServer const&) = delete;
+    MockGitHubServer& operator=(MockGitHubServer const&) = delete;
+
+    //Return false if no port of the host can be bound
+    [[nodiscard]] bool start(std::string const& host = "127.0.0.1");
+    void stop();
+
+    //Empty before start()
+    [[nodiscard]] std::string getBaseUrl() const;
+
+    void setOptions(MockGitHubOptions options);
+    void setReleases(std::string const& owner, std::string const& repo, std::vector<MockRelease> releases);
+    //Served as is on the first page (the other pages are empty), for the malformed responses
+    void setPayload(std::string const& owner, std::string const& repo, std::string payload);
+    //Refill the rate limit and start a new window
+    void resetRateLimit();
+
+    [[nodiscard]] MockGitHubCounters getCounters() const;
+
+private:
+    struct Repo;
+
+    void route();
+    //Null if unknown
+    [[nodiscard]] std::shared_ptr<MockAsset const> findAsset(std::string const& owner,
+                                                             std::string const& repo,
+                                                             std::string const& tag,
+                                                             std::string const& asset) const;
+    void serveAsset(httplib::Request const& req, httplib::Response& res, std::shared_ptr<MockAsset const> asset);
+
+    std::unique_ptr<httplib::Server> _g_server;
+    std::thread _g_thread;
+    std::string _g_baseUrl;
+
+    mutable std::mutex _g_mutex;
+    MockGitHubOptions _g_options;
+    std::map<std::string, std::shared_ptr<Repo>> _g_repos;
+    MockGitHubCounters _g_counters;
+    uint32_t _g_remaining{0};
+    std::chrono::system_clock::time_point _g_reset;
+};
+
+}//namespace updater
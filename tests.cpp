@@ -0,0 +1,284 @@
+#include "updater.hpp"
+#include "mockgithub.hpp"
+#include <fstream>
+#include <iostream>
+
+/*
+ * GRUpdaterTests:
+ * End-to-end tests of RetrieveContext and DownloadAsset through the real HTTP code, against a MockGitHubServer.
+ * Every test runs in its own working directory (the release index and schedule files are written there),
+ * "GRUpdaterTests <name>" runs a single test, without argument all of them are run.
+ */
+
+namespace
+{
+
+//Accepted by SelectAsset
+constexpr char const* AssetName = "app-windows-x64.zip";
+
+bool gFailed = false;
+
+void Expect(bool condition, std::string_view message)
+{
+    if (!condition)
+    {
+        std::cerr << "  failed: " << message << '\n';
+        gFailed = true;
+    }
+}
+
+std::string AssetData(std::size_t size)
+{
+    std::string data(size, '\0');
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        data[i] = static_cast<char>((i * 31 + i / 251) & 0xFF);
+    }
+    return data;
+}
+
+bool StartServer(updater::MockGitHubServer& server)
+{
+    if (!server.start())
+    {
+        Expect(false, "the mock GitHub server started");
+        return false;
+    }
+    updater::SetOrigins({server.getBaseUrl(), server.getBaseUrl()});
+    return true;
+}
+
+/* Name: TestPrereleaseFallback
+ * Description: The newest release is a prerelease, it is only selected when allowed, else the newest stable one is
+ */
+void TestPrereleaseFallback()
+{
+    updater::MockGitHubServer server;
+    if (!StartServer(server))
+    {
+        return;
+    }
+    server.setReleases("owner", "prerelease", {{3, "v2.0.0-rc.1", true, false, {}, {{AssetName, "rc"}}},
+                                               {2, "v1.1.0", false, false, {}, {{AssetName, "stable"}}},
+                                               {1, "v1.0.0", false, false, {}, {{AssetName, "old"}}}});
+
+    auto const stable = updater::RetrieveContext("owner", "prerelease");
+    Expect(stable && stable->_latestTag == updater::MakeTag("v1.1.0"), "the newest stable release is selected");
+
+    auto const prerelease = updater::RetrieveContext("owner", "prerelease", true);
+    Expect(prerelease && prerelease->_latestTag == updater::MakeTag("v2.0.0-rc.1"), "the prerelease is selected when allowed");
+}
+
+/* Name: TestNotModified
+ * Description: A second check with the ETag of the saved release index is answered with a 304 and gives the same context
+ */
+void TestNotModified()
+{
+    updater::MockGitHubServer server;
+    if (!StartServer(server))
+    {
+        return;
+    }
+    server.setReleases("owner", "etag", {{1, "v1.0.0", false, false, {}, {{AssetName, "data"}}}});
+
+    auto const first = updater::RetrieveContext("owner", "etag");
+    //The second check reads the ETag from the release index file
+    updater::Session::getDefault().clearCaches();
+    auto const second = updater::RetrieveContext("owner", "etag");
+
+    auto const counters = server.getCounters();
+    Expect(first && second && first->_latestTag == second->_latestTag && first->_assetUrl == second->_assetUrl,
+           "the 304 gives the cached context");
+    Expect(counters._releases == 1, "a single release list is sent");
+    Expect(counters._notModified == 1, "the second check is answered with a 304");
+}
+
+/* Name: TestAlternatingRepos
+ * Description: The release indexes of two repositories checked in turn are cached in their own files
+ */
+void TestAlternatingRepos()
+{
+    updater::MockGitHubServer server;
+    if (!StartServer(server))
+    {
+        return;
+    }
+    server.setReleases("owner", "first", {{1, "v1.0.0", false, false, {}, {{AssetName, "first"}}}});
+    server.setReleases("owner", "second", {{2, "v2.0.0", false, false, {}, {{AssetName, "second"}}}});
+
+    Expect(updater::RetrieveContext("owner", "first").has_value() && updater::RetrieveContext("owner", "second").has_value(),
+           "the first checks succeed");
+    updater::Session::getDefault().clearCaches();
+    Expect(updater::RetrieveContext("owner", "first").has_value() && updater::RetrieveContext("owner", "second").has_value(),
+           "the second checks succeed");
+    Expect(server.getCounters()._notModified == 2, "both second checks are answered with a 304");
+}
+
+/* Name: TestRateLimited
+ * Description: Once the rate limit is exhausted the check fails with a 403 and the schedule file records it
+ */
+void TestRateLimited()
+{
+    updater::MockGitHubOptions options;
+    options._rateLimit = 1;
+    updater::MockGitHubServer server{options};
+    if (!StartServer(server))
+    {
+        return;
+    }
+    server.setReleases("owner", "ratelimit", {{1, "v1.0.0", false, false, {}, {{AssetName, "data"}}}});
+    Expect(updater::RetrieveContext("owner", "ratelimit").has_value(), "the first check succeeds");
+
+    //A new release, so the conditional request is not free
+    server.setReleases("owner", "ratelimit", {{2, "v1.1.0", false, false, {}, {{AssetName, "new"}}},
+                                              {1, "v1.0.0", false, false, {}, {{AssetName, "data"}}}});
+    Expect(!updater::RetrieveContext("owner", "ratelimit").has_value(), "the check fails once the rate limit is exhausted");
+    Expect(server.getCounters()._rateLimited == 1, "the check is answered with a 403");
+
+    auto const state = updater::GetScheduleState();
+    Expect(state && state->_rateLimit._remaining == 0u, "the exhausted rate limit is recorded");
+}
+
+/* Name: TestResumeDownload
+ * Description: The transfer from the mirror is interrupted, the origin continues it with a Range request
+ */
+void TestResumeDownload()
+{
+    updater::MockGitHubOptions options;
+    options._interruptedDownloads = 1;
+    updater::MockGitHubServer server{options};
+    if (!StartServer(server))
+    {
+        return;
+    }
+    auto const data = AssetData(1024 * 1024);
+    server.setReleases("owner", "resume", {{1, "v1.0.0", false, false, {}, {{AssetName, data}}}});
+
+    auto const context = updater::RetrieveContext("owner", "resume");
+    Expect(context.has_value(), "the release is found");
+    if (!context)
+    {
+        return;
+    }
+    //Another name of the same server, an unmeasured mirror is tried before the origin
+    auto mirror = server.getBaseUrl();
+    mirror.replace(mirror.find("127.0.0.1"), std::string_view{"127.0.0.1"}.size(), "localhost");
+
+    auto const assetPath = updater::DownloadAsset(*context, "temp/", {mirror});
+    Expect(assetPath.has_value(), "the download succeeds");
+    if (assetPath)
+    {
+        std::ifstream file(*assetPath, std::ios::binary);
+        std::string const content{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        Expect(content == data, "the resumed asset is complete");
+    }
+
+    auto const counters = server.getCounters();
+    Expect(counters._downloads == 2, "the transfer is done in 2 requests");
+    Expect(counters._rangeDownloads == 1, "the second request continues with a Range");
+}
+
+/* Name: TestPartialUpdate
+ * Description: A check failing on a later page keeps the previous ETag, the next check fetches the new releases again
+ */
+void TestPartialUpdate()
+{
+    updater::MockGitHubOptions options;
+    options._rateLimit = 2;
+    updater::MockGitHubServer server{options};
+    if (!StartServer(server))
+    {
+        return;
+    }
+    server.setReleases("owner", "partial", {{1, "v1.0.0", false, false, {}, {{AssetName, "data"}}}});
+    Expect(updater::RetrieveContext("owner", "partial").has_value(), "the first check succeeds");
+
+    //More new releases than a page, the second page is rate limited
+    std::vector<updater::MockRelease> releases;
+    for (uint64_t id = GRUPDATER_RELEASES_PER_PAGE + 50; id > 0; --id)
+    {
+        releases.push_back({id, "v1.0." + std::to_string(id - 1), false, false, {}, {{AssetName, "data"}}});
+    }
+    server.setReleases("owner", "partial", std::move(releases));
+    Expect(!updater::RetrieveContext("owner", "partial").has_value(), "the check fails on the rate limited page");
+
+    server.resetRateLimit();
+    updater::Session::getDefault().clearCaches();
+    auto const context = updater::RetrieveContext("owner", "partial");
+    Expect(context && context->_latestTag == updater::MakeTag("v1.0.149"), "the next check fetches the new releases");
+    Expect(server.getCounters()._notModified == 0, "the next check is not answered with a 304");
+}
+
+/* Name: TestAssetMirror
+ * Description: A mirror without the release list (404) does not fail the check, the origin answers it
+ */
+void TestAssetMirror()
+{
+    updater::MockGitHubServer server;
+    updater::MockGitHubServer mirror;
+    if (!StartServer(server) || !mirror.start())
+    {
+        return;
+    }
+    server.setReleases("owner", "mirror", {{1, "v1.0.0", false, false, {}, {{AssetName, "data"}}}});
+
+    auto const context = updater::RetrieveContext("owner", "mirror", false, {mirror.getBaseUrl()});
+    Expect(context && context->_latestTag == updater::MakeTag("v1.0.0"), "the origin answers the check");
+    Expect(mirror.getCounters()._notFound == 1, "the mirror is tried first");
+}
+
+struct TestCase
+{
+    char const* _name;
+    void (*_function)();
+};
+constexpr std::array<TestCase, 7> TestCases{{{"prereleaseFallback", TestPrereleaseFallback},
+                                             {"notModified", TestNotModified},
+                                             {"rateLimited", TestRateLimited},
+                                             {"resumeDownload", TestResumeDownload},
+                                             {"partialUpdate", TestPartialUpdate},
+                                             {"assetMirror", TestAssetMirror},
+                                             {"alternatingRepos", TestAlternatingRepos}}};
+
+}//namespace
+
+int main(int argc, char** argv)
+{
+    std::string_view const filter = argc > 1 ? argv[1] : "";
+    updater::Logger::get().setLevel(updater::LogLevel::Warning);
+
+    auto const rootPath = std::filesystem::current_path();
+    bool found = false;
+    for (auto const& testCase : TestCases)
+    {
+        if (!filter.empty() && filter != testCase._name)
+        {
+            continue;
+        }
+        found = true;
+        std::cout << testCase._name << '\n';
+
+        //DownloadAsset only accepts a relative directory, the index and schedule files are also written there
+        auto const workDirectory = rootPath / "tests" / testCase._name;
+        std::error_code errorCode;
+        std::filesystem::remove_all(workDirectory, errorCode);
+        std::filesystem::create_directories(workDirectory, errorCode);
+        std::filesystem::current_path(workDirectory, errorCode);
+        if (errorCode)
+        {
+            Expect(false, "the working directory is created");
+            continue;
+        }
+
+        testCase._function();
+
+        std::filesystem::current_path(rootPath, errorCode);
+        std::filesystem::remove_all(workDirectory, errorCode);
+    }
+    if (!found)
+    {
+        std::cerr << "Unknown test \"" << filter << "\"\n";
+        return 1;
+    }
+    return gFailed ? 1 : 0;
+}
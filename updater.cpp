@@ -2,8 +2,22 @@
 #include "httplib.h"
 #include "json.hpp"
 #include "updater.hpp"
+#include "applyplan.hpp"
 #include <zip.h>
+#ifdef _UPDATER_DEF_ZSTD
+    #include <zstd.h>
+#endif
 #include <fstream>
+#include <charconv>
+#include <thread>
+#include <climits>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <latch>
+#include <ctime>
+#include <cmath>
+#include <numeric>
 
 #ifndef WIN32_LEAN_AND_MEAN
     #define WIN32_LEAN_AND_MEAN
@@ -12,6 +26,8 @@
     #define NOMINMAX
 #endif
 #include <windows.h>
+#include <mswsock.h>
+#include <psapi.h>
 
 namespace updater
 {
@@ -19,729 +35,6145 @@ namespace updater
 namespace
 {
 
-bool IsSubDirectory(std::filesystem::path p, std::filesystem::path const& root)
+std::chrono::seconds::rep ToSeconds(std::chrono::system_clock::time_point const& time)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+std::chrono::system_clock::time_point FromSeconds(std::chrono::seconds::rep seconds)
+{
+    return std::chrono::system_clock::time_point{std::chrono::seconds{seconds}};
+}
+
+//ISO 8601 UTC time as sent by GitHub, e.g. "2024-03-01T12:34:56Z"
+std::optional<std::chrono::system_clock::time_point> ParseIsoTime(std::string_view str)
 {
-    while(!p.empty())
+    if (str.size() != 20 || str[4] != '-' || str[7] != '-' || str[10] != 'T'
+        || str[13] != ':' || str[16] != ':' || str[19] != 'Z')
     {
-        if (p == root)
+        return std::nullopt;
+    }
+
+    auto const readNumber = [str](std::size_t pos, std::size_t size) -> std::optional<int> {
+        int result = 0;
+        auto const [ptr, ec] = std::from_chars(str.data() + pos, str.data() + pos + size, result);
+        if (ec != std::errc{} || ptr != str.data() + pos + size)
         {
-            return true;
+            return std::nullopt;
         }
-        p = p.parent_path();
+        return result;
+    };
+
+    auto const year = readNumber(0, 4);
+    auto const month = readNumber(5, 2);
+    auto const day = readNumber(8, 2);
+    auto const hour = readNumber(11, 2);
+    auto const minute = readNumber(14, 2);
+    auto const second = readNumber(17, 2);
+    if (!year || !month || !day || !hour || !minute || !second)
+    {
+        return std::nullopt;
     }
-    return false;
+
+    std::chrono::year_month_day const date{std::chrono::year{*year},
+                                           std::chrono::month{static_cast<unsigned>(*month)},
+                                           std::chrono::day{static_cast<unsigned>(*day)}};
+    if (!date.ok())
+    {
+        return std::nullopt;
+    }
+
+    return std::chrono::sys_days{date} + std::chrono::hours{*hour} + std::chrono::minutes{*minute} + std::chrono::seconds{*second};
 }
 
+//Minutes since the local midnight
+std::chrono::minutes LocalMinuteOfDay()
+{
+    auto const now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local{};
+    localtime_s(&local, &now);
+    return std::chrono::hours{local.tm_hour} + std::chrono::minutes{local.tm_min};
 }
 
-const char* ToString(TagStatus status)
+uint64_t HashFnv1a(std::string_view data, uint64_t hash = 14695981039346656037ULL)
 {
-    switch (status)
+    for (char const c : data)
     {
-    case TagStatus::SameTag:
-        return "SameTag";
-    case TagStatus::NewerTag:
-        return "NewerTag";
-    case TagStatus::OlderTag:
-        return "OlderTag";
-    default:
-        return "Unknown";
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ULL;
     }
+    return hash;
 }
-std::optional<TagStatus> FromString(std::string const& status)
+
+std::string ReadMachineId()
 {
-    if (status == "SameTag")
+    if (auto const* machineId = std::getenv("GRUPDATER_MACHINE_ID"); machineId != nullptr && *machineId != '\0')
     {
-        return TagStatus::SameTag;
+        return machineId;
     }
-    if (status == "NewerTag")
+
+    std::array<wchar_t, 256> buffer{};
+    DWORD size = sizeof(buffer) - sizeof(wchar_t);
+    if (RegGetValueW(HKEY_LOCAL_MACHINE, L"SOFTWARE\\Microsoft\\Cryptography", L"MachineGuid",
+                     RRF_RT_REG_SZ | RRF_SUBKEY_WOW6464KEY, nullptr, buffer.data(), &size) != ERROR_SUCCESS)
     {
-        return TagStatus::NewerTag;
+        size = buffer.size() - 1;
+        if (!GetComputerNameW(buffer.data(), &size))
+        {
+            return {};
+        }
     }
-    if (status == "OlderTag")
+
+    //Both are plain ASCII
+    std::string result;
+    for (auto it = buffer.begin(); it != buffer.end() && *it != L'\0'; ++it)
     {
-        return TagStatus::OlderTag;
+        result.push_back(static_cast<char>(*it));
     }
-    return std::nullopt;
+    return result;
 }
 
-std::optional<Tag> ParseTag(std::string const& tag)
+void ReadRateLimit(HttpResponse const& res, RateLimitState& rateLimit)
 {
-    Tag result{};
-    if (sscanf(tag.c_str(), "v%u.%u.%u", &result.major, &result.minor, &result.patch) == 3)
-    {
+    auto const readNumber = [&res](char const* key) -> std::optional<uint64_t> {
+        if (!res.hasHeader(key))
+        {
+            return std::nullopt;
+        }
+        auto const value = res.getHeader(key);
+        uint64_t result = 0;
+        auto const [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (ec != std::errc{} || ptr == value.data())
+        {
+            return std::nullopt;
+        }
         return result;
+    };
+
+    if (auto const limit = readNumber("X-RateLimit-Limit"))
+    {
+        rateLimit._limit = static_cast<uint32_t>(*limit);
     }
-    if (sscanf(tag.c_str(), "%u.%u.%u", &result.major, &result.minor, &result.patch) == 3)
+    if (auto const remaining = readNumber("X-RateLimit-Remaining"))
     {
-        return result;
+        rateLimit._remaining = static_cast<uint32_t>(*remaining);
+        GetTelemetry()._rateLimitRemaining.store(static_cast<int64_t>(*remaining), std::memory_order_relaxed);
     }
-    return std::nullopt;
-}
-
-std::optional<RepoContext> RetrieveContext(std::string const& owner, std::string const& repo, [[maybe_unused]] bool allowPrerelease)
-{
-    using namespace httplib;
-
-    if (owner.empty() || repo.empty())
+    if (auto const reset = readNumber("X-RateLimit-Reset"))
     {
-        return std::nullopt;
+        rateLimit._reset = FromSeconds(static_cast<std::chrono::seconds::rep>(*reset));
     }
+    //GitHub only send a delay in seconds (not the HTTP date form)
+    if (auto const retryAfter = readNumber("Retry-After"))
+    {
+        rateLimit._retryAfter = std::chrono::system_clock::now() + std::chrono::seconds{*retryAfter};
+    }
+}
 
-#ifdef _UPDATER_DEF_DUMMYTEST
-    RepoContext context;
-    context._owner = owner;
-    context._repo = repo;
-    context._asset = "dummy.zip";
-    context._assetUrl = "dummy.zip";
-    context._latestTag = { 2, 0, 0 };
-    return context;
-#else
-    Client cli("https://api.github.com");
-
-    Headers headers = {
+HttpHeaders GitHubHeaders()
+{
+    return {
         { "Accept", "application/vnd.github+json" },
         { "X-GitHub-Api-Version", "2022-11-28" }
     };
+}
 
-    if (auto res = cli.Get("/repos/" + owner + "/" + repo + "/releases?per_page=1", headers))
+//Split an absolute URL into its origin (scheme://host[:port]) and its path, the origin of a path is empty
+std::pair<std::string, std::string> SplitUrl(std::string const& url)
+{
+    auto const scheme = url.find("://");
+    if (scheme == std::string::npos)
     {
-        if (res->status != StatusCode::OK_200)
-        {
-            return std::nullopt;
-        }
+        return {std::string{}, url};
+    }
+    auto const path = url.find('/', scheme + 3);
+    if (path == std::string::npos)
+    {
+        return {url, "/"};
+    }
+    return {url.substr(0, path), url.substr(path)};
+}
 
-        nlohmann::json json = nlohmann::json::parse(res->body);
-        if (json.empty() || !json.is_array())
-        {
-            return std::nullopt;
-        }
+struct OriginsState
+{
+    std::mutex _mutex;
+    Origins _origins;
+};
+OriginsState& GetOriginsState()
+{
+    static OriginsState state;
+    return state;
+}
+
+struct TransportState
+{
+    std::mutex _mutex;
+    std::shared_ptr<Transport> _transport; //Of SetTransport()
+};
+TransportState& GetTransportState()
+{
+    static TransportState state;
+    return state;
+}
 
-        bool prerelease = json[0]["prerelease"];
+std::string ReleasesPath(std::string const& owner, std::string const& repo, std::size_t page)
+{
+    return "/repos/" + owner + "/" + repo + "/releases?per_page=" + std::to_string(GRUPDATER_RELEASES_PER_PAGE)
+           + "&page=" + std::to_string(page);
+}
 
-        if (!allowPrerelease && prerelease)
-        {
-            return std::nullopt;
-        }
+std::string FormatIsoTime(std::chrono::system_clock::time_point const& time)
+{
+    auto const days = std::chrono::floor<std::chrono::days>(time);
+    std::chrono::year_month_day const date{days};
+    std::chrono::hh_mm_ss const clock{std::chrono::floor<std::chrono::seconds>(time - days)};
 
-        std::string tag_name = json[0]["tag_name"];
+    std::array<char, 32> buffer{};
+    std::snprintf(buffer.data(), buffer.size(), "%04d-%02u-%02uT%02d:%02d:%02dZ",
+                  static_cast<int>(date.year()), static_cast<unsigned>(date.month()), static_cast<unsigned>(date.day()),
+                  static_cast<int>(clock.hours().count()), static_cast<int>(clock.minutes().count()),
+                  static_cast<int>(clock.seconds().count()));
+    return buffer.data();
+}
 
-        auto tag = ParseTag(tag_name);
-        if (!tag)
-        {
-            return std::nullopt;
-        }
+//Metrics
 
-		auto assets = json[0]["assets"];
-        if (assets.empty() && !assets.is_array())
-        {
-            return std::nullopt;
-        }
+thread_local MetricsScope* gMetricsScope = nullptr;
+thread_local CancelScope* gCancelScope = nullptr;
+thread_local ProgressScope* gProgressScope = nullptr;
 
-        for (auto const& asset : assets)
-        {
-            std::string asset_name = asset["name"];
-            std::string asset_name_lower = asset_name;
-            std::ranges::transform(asset_name_lower, asset_name_lower.begin(), ::tolower);
+//Sub-timings of the request running on this thread, filled by the hooks of InstrumentClient
+struct HttpProbe
+{
+    using TimePoint = std::chrono::steady_clock::time_point;
 
-            if (asset_name_lower.find("windows") == std::string::npos)
-            {
-                continue;
-            }
+    TimePoint _begin{std::chrono::steady_clock::now()};
+    std::optional<TimePoint> _socket;
+    std::optional<TimePoint> _handshakeStart;
+    std::optional<TimePoint> _handshakeDone;
+    std::optional<TimePoint> _firstByte;
+};
+thread_local HttpProbe* gHttpProbe = nullptr;
+
+void MarkFirstByte()
+{
+    if (gHttpProbe != nullptr && !gHttpProbe->_firstByte)
+    {
+        gHttpProbe->_firstByte = std::chrono::steady_clock::now();
+    }
+}
 
-            if constexpr (sizeof(void*) == 8)
+//Hook the connection steps of the client (socket creation after the DNS resolution, TLS handshake)
+void InstrumentClient(httplib::Client& client)
+{
+    client.set_socket_options([](socket_t) {
+        if (gHttpProbe != nullptr)
+        {
+            gHttpProbe->_socket = std::chrono::steady_clock::now();
+        }
+    });
+    if (auto* context = client.ssl_context())
+    {
+        SSL_CTX_set_info_callback(context, [](SSL const*, int where, int) {
+            if (gHttpProbe == nullptr)
             {
-                if (asset_name_lower.find("64") == std::string::npos)
-                {
-                    continue;
-                }
+                return;
             }
-            else
+            auto const now = std::chrono::steady_clock::now();
+            if ((where & SSL_CB_HANDSHAKE_START) != 0 && !gHttpProbe->_handshakeStart)
             {
-                if (asset_name_lower.find("32") == std::string::npos)
-                {
-                    continue;
-                }
+                gHttpProbe->_handshakeStart = now;
             }
-
-            std::string content_type = asset["content_type"];
-            if (content_type != "application/x-zip-compressed")
+            if ((where & SSL_CB_HANDSHAKE_DONE) != 0 && !gHttpProbe->_handshakeDone)
             {
-                continue;
+                gHttpProbe->_handshakeDone = now;
             }
-
-            std::string asset_url = asset["browser_download_url"];
-
-            RepoContext context;
-            context._owner = owner;
-            context._repo = repo;
-            context._asset = std::move(asset_name);
-            context._assetUrl = std::move(asset_url);
-            context._latestTag = tag.value();
-            return context;
-        }
+        });
     }
-    return std::nullopt;
-#endif // _UPDATER_DEF_DUMMYTEST
 }
-TagStatus VerifyTag(RepoContext const& context, Tag const& currentTag)
+
+//Run a request of an instrumented client, its sub-timings are added to scope (if any)
+template<class TRequest>
+auto Probe(MetricsScope* scope, TRequest const& request)
 {
-	if (context._latestTag.major == currentTag.major)
+    if (scope == nullptr)
     {
-        if (context._latestTag.minor == currentTag.minor)
-        {
-            if (context._latestTag.patch == currentTag.patch)
-            {
-                return TagStatus::SameTag;
-            }
-            if (context._latestTag.patch > currentTag.patch)
-            {
-                return TagStatus::NewerTag;
-            }
-            return TagStatus::OlderTag;
-        }
-        if (context._latestTag.minor > currentTag.minor)
-        {
-            return TagStatus::NewerTag;
-        }
-        return TagStatus::OlderTag;
+        return request();
     }
-    if (context._latestTag.major > currentTag.major)
+
+    HttpProbe probe;
+    auto* const previous = std::exchange(gHttpProbe, &probe);
+    auto result = request();
+    gHttpProbe = previous;
+
+    auto const since = [](HttpProbe::TimePoint from, HttpProbe::TimePoint to) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(to - from);
+    };
+    HttpTimings timings;
+    timings._requests = 1;
+    if (probe._socket)
     {
-        return TagStatus::NewerTag;
+        timings._connections = 1;
+        timings._dns = since(probe._begin, *probe._socket);
+        if (probe._handshakeStart)
+        {
+            timings._connect = since(*probe._socket, *probe._handshakeStart);
+            timings._tls = since(*probe._handshakeStart, probe._handshakeDone.value_or(*probe._handshakeStart));
+        }
     }
-    return TagStatus::OlderTag;
+    timings._ttfb = since(probe._begin, probe._firstByte.value_or(std::chrono::steady_clock::now()));
+    scope->addHttp(timings);
+    return result;
 }
 
-std::optional<std::filesystem::path> DownloadAsset(RepoContext const& context, std::filesystem::path const& tempDir)
+//Process counters of PhaseMetrics (CPU times, I/O system calls, peak RSS)
+PhaseMetrics ReadProcessCounters()
 {
-	using namespace httplib;
+    PhaseMetrics counters;
+    auto* const process = GetCurrentProcess();
 
-    if (context._assetUrl.empty())
+    FILETIME creationTime;
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime))
     {
-        return std::nullopt;
+        //100 nanoseconds units
+        auto const toMicroseconds = [](FILETIME const& time) {
+            return std::chrono::microseconds{((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10};
+        };
+        counters._userTime = toMicroseconds(userTime);
+        counters._systemTime = toMicroseconds(kernelTime);
     }
 
-    if (tempDir.empty() || !tempDir.is_relative())
+    IO_COUNTERS io{};
+    if (GetProcessIoCounters(process, &io))
     {
-        return std::nullopt;
+        counters._readOperations = io.ReadOperationCount;
+        counters._writeOperations = io.WriteOperationCount;
+        counters._readBytes = io.ReadTransferCount;
+        counters._writeBytes = io.WriteTransferCount;
     }
 
-    //Check if tempDir is inside working directory
-    auto currentPath = std::filesystem::current_path();
-    auto fullPath = std::filesystem::absolute(tempDir);
-    auto relativePath = std::filesystem::relative(fullPath, currentPath) / "";
-
-    if (relativePath.lexically_normal() != tempDir.lexically_normal() || currentPath == fullPath)
+    PROCESS_MEMORY_COUNTERS memory{};
+    if (GetProcessMemoryInfo(process, &memory, sizeof(memory)))
     {
-        return std::nullopt;
+        counters._peakRss = memory.PeakWorkingSetSize;
     }
+    return counters;
+}
 
-    if (!std::filesystem::exists(tempDir))
+//Tracing
+
+std::atomic_bool gTraceEnabled{false};
+
+struct TraceEvent
+{
+    char const* _name;
+    std::string _detail;
+    std::chrono::steady_clock::time_point _begin;
+    std::chrono::steady_clock::duration _duration;
+    uint32_t _thread;
+};
+
+//Ring of the spans of a thread, the mutex is only contended by a dump
+struct TraceBuffer
+{
+    std::mutex _mutex;
+    std::vector<TraceEvent> _events;
+    std::size_t _next{0};
+};
+
+struct TraceRegistry
+{
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> _buffers;
+    std::vector<TraceBuffer*> _freeBuffers;
+    std::atomic<uint32_t> _nextThread{1};
+    std::chrono::steady_clock::time_point const _epoch{std::chrono::steady_clock::now()};
+};
+TraceRegistry& GetTraceRegistry()
+{
+    static TraceRegistry registry;
+    return registry;
+}
+
+//Buffer owned by the current thread, given back to the registry when the thread ends
+class ThreadTraceBuffer
+{
+public:
+    ThreadTraceBuffer() :
+            _g_thread(GetTraceRegistry()._nextThread.fetch_add(1, std::memory_order_relaxed))
     {
-        if (!std::filesystem::create_directories(tempDir))
+        auto& registry = GetTraceRegistry();
+        std::scoped_lock const lock(registry._mutex);
+        if (registry._freeBuffers.empty())
         {
-            return std::nullopt;
+            this->_g_buffer = registry._buffers.emplace_back(std::make_unique<TraceBuffer>()).get();
+        }
+        else
+        {
+            this->_g_buffer = registry._freeBuffers.back();
+            registry._freeBuffers.pop_back();
         }
     }
-    else if (!std::filesystem::is_directory(tempDir))
+    ~ThreadTraceBuffer()
     {
-        return std::nullopt;
+        auto& registry = GetTraceRegistry();
+        std::scoped_lock const lock(registry._mutex);
+        registry._freeBuffers.push_back(this->_g_buffer);
     }
 
-    if (!std::filesystem::is_empty(tempDir))
+    void record(TraceEvent event)
     {
-        std::filesystem::remove_all(tempDir);
-        if (!std::filesystem::create_directories(tempDir))
+        event._thread = this->_g_thread;
+        auto& buffer = *this->_g_buffer;
+        std::scoped_lock const lock(buffer._mutex);
+        if (buffer._events.size() < GRUPDATER_TRACE_RING_SIZE)
         {
-            return std::nullopt;
+            buffer._events.push_back(std::move(event));
         }
-    }
-
-#ifdef _UPDATER_DEF_DUMMYTEST
-    std::filesystem::path assetPath = tempDir / context._asset;
-    std::ofstream file(assetPath, std::ios::binary);
-    file << "Dummy data";
-    file.close();
-    return assetPath;
-#else
-    Client cli("https://github.com");
-    cli.set_follow_location(true);
-
-    if (auto res = cli.Get(context._assetUrl))
-    {
-        if (res->status != StatusCode::OK_200)
+        else
         {
-            return std::nullopt;
+            buffer._events[buffer._next] = std::move(event);
         }
-
-        std::filesystem::path assetPath = tempDir / context._asset;
-        std::ofstream file(assetPath, std::ios::binary);
-        file << res->body;
-        file.close();
-        return assetPath;
+        buffer._next = (buffer._next + 1) % GRUPDATER_TRACE_RING_SIZE;
     }
-    return std::nullopt;
-#endif // _UPDATER_DEF_DUMMYTEST
-}
-std::optional<std::filesystem::path> ExtractAsset(std::filesystem::path const& assetPath)
+
+private:
+    TraceBuffer* _g_buffer;
+    uint32_t _g_thread;
+};
+ThreadTraceBuffer& GetThreadTraceBuffer()
 {
-    if (!std::filesystem::exists(assetPath) || !std::filesystem::is_regular_file(assetPath))
-    {
-        return std::nullopt;
-    }
-    if (assetPath.extension() != ".zip")
-    {
-        return std::nullopt;
-    }
+    thread_local ThreadTraceBuffer buffer;
+    return buffer;
+}
 
-#ifdef _UPDATER_DEF_DUMMYTEST
-    std::filesystem::path extractPath = assetPath.parent_path() / "dummy";
-    if (!std::filesystem::exists(extractPath))
-    {
-        std::filesystem::create_directories(extractPath);
-    }
-    else if (!std::filesystem::is_directory(extractPath))
-    {
-        return std::nullopt;
-    }
+//A single path component coming from a request
+bool IsSafeName(std::string const& name)
+{
+    return !name.empty() && name != "." && name != ".."
+           && name.find_first_of("/\\:") == std::string::npos;
+}
 
-    std::ofstream file(extractPath / "dummy.txt");
-    file << "Dummy data";
-    file.close();
+std::string AssetPath(RepoContext const& context)
+{
+    return "/assets/" + context._owner + '/' + context._repo + '/' + ToString(context._latestTag) + '/' + context._asset;
+}
 
-    //Copy exe and dll files
-    auto currentPath = std::filesystem::current_path() / GRUPDATER_EXECUTABLE_NAME_W;
-    std::filesystem::copy_file(currentPath, extractPath / GRUPDATER_EXECUTABLE_NAME_W, std::filesystem::copy_options::overwrite_existing);
-    currentPath = std::filesystem::current_path() / GRUPDATER_DLL_NAME_W;
-    std::filesystem::copy_file(currentPath, extractPath / GRUPDATER_DLL_NAME_W, std::filesystem::copy_options::overwrite_existing);
+/*
+ * Hedged GET on the candidates ranked by latency: the best one is requested first and the second one
+ * is raced when the first has no response after its hedge delay, the loser is cancelled.
+ * If both fail, the next candidates are tried in order on the calling thread (like a single candidate).
+ * A candidate without response or with a server error is a failure, the mirrors (not origin) have 2s to connect.
+ * A mirror may not serve every path (e.g. a plain asset mirror), so only its 2xx and 304 answers are a success,
+ * the other answers of the origin are final and returned when no candidate succeeds.
+ */
+std::optional<HttpResponse> GetHedged(MirrorSelector& selector,
+                                      std::vector<std::string> const& candidates,
+                                      std::string const& origin,
+                                      Transport& transport,
+                                      std::string const& path,
+                                      HttpHeaders const& headers)
+{
+    using Clock = std::chrono::steady_clock;
 
-    return extractPath;
-#else
-    auto parentPath = assetPath.parent_path();
+    auto const isSuccess = [&origin](std::string const& candidate, std::optional<HttpResponse> const& result) {
+        if (!result)
+        {
+            return false;
+        }
+        if (candidate == origin)
+        {
+            return result->_status < httplib::StatusCode::InternalServerError_500;
+        }
+        return (result->_status >= httplib::StatusCode::OK_200 && result->_status < httplib::StatusCode::MultipleChoices_300)
+               || result->_status == httplib::StatusCode::NotModified_304;
+    };
+    auto* const scope = MetricsScope::current();
+    auto* const cancelScope = CancelScope::current();
+    auto const request = [&](std::string const& candidate, std::stop_source& stop) {
+        //The raced attempts run on their own threads, they measure into the scope of the caller
+        auto* const previousScope = std::exchange(gMetricsScope, scope);
+        std::stop_callback const cancel{cancelScope != nullptr ? cancelScope->getToken() : std::stop_token{}, [&stop] {
+            stop.request_stop();
+        }};
 
-    int err;
+        HttpRequest httpRequest;
+        httpRequest._baseUrl = candidate;
+        httpRequest._path = path;
+        httpRequest._headers = headers;
+        if (candidate != origin)
+        {
+            httpRequest._connectionTimeout = std::chrono::seconds{2};
+        }
+        httpRequest._stopToken = stop.get_token();
 
-    auto assetPathStr = assetPath.string();
-    auto* zip = zip_open(assetPathStr.c_str(), 0, &err);
-    if (zip == nullptr)
+        TraceSpan const span{"http", {candidate, path}};
+        auto const begin = Clock::now();
+        std::optional<Clock::duration> firstByte;
+        auto result = transport.get(httpRequest, [&](HttpResponse const&) {
+            firstByte = Clock::now() - begin;
+            return true;
+        });
+        if (isSuccess(candidate, result) || stop.stop_requested())
+        {
+            //Cancelled, the time until the cancellation is a lower bound (so a slow candidate is measured too)
+            selector.recordTimeToFirstByte(candidate, std::chrono::duration_cast<std::chrono::milliseconds>(firstByte.value_or(Clock::now() - begin)));
+        }
+        else
+        {
+            selector.recordFailure(candidate);
+        }
+        gMetricsScope = previousScope;
+        return result;
+    };
+
+    struct Attempt
+    {
+        std::stop_source _stop;
+        bool _done{false};
+        std::optional<HttpResponse> _result;
+        std::thread _thread;
+    };
+    std::array<Attempt, 2> attempts;
+    //A single candidate has nothing to race, it is requested inline below without a thread
+    std::size_t const raced = candidates.size() < attempts.size() ? 0 : attempts.size();
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    auto const start = [&](std::size_t index) {
+        attempts[index]._thread = std::thread([&, index] {
+            auto result = request(candidates[index], attempts[index]._stop);
+            {
+                std::scoped_lock const lock(mutex);
+                attempts[index]._result = std::move(result);
+                attempts[index]._done = true;
+            }
+            condition.notify_all();
+        });
+    };
+    auto const winner = [&]() -> Attempt* {
+        for (std::size_t i = 0; i < raced; ++i)
+        {
+            if (attempts[i]._done && isSuccess(candidates[i], attempts[i]._result))
+            {
+                return &attempts[i];
+            }
+        }
+        return nullptr;
+    };
+
+    std::optional<HttpResponse> result;
+    std::optional<HttpResponse> originResult;
+    auto const keep = [&](std::string const& candidate, std::optional<HttpResponse>&& attempt) {
+        if (candidate == origin && attempt)
+        {
+            originResult = attempt;
+        }
+        result = std::move(attempt);
+    };
+    if (raced > 0)
+    {
+        start(0);
+        {
+            std::unique_lock lock(mutex);
+            condition.wait_for(lock, selector.getHedgeDelay(candidates[0]), [&] { return attempts[0]._done; });
+        }
+        if (winner() == nullptr)
+        {
+            start(1);
+        }
+        {
+            std::unique_lock lock(mutex);
+            condition.wait(lock, [&] {
+                return winner() != nullptr || std::ranges::all_of(attempts, [](Attempt const& attempt) {
+                    return !attempt._thread.joinable() || attempt._done;
+                });
+            });
+            for (auto& attempt : attempts)
+            {
+                if (attempt._thread.joinable() && !attempt._done)
+                {
+                    attempt._stop.request_stop();
+                }
+            }
+        }
+        for (auto& attempt : attempts)
+        {
+            if (attempt._thread.joinable())
+            {
+                attempt._thread.join();
+            }
+        }
+
+        if (auto* attempt = winner())
+        {
+            return std::move(attempt->_result);
+        }
+        for (std::size_t i = 0; i < raced; ++i)
+        {
+            keep(candidates[i], std::move(attempts[i]._result));
+        }
+    }
+
+    for (std::size_t i = raced; i < candidates.size(); ++i)
+    {
+        std::stop_source stop;
+        auto attempt = request(candidates[i], stop);
+        if (isSuccess(candidates[i], attempt))
+        {
+            return attempt;
+        }
+        keep(candidates[i], std::move(attempt));
+    }
+    return originResult ? std::move(originResult) : std::move(result);
+}
+
+//A phase of the progress scope of this thread (if any), finished when leaving
+struct ProgressPhaseGuard
+{
+    ProgressPhaseGuard(ProgressPhase phase, std::optional<uint64_t> bytesTotal, uint64_t entryCount = 0) :
+            _scope(ProgressScope::current())
+    {
+        if (this->_scope != nullptr)
+        {
+            this->_scope->start(phase, bytesTotal, entryCount);
+        }
+    }
+    ~ProgressPhaseGuard()
+    {
+        if (this->_scope != nullptr)
+        {
+            this->_scope->finish(this->_success);
+        }
+    }
+
+    ProgressPhaseGuard(ProgressPhaseGuard const&) = delete;
+    ProgressPhaseGuard& operator=(ProgressPhaseGuard const&) = delete;
+
+    ProgressScope* _scope;
+    bool _success{false};
+};
+
+//Size of the whole file from the headers of a download answer
+std::optional<uint64_t> ReadTotalSize(HttpResponse const& response)
+{
+    std::string value;
+    if (response._status == httplib::StatusCode::PartialContent_206)
+    {
+        //bytes first-last/total
+        auto const range = response.getHeader("Content-Range");
+        auto const slash = range.rfind('/');
+        if (slash == std::string::npos)
+        {
+            return std::nullopt;
+        }
+        value = range.substr(slash + 1);
+    }
+    else
+    {
+        value = response.getHeader("Content-Length");
+    }
+
+    uint64_t result = 0;
+    auto const [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc{} || ptr == value.data())
     {
-        zip_error error{};
-        zip_error_init_with_code(&error, err);
-        auto buffer = zip_error_strerror(&error);
-        std::cerr << "Failed to open zip archive " << assetPathStr << ": " << buffer << '\n';
         return std::nullopt;
     }
+    return result;
+}
 
-    bool extractedFilesHaveRoot = true;
-    std::filesystem::path rootPath{};
+//Stream the body of a successful response into a file
+bool DownloadToFile(Transport& transport, HttpRequest const& request, std::filesystem::path const& filePath)
+{
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    auto& telemetry = GetTelemetry();
+    auto* const scope = MetricsScope::current();
+    TraceSpan const span{"http", {request._baseUrl, request._path}};
+    auto res = transport.get(request,
+        [](HttpResponse const& response) {
+            return response._status == httplib::StatusCode::OK_200;
+        },
+        [&](char const* data, std::size_t dataLength) {
+            GetBandwidthLimiter().acquire(dataLength);
+            file.write(data, static_cast<std::streamsize>(dataLength));
+            telemetry._downloadBytes.fetch_add(dataLength, std::memory_order_relaxed);
+            if (scope != nullptr)
+            {
+                scope->addBytes(dataLength);
+            }
+            return file.good();
+        });
+    file.close();
 
-    for (zip_int64_t i = 0; i < zip_get_num_entries(zip, 0); ++i)
+    if (!res || res->_status != httplib::StatusCode::OK_200)
     {
-        struct zip_stat zipStat{};
-        if (zip_stat_index(zip, i, 0, &zipStat) != 0)
+        std::error_code errorCode;
+        std::filesystem::remove(filePath, errorCode);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Continue the download of a file at offset with a Range request, the throughput is recorded for the candidate.
+ * A server ignoring the range restarts the file from the beginning (the caller truncates the file at the final offset).
+ */
+bool DownloadFrom(Transport& transport,
+                  HttpRequest request,
+                  std::ofstream& file,
+                  uint64_t& offset,
+                  MirrorSelector& selector,
+                  std::string const& candidate)
+{
+    using namespace httplib;
+
+    if (offset > 0)
+    {
+        request._rangeFrom = offset;
+    }
+    if (auto* const cancelScope = CancelScope::current())
+    {
+        request._stopToken = cancelScope->getToken();
+    }
+
+    auto& limiter = GetBandwidthLimiter();
+    auto& telemetry = GetTelemetry();
+    auto const begin = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration throttled{0};
+    uint64_t received = 0;
+    auto* const scope = MetricsScope::current();
+    auto* const progress = ProgressScope::current();
+    TraceSpan const span{"http", {candidate, request._path}};
+    auto res = transport.get(request,
+        [&](HttpResponse const& response) {
+            if (offset > 0 && response._status == StatusCode::PartialContent_206)
+            {
+                if (!response.getHeader("Content-Range").starts_with("bytes " + std::to_string(offset) + '-'))
+                {
+                    return false;
+                }
+            }
+            else if (response._status != StatusCode::OK_200)
+            {
+                return false;
+            }
+            else
+            {
+                offset = 0;
+                file.seekp(0);
+            }
+            if (auto const total = ReadTotalSize(response); progress != nullptr && total)
+            {
+                progress->setTotal(*total);
+            }
+            return true;
+        },
+        [&](char const* data, std::size_t dataLength) {
+            throttled += limiter.acquire(dataLength);
+            file.write(data, static_cast<std::streamsize>(dataLength));
+            offset += dataLength;
+            received += dataLength;
+            telemetry._downloadBytes.fetch_add(dataLength, std::memory_order_relaxed);
+            if (scope != nullptr)
+            {
+                scope->addBytes(dataLength);
+            }
+            if (progress != nullptr)
+            {
+                progress->update(offset, 0);
+            }
+            return file.good();
+        });
+
+    bool const success = res && (res->_status == StatusCode::OK_200 || res->_status == StatusCode::PartialContent_206) && file.good();
+    if (!success)
+    {
+        selector.recordFailure(candidate);
+        return false;
+    }
+
+    //The time throttled by the bandwidth limiter is not the fault of the candidate
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - begin - throttled;
+    if (received > 0 && elapsed.count() > 0)
+    {
+        selector.recordThroughput(candidate, static_cast<double>(received) / elapsed.count());
+    }
+    return true;
+}
+
+//Zero-copy file serving (plain HTTP)
+
+//Resolve a request target to a file, return the HTTP status (200 when filePath is ready)
+using FileResolver = std::function<int(std::string_view target, std::filesystem::path& filePath)>;
+
+struct ByteRange
+{
+    uint64_t _offset;
+    uint64_t _length;
+};
+
+bool EqualsIgnoreCase(std::string_view left, std::string_view right)
+{
+    return std::ranges::equal(left, right, [](char l, char r) {
+        return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r));
+    });
+}
+
+//Case insensitive suffix of a file name, e.g. ".tar.zst"
+bool HasExtension(std::string_view name, std::string_view extension)
+{
+    return name.size() > extension.size() && EqualsIgnoreCase(name.substr(name.size() - extension.size()), extension);
+}
+
+std::string_view Trim(std::string_view value)
+{
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+    {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+    {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+/*
+ * Single "bytes=" range of a file of the given size:
+ * - the whole file when there is no range, a malformed one or multiple ones (ignoring them is allowed by RFC 9110)
+ * - std::nullopt when the range is not satisfiable
+ */
+std::optional<ByteRange> ParseByteRange(std::string_view header, uint64_t size)
+{
+    ByteRange const whole{0, size};
+    if (!header.starts_with("bytes=") || header.find(',') != std::string_view::npos)
+    {
+        return whole;
+    }
+    header.remove_prefix(6);
+
+    auto const dash = header.find('-');
+    if (dash == std::string_view::npos)
+    {
+        return whole;
+    }
+    auto const parse = [](std::string_view text, uint64_t& value) {
+        text = Trim(text);
+        auto const [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && ec == std::errc{} && ptr == text.data() + text.size();
+    };
+
+    auto const first = Trim(header.substr(0, dash));
+    auto const last = Trim(header.substr(dash + 1));
+    uint64_t start = 0;
+    uint64_t end = 0;
+    if (first.empty())
+    {
+        //Suffix range: the last N bytes
+        if (!parse(last, end))
+        {
+            return whole;
+        }
+        if (end == 0 || size == 0)
         {
-            std::cerr << "Failed to get stat index " << i << " in zip archive " << assetPathStr << '\n';
-            zip_close(zip);
             return std::nullopt;
         }
+        end = std::min(end, size);
+        return ByteRange{size - end, end};
+    }
 
-        auto extractFilePath = std::filesystem::path{zipStat.name};
-        auto filePath = parentPath / extractFilePath;
-        std::cout << "Name: ["<< extractFilePath <<"], ";
-        std::cout << "Size: ["<< zipStat.size <<"], ";
-        std::cout << "mtime: ["<< zipStat.mtime <<"]\n";
+    if (!parse(first, start) || (!last.empty() && !parse(last, end)))
+    {
+        return whole;
+    }
+    if (start >= size)
+    {
+        return std::nullopt;
+    }
+    end = last.empty() ? size - 1 : std::min(end, size - 1);
+    if (end < start)
+    {
+        return whole;
+    }
+    return ByteRange{start, end - start + 1};
+}
 
-        if (extractFilePath.begin() != extractFilePath.end() && extractedFilesHaveRoot)
+bool SendAll(socket_t sock, std::string_view data)
+{
+    while (!data.empty())
+    {
+        auto const sent = send(sock, data.data(), static_cast<int>(std::min<std::size_t>(data.size(), INT_MAX)), 0);
+        if (sent <= 0)
         {
-            if (!extractFilePath.has_parent_path() && extractFilePath.has_filename())
-            {//File inside the root so there is no root directory
-                extractedFilesHaveRoot = false;
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+}
+
+//Send a part of a file to the socket, the bytes are copied by the kernel only
+bool SendFileRange(socket_t sock, std::filesystem::path const& filePath, ByteRange range)
+{
+    HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    while (range._length > 0)
+    {
+        //TransmitFile sends at most 2^31 - 2 bytes per call, starting from the file pointer
+        auto const chunk = static_cast<DWORD>(std::min<uint64_t>(range._length, 0x7FFFFFFE));
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(range._offset);
+        if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN) || !TransmitFile(sock, file, chunk, 0, nullptr, nullptr, 0))
+        {
+            break;
+        }
+        range._offset += chunk;
+        range._length -= chunk;
+    }
+    CloseHandle(file);
+    return range._length == 0;
+}
+
+void SetReceiveTimeout(socket_t sock, std::chrono::seconds timeout)
+{
+    auto const value = static_cast<DWORD>(std::chrono::milliseconds{timeout}.count());
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+socket_t OpenListenSocket(std::string const& host, int port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    addrinfo* result = nullptr;
+    auto const service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0)
+    {
+        return INVALID_SOCKET;
+    }
+
+    socket_t sock = INVALID_SOCKET;
+    for (auto const* info = result; info != nullptr; info = info->ai_next)
+    {
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (sock == INVALID_SOCKET)
+        {
+            continue;
+        }
+        int const yes = 1;
+        setsockopt(sock, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<char const*>(&yes), sizeof(yes));
+        if (bind(sock, info->ai_addr, static_cast<socklen_t>(info->ai_addrlen)) == 0 && ::listen(sock, SOMAXCONN) == 0)
+        {
+            break;
+        }
+        httplib::detail::close_socket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(result);
+    return sock;
+}
+
+//Minimal HTTP/1.1 server loop of one connection (GET and HEAD only, keep-alive supported)
+void ServeFileConnection(socket_t sock, FileResolver const& resolve)
+{
+    SetReceiveTimeout(sock, std::chrono::seconds{CPPHTTPLIB_KEEPALIVE_TIMEOUT_SECOND});
+
+    std::string buffer;
+    for (std::size_t count = 0; count < CPPHTTPLIB_KEEPALIVE_MAX_COUNT; ++count)
+    {
+        std::size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+        {
+            std::array<char, 4096> chunk;
+            if (buffer.size() > CPPHTTPLIB_HEADER_MAX_LENGTH)
+            {
+                return;
+            }
+            auto const received = recv(sock, chunk.data(), static_cast<int>(chunk.size()), 0);
+            if (received <= 0)
+            {
+                return;
             }
+            buffer.append(chunk.data(), static_cast<std::size_t>(received));
+        }
 
-            if (rootPath.empty())
+        std::string_view head{buffer.data(), headerEnd};
+        auto const lineEnd = head.find("\r\n");
+        auto const requestLine = head.substr(0, lineEnd);
+        head.remove_prefix(lineEnd == std::string_view::npos ? head.size() : lineEnd + 2);
+
+        auto const methodEnd = requestLine.find(' ');
+        auto const targetEnd = requestLine.rfind(' ');
+        if (methodEnd == std::string_view::npos || targetEnd <= methodEnd)
+        {
+            SendAll(sock, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return;
+        }
+        auto const method = requestLine.substr(0, methodEnd);
+        auto const target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        auto const version = requestLine.substr(targetEnd + 1);
+
+        std::string_view rangeHeader;
+        std::string_view connectionHeader;
+        bool hasBody = false;
+        while (!head.empty())
+        {
+            auto const end = head.find("\r\n");
+            auto const line = head.substr(0, end);
+            head.remove_prefix(end == std::string_view::npos ? head.size() : end + 2);
+
+            auto const colon = line.find(':');
+            if (colon == std::string_view::npos)
             {
-                rootPath = *extractFilePath.begin();
+                continue;
             }
-            else if (rootPath != *extractFilePath.begin())
+            auto const name = Trim(line.substr(0, colon));
+            auto const value = Trim(line.substr(colon + 1));
+            if (EqualsIgnoreCase(name, "Range"))
             {
-                extractedFilesHaveRoot = false;
+                rangeHeader = value;
+            }
+            else if (EqualsIgnoreCase(name, "Connection"))
+            {
+                connectionHeader = value;
+            }
+            else if ((EqualsIgnoreCase(name, "Content-Length") && value != "0") || EqualsIgnoreCase(name, "Transfer-Encoding"))
+            {
+                hasBody = true;
             }
         }
 
+        bool const keepAlive = !hasBody && count + 1 < CPPHTTPLIB_KEEPALIVE_MAX_COUNT
+                               && (version == "HTTP/1.1" ? !EqualsIgnoreCase(connectionHeader, "close")
+                                                         : EqualsIgnoreCase(connectionHeader, "keep-alive"));
+        bool const isHead = method == "HEAD";
+
+        auto const sendStatus = [&](int status, std::string_view extraHeaders = {}) {
+            std::string response = "HTTP/1.1 " + std::to_string(status) + ' ' + httplib::status_message(status) + "\r\n";
+            response += extraHeaders;
+            response += "Content-Length: 0\r\nConnection: ";
+            response += keepAlive ? "keep-alive" : "close";
+            response += "\r\n\r\n";
+            return SendAll(sock, response);
+        };
+
+        std::filesystem::path filePath;
+        int status = httplib::StatusCode::OK_200;
+        if (method != "GET" && !isHead)
+        {
+            status = httplib::StatusCode::MethodNotAllowed_405;
+        }
+        else
+        {
+            status = resolve(target, filePath);
+        }
+
         std::error_code errorCode;
-        std::filesystem::create_directories(filePath.parent_path(), errorCode);
+        uint64_t const size = status == httplib::StatusCode::OK_200 ? std::filesystem::file_size(filePath, errorCode) : 0;
+        if (errorCode)
+        {
+            status = httplib::StatusCode::NotFound_404;
+        }
+        if (status != httplib::StatusCode::OK_200)
+        {
+            if (!sendStatus(status) || !keepAlive)
+            {
+                return;
+            }
+            buffer.erase(0, headerEnd + 4);
+            continue;
+        }
 
-        if (errorCode.value() != 0)
+        auto const range = ParseByteRange(rangeHeader, size);
+        if (!range)
         {
-            std::cerr << "Failed to create directory " << filePath.parent_path() << " " << errorCode.message() << '\n';
-            zip_close(zip);
-            return std::nullopt;
+            if (!sendStatus(httplib::StatusCode::RangeNotSatisfiable_416, "Content-Range: bytes */" + std::to_string(size) + "\r\n") || !keepAlive)
+            {
+                return;
+            }
+            buffer.erase(0, headerEnd + 4);
+            continue;
+        }
+
+        bool const partial = !rangeHeader.empty() && range->_length != size;
+        status = partial ? httplib::StatusCode::PartialContent_206 : httplib::StatusCode::OK_200;
+        std::string response = "HTTP/1.1 " + std::to_string(status) + ' ' + httplib::status_message(status) + "\r\n";
+        response += "Content-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\n";
+        if (partial)
+        {
+            response += "Content-Range: bytes " + std::to_string(range->_offset) + '-'
+                        + std::to_string(range->_offset + range->_length - 1) + '/' + std::to_string(size) + "\r\n";
+        }
+        response += "Content-Length: " + std::to_string(range->_length) + "\r\nConnection: ";
+        response += keepAlive ? "keep-alive" : "close";
+        response += "\r\n\r\n";
+
+        if (!SendAll(sock, response) || (!isHead && !SendFileRange(sock, filePath, *range)) || !keepAlive)
+        {
+            return;
+        }
+        buffer.erase(0, headerEnd + 4);
+    }
+}
+
+//The files read back may be edited by hand, a field of an unexpected type must not throw a type_error
+template<class T>
+bool IsJsonType(nlohmann::json const& value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        return value.is_boolean();
+    }
+    else if constexpr (std::is_same_v<T, std::string>)
+    {
+        return value.is_string();
+    }
+    else
+    {
+        static_assert(std::is_integral_v<T>);
+        if (value.is_number_unsigned())
+        {
+            return std::in_range<T>(value.get<uint64_t>());
+        }
+        return value.is_number_integer() && std::in_range<T>(value.get<int64_t>());
+    }
+}
+//Same as json.value() but defaultValue is also returned for a field of another type (or a json that is not an object)
+template<class T>
+T JsonValue(nlohmann::json const& object, char const* key, T defaultValue)
+{
+    if (object.is_object())
+    {
+        auto const it = object.find(key);
+        if (it != object.end() && IsJsonType<T>(*it))
+        {
+            return it->template get<T>();
+        }
+    }
+    return defaultValue;
+}
+//The field is missing or of the expected type
+template<class T>
+bool IsJsonFieldValid(nlohmann::json const& object, char const* key)
+{
+    auto const it = object.find(key);
+    return it == object.end() || IsJsonType<T>(*it);
+}
+
+//Return the name and url of the asset compatible with this platform, in the format of the first archive backend available
+std::optional<std::pair<std::string, std::string>> SelectAsset(nlohmann::json const& assets)
+{
+    if (!assets.is_array())
+    {
+        return std::nullopt;
+    }
+
+    auto const isCompatible = [](std::string const& asset_name) {
+        std::string asset_name_lower = asset_name;
+        std::ranges::transform(asset_name_lower, asset_name_lower.begin(), ::tolower);
+
+        if (asset_name_lower.find("windows") == std::string::npos)
+        {
+            return false;
+        }
+
+        if constexpr (sizeof(void*) == 8)
+        {
+            return asset_name_lower.find("64") != std::string::npos;
+        }
+        else
+        {
+            return asset_name_lower.find("32") != std::string::npos;
+        }
+    };
+
+    for (auto const& backend : GetArchiveBackends())
+    {
+        auto const contentTypes = backend->getContentTypes();
+        for (auto const& asset : assets)
+        {
+            std::string asset_name = asset.value("name", std::string{});
+            if (!isCompatible(asset_name) || !HasExtension(asset_name, backend->getExtension()))
+            {
+                continue;
+            }
+
+            if (std::ranges::find(contentTypes, asset.value("content_type", std::string{})) == contentTypes.end())
+            {
+                continue;
+            }
+
+            return std::pair{std::move(asset_name), asset.value("browser_download_url", std::string{})};
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<ReleaseEntry> ParseRelease(nlohmann::json const& release)
+{
+    if (!release.is_object() || release.value("draft", false))
+    {
+        return std::nullopt;
+    }
+
+    auto tag = ParseTag(release.value("tag_name", std::string{}));
+    if (!tag)
+    {
+        return std::nullopt;
+    }
+
+    ReleaseEntry entry{};
+    entry._key = tag->key();
+    entry._tag = *tag;
+    entry._id = release.value("id", uint64_t{0});
+    entry._prerelease = release.value("prerelease", false) || tag->isPrerelease();
+    entry._publishedAt = ParseIsoTime(release.value("published_at", std::string{}));
+    if (auto asset = SelectAsset(release.value("assets", nlohmann::json::array())))
+    {
+        entry._asset = std::move(asset->first);
+        entry._assetUrl = std::move(asset->second);
+    }
+    return entry;
+}
+
+//Keep the GRUPDATER_ADAPTIVE_RELEASE_HISTORY most recent published times
+void MergeReleaseTimes(std::vector<std::chrono::system_clock::time_point>& releaseTimes, std::vector<ReleaseEntry> const& entries)
+{
+    for (auto const& entry : entries)
+    {
+        if (entry._publishedAt)
+        {
+            releaseTimes.push_back(*entry._publishedAt);
+        }
+    }
+
+    std::ranges::sort(releaseTimes, std::ranges::greater{});
+    auto const duplicates = std::ranges::unique(releaseTimes);
+    releaseTimes.erase(duplicates.begin(), duplicates.end());
+    if (releaseTimes.size() > GRUPDATER_ADAPTIVE_RELEASE_HISTORY)
+    {
+        releaseTimes.resize(GRUPDATER_ADAPTIVE_RELEASE_HISTORY);
+    }
+}
+
+//Record the check of a repository and forget the ones not checked for GRUPDATER_SCHEDULE_REPO_EXPIRY_HOURS
+void TrackRepo(ScheduleState& state, std::string repoName, std::chrono::system_clock::time_point now)
+{
+    state._repos[std::move(repoName)] = now;
+    std::erase_if(state._repos, [&now](auto const& repo) {
+        return repo.second + std::chrono::hours{GRUPDATER_SCHEDULE_REPO_EXPIRY_HOURS} < now;
+    });
+}
+
+//Exponentially weighted moving average, the first sample is the average
+double UpdateAverage(std::optional<double> const& average, double sample)
+{
+    return average ? (1.0 - GRUPDATER_MIRROR_EWMA_WEIGHT) * *average + GRUPDATER_MIRROR_EWMA_WEIGHT * sample : sample;
+}
+
+//Lowest possible key for this version (lower than any of its prerelease)
+TagKey LowestKey(uint32_t major, uint32_t minor, uint32_t patch)
+{
+    auto key = Tag{major, minor, patch}.key();
+    key._data[12] = 0x00;
+    return key;
+}
+TagKey HighestKey()
+{
+    TagKey key;
+    key._data.fill(0xFF);
+    return key;
+}
+
+//Archives
+
+//Entries of a libzip archive in the order of the central directory
+class ZipReader : public ArchiveReader
+{
+public:
+    explicit ZipReader(zip_t* zip) :
+            _zip(zip),
+            _count(std::max<zip_int64_t>(zip_get_num_entries(zip, 0), 0))
+    {}
+    ~ZipReader() override
+    {
+        this->closeEntry();
+        zip_close(this->_zip);
+    }
+
+    bool next(ArchiveEntry& entry) override
+    {
+        this->closeEntry();
+        if (this->_failed || ++this->_index >= this->_count)
+        {
+            return false;
+        }
+
+        struct zip_stat zipStat{};
+        if (zip_stat_index(this->_zip, this->_index, 0, &zipStat) != 0)
+        {
+            Log(LogLevel::Error) << "Failed to get stat index " << this->_index << " in zip archive";
+            this->_failed = true;
+            return false;
+        }
+        entry._name = zipStat.name;
+        entry._size = zipStat.size;
+        Log(LogLevel::Debug) << "Name: [" << entry._name << "], Size: [" << zipStat.size << "], mtime: [" << zipStat.mtime << ']';
+        if (entry._name.ends_with('/'))
+        {
+            return true;
+        }
+
+        this->_file = zip_fopen_index(this->_zip, this->_index, 0);
+        if (this->_file == nullptr)
+        {
+            Log(LogLevel::Error) << "Failed to open index " << this->_index << " in zip archive";
+            this->_failed = true;
+            return false;
+        }
+        return true;
+    }
+    int64_t read(char* data, std::size_t size) override
+    {
+        if (this->_file == nullptr)
+        {
+            return 0;
+        }
+        auto const dataSize = zip_fread(this->_file, data, size);
+        if (dataSize < 0)
+        {
+            this->_failed = true;
+        }
+        return dataSize;
+    }
+    bool hasFailed() const override
+    {
+        return this->_failed;
+    }
+    std::optional<ArchiveTotals> getTotals() override
+    {
+        //Read from the central directory only
+        ArchiveTotals totals;
+        totals._entries = static_cast<uint64_t>(this->_count);
+        for (zip_int64_t i = 0; i < this->_count; ++i)
+        {
+            struct zip_stat zipStat{};
+            if (zip_stat_index(this->_zip, i, 0, &zipStat) == 0 && (zipStat.valid & ZIP_STAT_SIZE) != 0)
+            {
+                totals._bytes += zipStat.size;
+            }
+        }
+        return totals;
+    }
+
+private:
+    void closeEntry()
+    {
+        if (this->_file != nullptr)
+        {
+            zip_fclose(this->_file);
+            this->_file = nullptr;
+        }
+    }
+
+    zip_t* _zip;
+    zip_int64_t _count;
+    zip_int64_t _index{-1};
+    zip_file_t* _file{nullptr};
+    bool _failed{false};
+};
+
+class ZipBackend : public ArchiveBackend
+{
+public:
+    std::string_view getExtension() const override
+    {
+        return ".zip";
+    }
+    std::vector<std::string> getContentTypes() const override
+    {
+        return {"application/x-zip-compressed"};
+    }
+    std::unique_ptr<ArchiveReader> open(std::filesystem::path const& archivePath) override
+    {
+        int err = 0;
+        auto const archivePathStr = archivePath.string();
+        auto* zip = zip_open(archivePathStr.c_str(), 0, &err);
+        if (zip == nullptr)
+        {
+            zip_error error{};
+            zip_error_init_with_code(&error, err);
+            Log(LogLevel::Error) << "Failed to open zip archive " << archivePathStr << ": " << zip_error_strerror(&error);
+            zip_error_fini(&error);
+            return nullptr;
+        }
+        return std::make_unique<ZipReader>(zip);
+    }
+};
+
+#ifdef _UPDATER_DEF_ZSTD
+/*
+ * Decompress a zstd file on its own thread into a bounded queue of GRUPDATER_ZSTD_BLOCK_SIZE blocks,
+ * so the decompression overlaps the parsing and the writes of the reader.
+ */
+class ZstdPipe
+{
+public:
+    explicit ZstdPipe(std::filesystem::path const& path) :
+            _file(path, std::ios::binary),
+            _context(ZSTD_createDCtx())
+    {
+        if (!this->_file.is_open() || this->_context == nullptr)
+        {
+            this->_finished = true;
+            this->_failed = true;
+            return;
+        }
+        ZSTD_DCtx_setParameter(this->_context, ZSTD_d_windowLogMax, GRUPDATER_ZSTD_WINDOW_LOG_MAX);
+        this->_thread = std::thread([this] { this->run(); });
+    }
+    ~ZstdPipe()
+    {
+        {
+            std::scoped_lock const lock(this->_mutex);
+            this->_stopped = true;
+        }
+        this->_condition.notify_all();
+        if (this->_thread.joinable())
+        {
+            this->_thread.join();
+        }
+        ZSTD_freeDCtx(this->_context);
+    }
+
+    ZstdPipe(ZstdPipe const&) = delete;
+    ZstdPipe& operator=(ZstdPipe const&) = delete;
+
+    //Copy size bytes, less only at the end of the stream, -1 on failure
+    int64_t read(char* data, std::size_t size)
+    {
+        std::size_t done = 0;
+        while (done < size)
+        {
+            if (this->_offset == this->_current.size())
+            {
+                std::unique_lock lock(this->_mutex);
+                this->_condition.wait(lock, [this] { return this->_finished || !this->_blocks.empty(); });
+                if (this->_blocks.empty())
+                {
+                    return this->_failed ? -1 : static_cast<int64_t>(done);
+                }
+                this->_current = std::move(this->_blocks.front());
+                this->_blocks.pop_front();
+                this->_offset = 0;
+                lock.unlock();
+                this->_condition.notify_all();
+            }
+            auto const count = std::min(size - done, this->_current.size() - this->_offset);
+            std::memcpy(data + done, this->_current.data() + this->_offset, count);
+            this->_offset += count;
+            done += count;
+        }
+        return static_cast<int64_t>(done);
+    }
+
+private:
+    void run()
+    {
+        std::vector<char> input(ZSTD_DStreamInSize());
+        ZSTD_inBuffer in{input.data(), 0, 0};
+        std::vector<char> block(GRUPDATER_ZSTD_BLOCK_SIZE);
+        ZSTD_outBuffer out{block.data(), block.size(), 0};
+        std::size_t pending = 0;
+        bool flushing = false;
+        for (;;)
+        {
+            if (in.pos == in.size && !flushing)
+            {
+                this->_file.read(input.data(), static_cast<std::streamsize>(input.size()));
+                in.size = static_cast<std::size_t>(this->_file.gcount());
+                in.pos = 0;
+                if (in.size == 0)
+                {
+                    //A truncated file ends in the middle of a frame
+                    block.resize(out.pos);
+                    bool const success = pending == 0 && !this->_file.bad() && this->push(std::move(block));
+                    this->finish(!success);
+                    return;
+                }
+            }
+
+            pending = ZSTD_decompressStream(this->_context, &out, &in);
+            if (ZSTD_isError(pending))
+            {
+                Log(LogLevel::Error) << "Failed to decompress zstd stream: " << ZSTD_getErrorName(pending);
+                this->finish(true);
+                return;
+            }
+            //A full output may hide more buffered data
+            flushing = out.pos == out.size;
+            if (flushing)
+            {
+                if (!this->push(std::move(block)))
+                {
+                    this->finish(true);
+                    return;
+                }
+                block = std::vector<char>(GRUPDATER_ZSTD_BLOCK_SIZE);
+                out = {block.data(), block.size(), 0};
+            }
+        }
+    }
+    //Wait for a free slot, false if the reader is gone
+    bool push(std::vector<char> block)
+    {
+        std::unique_lock lock(this->_mutex);
+        this->_condition.wait(lock, [this] { return this->_stopped || this->_blocks.size() < GRUPDATER_ZSTD_QUEUE_BLOCKS; });
+        if (this->_stopped)
+        {
+            return false;
+        }
+        this->_blocks.push_back(std::move(block));
+        lock.unlock();
+        this->_condition.notify_all();
+        return true;
+    }
+    void finish(bool failed)
+    {
+        {
+            std::scoped_lock const lock(this->_mutex);
+            this->_finished = true;
+            this->_failed = failed;
+        }
+        this->_condition.notify_all();
+    }
+
+    std::ifstream _file;
+    ZSTD_DCtx* _context;
+    std::vector<char> _current; //Only used by the reader
+    std::size_t _offset{0};
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::vector<char>> _blocks;
+    bool _finished{false};
+    bool _failed{false};
+    bool _stopped{false};
+    std::thread _thread;
+};
+
+//Octal (NUL or space terminated) or base-256 (GNU) number of a tar header field
+std::optional<uint64_t> ParseTarNumber(char const* field, std::size_t size)
+{
+    uint64_t value = 0;
+    if ((static_cast<unsigned char>(field[0]) & 0x80) != 0)
+    {
+        for (std::size_t i = 1; i < size; ++i)
+        {
+            value = value << 8 | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+
+    std::string_view text{field, strnlen(field, size)};
+    text = Trim(text);
+    auto const [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value, 8);
+    if (text.empty() || ec != std::errc{} || ptr != text.data() + text.size())
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+//Path of a pax extended header ("length key=value\n" records)
+std::optional<std::string> ReadPaxPath(std::string_view records)
+{
+    std::optional<std::string> path;
+    while (!records.empty())
+    {
+        auto const space = records.find(' ');
+        std::size_t length = 0;
+        auto const [ptr, ec] = std::from_chars(records.data(), records.data() + std::min(space, records.size()), length);
+        if (space == std::string_view::npos || ec != std::errc{} || length <= space + 1 || length > records.size())
+        {
+            break;
+        }
+        auto const record = records.substr(space + 1, length - space - 2);
+        if (record.starts_with("path="))
+        {
+            path = std::string{record.substr(5)};
+        }
+        records.remove_prefix(length);
+    }
+    return path;
+}
+
+//Entries of a POSIX (ustar, pax) or GNU tar streamed out of a ZstdPipe, only the files and directories are extracted
+class TarZstdReader : public ArchiveReader
+{
+public:
+    explicit TarZstdReader(std::filesystem::path const& path) :
+            _pipe(path)
+    {}
+
+    bool next(ArchiveEntry& entry) override
+    {
+        if (this->_failed || this->_ended || !this->skip(this->_remaining + this->_padding))
+        {
+            return false;
+        }
+        this->_remaining = 0;
+        this->_padding = 0;
+
+        std::optional<std::string> longName;
+        for (;;)
+        {
+            std::array<char, 512> header{};
+            auto const headerSize = this->_pipe.read(header.data(), header.size());
+            if (headerSize == 0 || (headerSize == static_cast<int64_t>(header.size()) && std::ranges::all_of(header, [](char c) { return c == '\0'; })))
+            {
+                this->_ended = true;
+                return false;
+            }
+            if (headerSize != static_cast<int64_t>(header.size()) || !IsTarChecksumValid(header))
+            {
+                return this->fail("Invalid tar header");
+            }
+
+            auto const size = ParseTarNumber(header.data() + 124, 12);
+            if (!size)
+            {
+                return this->fail("Invalid tar entry size");
+            }
+            uint64_t const padding = (512 - *size % 512) % 512;
+            char const type = header[156];
+
+            //GNU long name and pax headers describe the next entry
+            if (type == 'L' || type == 'x')
+            {
+                //The size comes from the archive, it is bounded before the allocation
+                if (*size > GRUPDATER_TAR_MAX_HEADER_SIZE)
+                {
+                    return this->fail("Invalid tar header");
+                }
+                std::string data(*size, '\0');
+                if (this->_pipe.read(data.data(), data.size()) != static_cast<int64_t>(data.size()) || !this->skip(padding))
+                {
+                    return this->fail("Truncated tar header");
+                }
+                if (type == 'L')
+                {
+                    longName = data.substr(0, data.find('\0'));
+                }
+                else if (auto path = ReadPaxPath(data))
+                {
+                    longName = std::move(path);
+                }
+                continue;
+            }
+
+            std::string name{header.data(), strnlen(header.data(), 100)};
+            //The prefix field only exists in the POSIX format
+            if (std::string_view{header.data() + 257, 6} == std::string_view{"ustar\0", 6} && header[345] != '\0')
+            {
+                name = std::string{header.data() + 345, strnlen(header.data() + 345, 155)} + '/' + name;
+            }
+            if (longName)
+            {
+                name = std::move(*longName);
+                longName.reset();
+            }
+
+            if (type == '5')
+            {
+                entry._name = name.ends_with('/') ? name : name + '/';
+                entry._size = 0;
+                this->_remaining = *size;
+                this->_padding = padding;
+                return true;
+            }
+            if (type == '0' || type == '\0' || type == '7')
+            {
+                entry._name = std::move(name);
+                entry._size = *size;
+                this->_remaining = *size;
+                this->_padding = padding;
+                Log(LogLevel::Debug) << "Name: [" << entry._name << "], Size: [" << entry._size << ']';
+                return true;
+            }
+
+            if (type != 'g')
+            {
+                Log(LogLevel::Warning) << "Skipped tar entry " << name << " of type '" << type << '\'';
+            }
+            if (!this->skip(*size + padding))
+            {
+                return this->fail("Truncated tar entry");
+            }
+        }
+    }
+    int64_t read(char* data, std::size_t size) override
+    {
+        auto const count = static_cast<std::size_t>(std::min<uint64_t>(size, this->_remaining));
+        if (count == 0 || this->_failed)
+        {
+            return this->_failed ? -1 : 0;
+        }
+        if (this->_pipe.read(data, count) != static_cast<int64_t>(count))
+        {
+            this->fail("Truncated tar entry");
+            return -1;
+        }
+        this->_remaining -= count;
+        return static_cast<int64_t>(count);
+    }
+    bool hasFailed() const override
+    {
+        return this->_failed;
+    }
+
+private:
+    static bool IsTarChecksumValid(std::array<char, 512> const& header)
+    {
+        auto const expected = ParseTarNumber(header.data() + 148, 8);
+        uint64_t sum = 0;
+        for (std::size_t i = 0; i < header.size(); ++i)
+        {
+            sum += i >= 148 && i < 156 ? static_cast<unsigned char>(' ') : static_cast<unsigned char>(header[i]);
+        }
+        return expected == sum;
+    }
+
+    bool skip(uint64_t size)
+    {
+        std::array<char, 4096> scratch{};
+        while (size > 0)
+        {
+            auto const count = static_cast<std::size_t>(std::min<uint64_t>(size, scratch.size()));
+            if (this->_pipe.read(scratch.data(), count) != static_cast<int64_t>(count))
+            {
+                return false;
+            }
+            size -= count;
+        }
+        return true;
+    }
+    bool fail(char const* message)
+    {
+        Log(LogLevel::Error) << message << " in tar.zst archive";
+        this->_failed = true;
+        return false;
+    }
+
+    ZstdPipe _pipe;
+    uint64_t _remaining{0};
+    uint64_t _padding{0};
+    bool _ended{false};
+    bool _failed{false};
+};
+
+class TarZstdBackend : public ArchiveBackend
+{
+public:
+    std::string_view getExtension() const override
+    {
+        return ".tar.zst";
+    }
+    std::vector<std::string> getContentTypes() const override
+    {
+        return {"application/zstd", "application/x-zstd", "application/octet-stream"};
+    }
+    std::unique_ptr<ArchiveReader> open(std::filesystem::path const& archivePath) override
+    {
+        if (!std::filesystem::is_regular_file(archivePath))
+        {
+            Log(LogLevel::Error) << "Failed to open tar.zst archive " << archivePath;
+            return nullptr;
+        }
+        return std::make_unique<TarZstdReader>(archivePath);
+    }
+};
+#endif // _UPDATER_DEF_ZSTD
+
+struct ArchiveBackendsState
+{
+    std::mutex _mutex;
+    std::vector<std::shared_ptr<ArchiveBackend>> _backends{
+#ifdef _UPDATER_DEF_ZSTD
+        std::make_shared<TarZstdBackend>(),
+#endif
+        std::make_shared<ZipBackend>()};
+};
+ArchiveBackendsState& GetArchiveBackendsState()
+{
+    static ArchiveBackendsState state;
+    return state;
+}
+
+//FileSystem
+
+class OsFileReader : public FileReader
+{
+public:
+    explicit OsFileReader(std::filesystem::path const& path) :
+            _g_file(path, std::ios::binary)
+    {}
+
+    [[nodiscard]] bool isOpen() const
+    {
+        return this->_g_file.is_open();
+    }
+
+    [[nodiscard]] int64_t read(char* data, std::size_t size) override
+    {
+        this->_g_file.read(data, static_cast<std::streamsize>(size));
+        if (this->_g_file.bad())
+        {
+            return -1;
+        }
+        return static_cast<int64_t>(this->_g_file.gcount());
+    }
+
+private:
+    std::ifstream _g_file;
+};
+class OsFileWriter : public FileWriter
+{
+public:
+    explicit OsFileWriter(std::filesystem::path const& path) :
+            _g_file(path, std::ios::binary | std::ios::trunc)
+    {}
+
+    [[nodiscard]] bool isOpen() const
+    {
+        return this->_g_file.is_open();
+    }
+
+    [[nodiscard]] bool write(char const* data, std::size_t size) override
+    {
+        this->_g_file.write(data, static_cast<std::streamsize>(size));
+        return this->_g_file.good();
+    }
+    [[nodiscard]] bool close() override
+    {
+        this->_g_file.close();
+        return !this->_g_file.fail();
+    }
+
+private:
+    std::ofstream _g_file;
+};
+
+FileStatus ToFileStatus(std::filesystem::file_status const& status, std::filesystem::path const& path)
+{
+    switch (status.type())
+    {
+    case std::filesystem::file_type::not_found:
+    case std::filesystem::file_type::none:
+        return {};
+    case std::filesystem::file_type::regular:
+    {
+        std::error_code errorCode;
+        auto const size = std::filesystem::file_size(path, errorCode);
+        return {FileType::Regular, errorCode ? 0 : size};
+    }
+    case std::filesystem::file_type::directory:
+        return {FileType::Directory, 0};
+    default:
+        return {FileType::Other, 0};
+    }
+}
+
+class MemoryFileReader : public FileReader
+{
+public:
+    explicit MemoryFileReader(std::shared_ptr<std::string> content) :
+            _g_content(std::move(content))
+    {}
+
+    [[nodiscard]] int64_t read(char* data, std::size_t size) override
+    {
+        auto const offset = std::min(this->_g_offset, this->_g_content->size());
+        auto const count = std::min(size, this->_g_content->size() - offset);
+        std::memcpy(data, this->_g_content->data() + offset, count);
+        this->_g_offset = offset + count;
+        return static_cast<int64_t>(count);
+    }
+
+private:
+    std::shared_ptr<std::string> _g_content;
+    std::size_t _g_offset{0};
+};
+class MemoryFileWriter : public FileWriter
+{
+public:
+    explicit MemoryFileWriter(std::shared_ptr<std::string> content) :
+            _g_content(std::move(content))
+    {}
+
+    [[nodiscard]] bool write(char const* data, std::size_t size) override
+    {
+        this->_g_content->append(data, size);
+        return true;
+    }
+    [[nodiscard]] bool close() override
+    {
+        return true;
+    }
+
+private:
+    std::shared_ptr<std::string> _g_content;
+};
+
+//Key of a MemoryFileSystem node, "" for the relative root
+std::string MemoryKey(std::filesystem::path const& path)
+{
+    auto key = path.lexically_normal().generic_string();
+    while (key.size() > 1 && key.back() == '/' && !std::filesystem::path{key}.relative_path().empty())
+    {
+        key.pop_back();
+    }
+    if (key == ".")
+    {
+        key.clear();
+    }
+    return key;
+}
+bool IsMemoryRoot(std::string const& key)
+{
+    return key.empty() || std::filesystem::path{key}.relative_path().empty();
+}
+std::string MemoryParentKey(std::string const& key)
+{
+    return MemoryKey(std::filesystem::path{key}.parent_path());
+}
+//Prefix of the keys below the directory key
+std::string MemoryChildPrefix(std::string const& key)
+{
+    return key.empty() || key.ends_with('/') ? key : key + '/';
+}
+bool IsMemoryChild(std::string const& key, std::string const& prefix)
+{
+    if (!key.starts_with(prefix) || key.size() == prefix.size())
+    {
+        return false;
+    }
+    //The relative root doesn't hold the absolute paths
+    return !prefix.empty() || !std::filesystem::path{key}.has_root_path();
+}
+
+/*
+ * GetKeptPaths:
+ * Paths (relative to target) that the apply never removes: the dynamic files listed in
+ * target/GRUPDATER_DEFAULT_DYNAMIC_FILE and the first folder of source from target (this should be "temp/").
+ */
+std::optional<std::vector<std::filesystem::path>> GetKeptPaths(FileSystem& fileSystem,
+                                                               std::filesystem::path const& source,
+                                                               std::filesystem::path const& target)
+{
+    std::filesystem::path temporaryPath = source.lexically_normal().lexically_relative(target.lexically_normal());
+    if (temporaryPath.empty() || temporaryPath == ".")
+    {
+        Log(LogLevel::Error) << "Failed to get temporary path";
+        return std::nullopt;
+    }
+
+    Log(LogLevel::Info) << "Temporary path: " << temporaryPath;
+
+    std::vector<std::filesystem::path> keptPaths;
+    if (*temporaryPath.begin() != "..")
+    {//Else outside of the target, nothing to keep
+        keptPaths.push_back(*temporaryPath.begin());
+    }
+
+    //Get the current json file telling where is all the dynamic files that should not be touched
+    auto dynamicFilesPath = target / GRUPDATER_DEFAULT_DYNAMIC_FILE;
+    if (fileSystem.stat(dynamicFilesPath)._type != FileType::Regular)
+    {
+        return keptPaths;
+    }
+    auto const dynamicFile = fileSystem.openRead(dynamicFilesPath);
+    if (!dynamicFile)
+    {
+        Log(LogLevel::Error) << "Failed to open dynamic files json";
+        return std::nullopt;
+    }
+
+    std::string content;
+    std::array<char, 4096> buffer{};
+    int64_t dataSize = 0;
+    while ((dataSize = dynamicFile->read(buffer.data(), buffer.size())) > 0)
+    {
+        content.append(buffer.data(), static_cast<std::size_t>(dataSize));
+    }
+
+    try
+    {
+        nlohmann::json dynamicFilesJson = nlohmann::json::parse(content);
+
+        for (auto& dynamicFileJson : dynamicFilesJson["files"])
+        {
+            keptPaths.emplace_back(dynamicFileJson.get<std::filesystem::path>().lexically_normal());
+        }
+    }
+    catch (const nlohmann::json::parse_error& e)
+    {
+        Log(LogLevel::Error) << "Failed to parse dynamicFiles.json: " << e.what();
+        return std::nullopt;
+    }
+    return keptPaths;
+}
+
+}
+
+//Logger
+
+const char* ToString(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Debug:
+        return "debug";
+    case LogLevel::Info:
+        return "info";
+    case LogLevel::Warning:
+        return "warning";
+    case LogLevel::Error:
+        return "error";
+    case LogLevel::Off:
+        return "off";
+    default:
+        return "unknown";
+    }
+}
+std::optional<LogLevel> ParseLogLevel(std::string_view level)
+{
+    for (auto const candidate : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Error, LogLevel::Off})
+    {
+        if (level == ToString(candidate))
+        {
+            return candidate;
+        }
+    }
+    return std::nullopt;
+}
+
+struct Logger::Queue
+{
+    struct Message
+    {
+        uint64_t _sequence{0};
+        LogLevel _level{LogLevel::Info};
+        std::string _text;
+    };
+
+    std::array<Message, GRUPDATER_LOG_QUEUE_SIZE> _messages;
+    std::atomic<std::size_t> _head{0}; //Next message to write, only moved by the sink thread
+    std::atomic<std::size_t> _tail{0}; //Next free slot, only moved by the owner thread
+    std::atomic_bool _closed{false}; //The owner thread ended
+};
+
+Logger& Logger::get()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Sink Logger::consoleSink()
+{
+    return [](LogLevel level, std::string_view message) {
+        auto& stream = level >= LogLevel::Warning ? std::cerr : std::cout;
+        stream << message << '\n';
+    };
+}
+Logger::Sink Logger::fileSink(std::filesystem::path const& logFile)
+{
+    auto file = std::make_shared<std::ofstream>(logFile, std::ios::app);
+    if (!file->is_open())
+    {
+        return nullptr;
+    }
+    return [file](LogLevel level, std::string_view message) {
+        *file << FormatIsoTime(std::chrono::system_clock::now()) << " [" << ToString(level) << "] " << message << std::endl;
+    };
+}
+
+Logger::Logger() :
+        _g_sink(consoleSink()),
+        _g_thread([this] { this->run(); })
+{}
+Logger::~Logger()
+{
+    this->_g_running = false;
+    this->_g_pushed.fetch_add(1, std::memory_order_release);
+    this->_g_pushed.notify_all();
+    if (this->_g_thread.joinable())
+    {
+        this->_g_thread.join();
+    }
+    //The sink thread may have been terminated before (process exit on Windows)
+    this->drain();
+}
+
+void Logger::setLevel(LogLevel level)
+{
+    this->_g_level.store(level, std::memory_order_relaxed);
+}
+void Logger::setSink(Sink sink)
+{
+    std::scoped_lock const lock(this->_g_sinkMutex);
+    this->_g_sink = std::move(sink);
+}
+
+void Logger::log(LogLevel level, std::string message)
+{
+    if (!this->isEnabled(level))
+    {
+        return;
+    }
+
+    auto& queue = this->getQueue();
+    auto const tail = queue._tail.load(std::memory_order_relaxed);
+    //Full, wait for the sink thread
+    while (tail - queue._head.load(std::memory_order_acquire) >= queue._messages.size())
+    {
+        this->_g_pushed.notify_all();
+        std::this_thread::yield();
+    }
+
+    auto& slot = queue._messages[tail % queue._messages.size()];
+    slot._sequence = this->_g_sequence.fetch_add(1, std::memory_order_relaxed);
+    slot._level = level;
+    slot._text = std::move(message);
+    queue._tail.store(tail + 1, std::memory_order_release);
+
+    this->_g_pushed.fetch_add(1, std::memory_order_release);
+    this->_g_pushed.notify_all();
+}
+
+void Logger::flush()
+{
+    auto const pushed = this->_g_pushed.load(std::memory_order_acquire);
+    for (auto written = this->_g_written.load(std::memory_order_acquire); written < pushed && this->_g_thread.joinable();
+         written = this->_g_written.load(std::memory_order_acquire))
+    {
+        this->_g_written.wait(written);
+    }
+}
+
+Logger::Queue& Logger::getQueue()
+{
+    //Owned by the thread and the logger, closed when the thread ends so the sink thread can forget it once empty
+    struct ThreadQueue
+    {
+        explicit ThreadQueue(Logger& logger)
+        {
+            std::scoped_lock const lock(logger._g_queuesMutex);
+            logger._g_queues.push_back(this->_queue);
+        }
+        ~ThreadQueue()
+        {
+            this->_queue->_closed.store(true, std::memory_order_release);
+        }
+
+        std::shared_ptr<Queue> _queue{std::make_shared<Queue>()};
+    };
+    thread_local ThreadQueue threadQueue{*this};
+    return *threadQueue._queue;
+}
+
+std::size_t Logger::drain()
+{
+    std::vector<Queue::Message> messages;
+    {
+        std::scoped_lock const lock(this->_g_queuesMutex);
+        for (auto const& queue : this->_g_queues)
+        {
+            auto head = queue->_head.load(std::memory_order_relaxed);
+            auto const tail = queue->_tail.load(std::memory_order_acquire);
+            for (; head != tail; ++head)
+            {
+                messages.push_back(std::move(queue->_messages[head % queue->_messages.size()]));
+            }
+            queue->_head.store(head, std::memory_order_release);
+        }
+        std::erase_if(this->_g_queues, [](auto const& queue) {
+            return queue->_closed.load(std::memory_order_acquire)
+                && queue->_head.load(std::memory_order_relaxed) == queue->_tail.load(std::memory_order_acquire);
+        });
+    }
+    if (messages.empty())
+    {
+        return 0;
+    }
+
+    std::ranges::sort(messages, {}, &Queue::Message::_sequence);
+    {
+        std::scoped_lock const lock(this->_g_sinkMutex);
+        if (this->_g_sink)
+        {
+            for (auto const& message : messages)
+            {
+                this->_g_sink(message._level, message._text);
+            }
+        }
+    }
+    this->_g_written.fetch_add(messages.size(), std::memory_order_release);
+    this->_g_written.notify_all();
+    return messages.size();
+}
+void Logger::run()
+{
+    for (;;)
+    {
+        auto const pushed = this->_g_pushed.load(std::memory_order_acquire);
+        if (this->drain() != 0)
+        {
+            continue;
+        }
+        if (!this->_g_running)
+        {
+            break;
+        }
+        this->_g_pushed.wait(pushed, std::memory_order_acquire);
+    }
+}
+
+LogStream::LogStream(LogLevel level) :
+        _g_level(level)
+{
+    if (Logger::get().isEnabled(level))
+    {
+        this->_g_stream = std::make_unique<std::ostringstream>();
+    }
+}
+LogStream::~LogStream()
+{
+    if (this->_g_stream)
+    {
+        Logger::get().log(this->_g_level, std::move(*this->_g_stream).str());
+    }
+}
+
+const char* ToString(TagStatus status)
+{
+    switch (status)
+    {
+    case TagStatus::SameTag:
+        return "SameTag";
+    case TagStatus::NewerTag:
+        return "NewerTag";
+    case TagStatus::OlderTag:
+        return "OlderTag";
+    default:
+        return "Unknown";
+    }
+}
+std::optional<TagStatus> FromString(std::string const& status)
+{
+    if (status == "SameTag")
+    {
+        return TagStatus::SameTag;
+    }
+    if (status == "NewerTag")
+    {
+        return TagStatus::NewerTag;
+    }
+    if (status == "OlderTag")
+    {
+        return TagStatus::OlderTag;
+    }
+    return std::nullopt;
+}
+
+//SemVer 2.0 precedence (§11), checked at build time
+static_assert(MakeTag("1.0.0-alpha") < MakeTag("1.0.0-alpha.1"));
+static_assert(MakeTag("1.0.0-alpha.1") < MakeTag("1.0.0-alpha.beta"));
+static_assert(MakeTag("1.0.0-alpha.beta") < MakeTag("1.0.0-beta"));
+static_assert(MakeTag("1.0.0-beta") < MakeTag("1.0.0-beta.2"));
+static_assert(MakeTag("1.0.0-beta.2") < MakeTag("1.0.0-beta.11"));
+static_assert(MakeTag("1.0.0-beta.11") < MakeTag("1.0.0-rc.1"));
+static_assert(MakeTag("1.0.0-rc.1") < MakeTag("1.0.0"));
+static_assert(MakeTag("1.0.0") < MakeTag("1.0.1") && MakeTag("1.0.1") < MakeTag("1.1.0") && MakeTag("1.1.0") < MakeTag("2.0.0"));
+static_assert(MakeTag("1.0.0") < MakeTag("1.0.1-alpha") && MakeTag("1.0.1-alpha").key() > MakeTag("1.0.0").key());
+//The build metadata is ignored
+static_assert(MakeTag("1.0.0+build.1") == MakeTag("1.0.0+build.2") && MakeTag("1.0.0-rc.1+a") == MakeTag("1.0.0-rc.1"));
+//Numeric identifiers have no leading zeros
+static_assert(!ParseTag("01.0.0") && !ParseTag("1.00.0") && !ParseTag("1.0.01") && !ParseTag("1.0.0-rc.01"));
+static_assert(ParseTag("0.0.0") && ParseTag("1.0.0-0a") && ParseTag("1.0.0+001"));
+
+std::string ToString(Tag const& tag)
+{
+    std::string result = 'v' + std::to_string(tag.major) + '.' + std::to_string(tag.minor) + '.' + std::to_string(tag.patch);
+    if (tag.isPrerelease())
+    {
+        result += '-';
+        result += tag.getPrerelease();
+    }
+    if (!tag.getBuild().empty())
+    {
+        result += '+';
+        result += tag.getBuild();
+    }
+    return result;
+}
+
+std::optional<TagRange> ParseTagRange(std::string_view range)
+{
+    if (range == "*")
+    {
+        return TagRange{{}, HighestKey()};
+    }
+    if (range.empty())
+    {
+        return std::nullopt;
+    }
+
+    char const op = range[0];
+    if (op != '^' && op != '~')
+    {
+        auto tag = ParseTag(range);
+        if (!tag)
+        {
+            return std::nullopt;
+        }
+
+        //The next key is the upper bound of a range containing only this tag
+        TagRange result{tag->key(), tag->key()};
+        for (auto it = result._upper._data.rbegin(); it != result._upper._data.rend(); ++it)
+        {
+            if (++(*it) != 0)
+            {
+                break;
+            }
+        }
+        return result;
+    }
+    range.remove_prefix(1);
+    if (!range.empty() && range[0] == 'v')
+    {
+        range.remove_prefix(1);
+    }
+
+    //Partial version: "1", "1.4" or "1.4.2"
+    std::array<uint32_t, 3> numbers{};
+    std::size_t count = 0;
+    while (!range.empty())
+    {
+        if (count == numbers.size())
+        {
+            return std::nullopt;
+        }
+
+        auto const dot = range.find('.');
+        auto const number = impl::ParseNumber(range.substr(0, dot));
+        if (!number)
+        {
+            return std::nullopt;
+        }
+        numbers[count++] = *number;
+
+        if (dot == std::string_view::npos)
+        {
+            break;
+        }
+        range.remove_prefix(dot + 1);
+        if (range.empty())
+        {
+            return std::nullopt;
+        }
+    }
+    if (count == 0)
+    {
+        return std::nullopt;
+    }
+
+    auto const [major, minor, patch] = numbers;
+    TagRange result{Tag{major, minor, patch}.key(), HighestKey()};
+
+    if (op == '^' && major == 0 && count >= 2)
+    {
+        if (minor == 0 && count == 3)
+        {
+            result._upper = patch == UINT32_MAX ? HighestKey() : LowestKey(0, 0, patch + 1);
+        }
+        else
+        {
+            result._upper = minor == UINT32_MAX ? HighestKey() : LowestKey(0, minor + 1, 0);
+        }
+    }
+    else if (op == '~' && count >= 2)
+    {
+        result._upper = minor == UINT32_MAX ? HighestKey() : LowestKey(major, minor + 1, 0);
+    }
+    else if (major != UINT32_MAX)
+    {
+        result._upper = LowestKey(major + 1, 0, 0);
+    }
+    return result;
+}
+
+//MetricsScope
+
+MetricsScope::MetricsScope(UpdateMetrics* metrics, std::string name) :
+        _g_metrics(metrics),
+        _g_previous(nullptr),
+        _g_begin(std::chrono::steady_clock::now())
+{
+    if (this->_g_metrics == nullptr)
+    {
+        return;
+    }
+    this->_g_phase._name = std::move(name);
+    this->_g_start = ReadProcessCounters();
+    this->_g_previous = std::exchange(gMetricsScope, this);
+}
+MetricsScope::~MetricsScope()
+{
+    if (this->_g_metrics == nullptr)
+    {
+        return;
+    }
+    gMetricsScope = this->_g_previous;
+
+    auto const end = ReadProcessCounters();
+    auto& phase = this->_g_phase;
+    phase._wallTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->_g_begin);
+    phase._userTime = end._userTime - this->_g_start._userTime;
+    phase._systemTime = end._systemTime - this->_g_start._systemTime;
+    phase._readOperations = end._readOperations - this->_g_start._readOperations;
+    phase._writeOperations = end._writeOperations - this->_g_start._writeOperations;
+    phase._readBytes = end._readBytes - this->_g_start._readBytes;
+    phase._writeBytes = end._writeBytes - this->_g_start._writeBytes;
+    phase._peakRss = end._peakRss;
+    this->_g_metrics->_phases.push_back(std::move(phase));
+}
+
+MetricsScope* MetricsScope::current()
+{
+    return gMetricsScope;
+}
+
+void MetricsScope::setSuccess(bool success)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_phase._success = success;
+}
+void MetricsScope::addBytes(uint64_t bytes)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_phase._bytes += bytes;
+}
+void MetricsScope::addFiles(uint64_t files)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    this->_g_phase._files += files;
+}
+void MetricsScope::addHttp(HttpTimings const& timings)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& http = this->_g_phase._http;
+    http._requests += timings._requests;
+    http._connections += timings._connections;
+    http._dns += timings._dns;
+    http._connect += timings._connect;
+    http._tls += timings._tls;
+    http._ttfb += timings._ttfb;
+}
+
+std::string ToJson(UpdateMetrics const& metrics)
+{
+    nlohmann::json phases = nlohmann::json::array();
+    for (auto const& phase : metrics._phases)
+    {
+        phases.push_back({{"name", phase._name},
+                          {"success", phase._success},
+                          {"wallTimeUs", phase._wallTime.count()},
+                          {"userTimeUs", phase._userTime.count()},
+                          {"systemTimeUs", phase._systemTime.count()},
+                          {"bytes", phase._bytes},
+                          {"files", phase._files},
+                          {"readOperations", phase._readOperations},
+                          {"writeOperations", phase._writeOperations},
+                          {"readBytes", phase._readBytes},
+                          {"writeBytes", phase._writeBytes},
+                          {"peakRss", phase._peakRss},
+                          {"http", {{"requests", phase._http._requests},
+                                    {"connections", phase._http._connections},
+                                    {"dnsUs", phase._http._dns.count()},
+                                    {"connectUs", phase._http._connect.count()},
+                                    {"tlsUs", phase._http._tls.count()},
+                                    {"ttfbUs", phase._http._ttfb.count()}}}});
+    }
+    return nlohmann::json{{"phases", std::move(phases)}}.dump(4);
+}
+
+//Telemetry
+
+Histogram::Histogram(std::vector<double> bounds) :
+        _g_bounds(std::move(bounds)),
+        _g_buckets(std::make_unique<std::atomic<uint64_t>[]>(this->_g_bounds.size() + 1))
+{}
+
+void Histogram::observe(double value)
+{
+    auto const bucket = std::ranges::lower_bound(this->_g_bounds, value) - this->_g_bounds.begin();
+    this->_g_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    this->_g_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::vector<double> const& Histogram::getBounds() const
+{
+    return this->_g_bounds;
+}
+uint64_t Histogram::getBucketCount(std::size_t index) const
+{
+    return this->_g_buckets[index].load(std::memory_order_relaxed);
+}
+double Histogram::getSum() const
+{
+    return this->_g_sum.load(std::memory_order_relaxed);
+}
+
+UpdaterTelemetry& GetTelemetry()
+{
+    static UpdaterTelemetry telemetry;
+    return telemetry;
+}
+
+std::string ToOpenMetrics(UpdaterTelemetry const& telemetry)
+{
+    std::string result;
+    auto const appendNumber = [&result](auto value) {
+        std::array<char, 32> buffer{};
+        auto const [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        result.append(buffer.data(), ptr);
+    };
+    auto const appendHeader = [&result](std::string_view name, std::string_view type, std::string_view help) {
+        result.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+        result.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    };
+    auto const appendCounter = [&](std::string_view name, std::string_view help, std::atomic<uint64_t> const& counter) {
+        appendHeader(name, "counter", help);
+        result.append(name).append("_total ");
+        appendNumber(counter.load(std::memory_order_relaxed));
+        result.push_back('\n');
+    };
+    auto const appendHistogram = [&](std::string_view name, std::string_view help, Histogram const& histogram) {
+        appendHeader(name, "histogram", help);
+        auto const& bounds = histogram.getBounds();
+        uint64_t count = 0;
+        for (std::size_t i = 0; i <= bounds.size(); ++i)
+        {
+            count += histogram.getBucketCount(i);
+            result.append(name).append("_bucket{le=\"");
+            if (i < bounds.size())
+            {
+                appendNumber(bounds[i]);
+            }
+            else
+            {
+                result.append("+Inf");
+            }
+            result.append("\"} ");
+            appendNumber(count);
+            result.push_back('\n');
+        }
+        result.append(name).append("_count ");
+        appendNumber(count);
+        result.push_back('\n');
+        result.append(name).append("_sum ");
+        appendNumber(histogram.getSum());
+        result.push_back('\n');
+    };
+
+    appendCounter("grupdater_checks", "Release list checks.", telemetry._checks);
+    appendCounter("grupdater_checks_not_modified", "Release list checks answered by 304 Not Modified.", telemetry._checksNotModified);
+    appendCounter("grupdater_check_failures", "Failed release list checks.", telemetry._checkFailures);
+    appendCounter("grupdater_downloads", "Downloaded assets.", telemetry._downloads);
+    appendCounter("grupdater_download_failures", "Failed asset downloads.", telemetry._downloadFailures);
+    appendCounter("grupdater_download_bytes", "Received asset bytes.", telemetry._downloadBytes);
+    appendHistogram("grupdater_download_seconds", "Duration of the successful asset downloads.", telemetry._downloadSeconds);
+    appendCounter("grupdater_extractions", "Extracted assets.", telemetry._extractions);
+    appendCounter("grupdater_extract_bytes", "Extracted bytes.", telemetry._extractBytes);
+    appendHistogram("grupdater_extract_bytes_per_second", "Throughput of the asset extractions.", telemetry._extractBytesPerSecond);
+    appendCounter("grupdater_applies", "Applied updates.", telemetry._applies);
+    appendHistogram("grupdater_apply_downtime_seconds", "Time from the caller exit to the updated files.", telemetry._applyDowntimeSeconds);
+
+    auto const rateLimitRemaining = telemetry._rateLimitRemaining.load(std::memory_order_relaxed);
+    if (rateLimitRemaining >= 0)
+    {
+        appendHeader("grupdater_rate_limit_remaining", "gauge", "Last GitHub API rate limit remaining.");
+        result.append("grupdater_rate_limit_remaining ");
+        appendNumber(rateLimitRemaining);
+        result.push_back('\n');
+    }
+
+    result.append("# EOF\n");
+    return result;
+}
+
+//Tracer
+
+void Tracer::setEnabled(bool enabled)
+{
+    gTraceEnabled.store(enabled, std::memory_order_relaxed);
+}
+bool Tracer::isEnabled()
+{
+    return gTraceEnabled.load(std::memory_order_relaxed);
+}
+
+std::string Tracer::dump()
+{
+    auto& registry = GetTraceRegistry();
+    auto const toMicroseconds = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(duration).count();
+    };
+
+    nlohmann::json events = nlohmann::json::array();
+    std::scoped_lock const lock(registry._mutex);
+    for (auto const& buffer : registry._buffers)
+    {
+        std::scoped_lock const bufferLock(buffer->_mutex);
+        for (auto const& event : buffer->_events)
+        {
+            nlohmann::json json{{"name", event._name},
+                                {"cat", "updater"},
+                                {"ph", "X"},
+                                {"ts", toMicroseconds(event._begin - registry._epoch)},
+                                {"dur", toMicroseconds(event._duration)},
+                                {"pid", 1},
+                                {"tid", event._thread}};
+            if (!event._detail.empty())
+            {
+                json["args"] = {{"detail", event._detail}};
+            }
+            events.push_back(std::move(json));
+        }
+    }
+    return nlohmann::json{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}}.dump();
+}
+bool Tracer::dump(std::filesystem::path const& traceFile)
+{
+    std::ofstream file(traceFile, std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    file << Tracer::dump();
+    return file.good();
+}
+
+//TraceSpan
+
+TraceSpan::TraceSpan(char const* name, std::initializer_list<std::string_view> details) :
+        _g_name(name),
+        _g_enabled(gTraceEnabled.load(std::memory_order_relaxed))
+{
+    if (!this->_g_enabled)
+    {
+        return;
+    }
+    for (auto const detail : details)
+    {
+        this->_g_detail.append(detail);
+    }
+    this->_g_begin = std::chrono::steady_clock::now();
+}
+TraceSpan::~TraceSpan()
+{
+    if (!this->_g_enabled)
+    {
+        return;
+    }
+    GetThreadTraceBuffer().record({this->_g_name,
+                                   std::move(this->_g_detail),
+                                   this->_g_begin,
+                                   std::chrono::steady_clock::now() - this->_g_begin,
+                                   0});
+}
+
+//MetricsServer
+
+MetricsServer::MetricsServer() = default;
+MetricsServer::~MetricsServer()
+{
+    this->stop();
+}
+
+bool MetricsServer::start(std::string const& host, int port)
+{
+    this->stop();
+
+    this->_g_server = std::make_unique<httplib::Server>();
+    this->_g_server->Get("/metrics", [](httplib::Request const&, httplib::Response& res) {
+        res.set_content(ToOpenMetrics(GetTelemetry()), "application/openmetrics-text; version=1.0.0; charset=utf-8");
+    });
+    if (!this->_g_server->bind_to_port(host, port))
+    {
+        this->_g_server.reset();
+        return false;
+    }
+
+    this->_g_thread = std::thread([server = this->_g_server.get()] {
+        server->listen_after_bind();
+    });
+    return true;
+}
+void MetricsServer::stop()
+{
+    if (this->_g_server)
+    {
+        this->_g_server->stop();
+    }
+    if (this->_g_thread.joinable())
+    {
+        this->_g_thread.join();
+    }
+    this->_g_server.reset();
+}
+
+//BandwidthLimiter
+
+std::optional<BandwidthProfile> ParseBandwidthProfile(std::string_view profile)
+{
+    //HH:MM-HH:MM=rate
+    if (profile.size() < 13 || profile[2] != ':' || profile[5] != '-' || profile[8] != ':' || profile[11] != '=')
+    {
+        return std::nullopt;
+    }
+
+    auto const readNumber = [](std::string_view str, uint64_t& value) {
+        auto const [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        return ec == std::errc{} && ptr == str.data() + str.size();
+    };
+    auto const readTime = [&](std::size_t pos) -> std::optional<std::chrono::minutes> {
+        uint64_t hour = 0;
+        uint64_t minute = 0;
+        if (!readNumber(profile.substr(pos, 2), hour) || !readNumber(profile.substr(pos + 3, 2), minute) || hour > 24 || minute > 59
+            || (hour == 24 && minute != 0))
+        {
+            return std::nullopt;
+        }
+        return std::chrono::hours{hour} + std::chrono::minutes{minute};
+    };
+
+    auto const begin = readTime(0);
+    auto const end = readTime(6);
+    if (!begin || !end)
+    {
+        return std::nullopt;
+    }
+
+    auto rate = profile.substr(12);
+    uint64_t multiplier = 1;
+    switch (rate.empty() ? '\0' : std::toupper(static_cast<unsigned char>(rate.back())))
+    {
+    case 'K': multiplier = uint64_t{1} << 10; break;
+    case 'M': multiplier = uint64_t{1} << 20; break;
+    case 'G': multiplier = uint64_t{1} << 30; break;
+    default: break;
+    }
+    if (multiplier != 1)
+    {
+        rate.remove_suffix(1);
+    }
+
+    uint64_t bytesPerSecond = 0;
+    if (rate.empty() || !readNumber(rate, bytesPerSecond))
+    {
+        return std::nullopt;
+    }
+    return BandwidthProfile{*begin, *end, bytesPerSecond * multiplier};
+}
+
+BandwidthLimiter::BandwidthLimiter(uint64_t bytesPerSecond, uint64_t burst) :
+        _g_bytesPerSecond(bytesPerSecond),
+        _g_burst(std::max<uint64_t>(burst, 1)),
+        _g_tokens(static_cast<double>(this->_g_burst)),
+        _g_lastRefill(std::chrono::steady_clock::now())
+{}
+
+void BandwidthLimiter::setLimit(uint64_t bytesPerSecond, uint64_t burst)
+{
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_bytesPerSecond = bytesPerSecond;
+        this->_g_burst = std::max<uint64_t>(burst, 1);
+        this->_g_tokens = std::min(this->_g_tokens, static_cast<double>(this->_g_burst));
+    }
+    this->_g_condition.notify_all();
+}
+void BandwidthLimiter::setProfiles(std::vector<BandwidthProfile> profiles)
+{
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_profiles = std::move(profiles);
+    }
+    this->_g_condition.notify_all();
+}
+uint64_t BandwidthLimiter::getLimit() const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    return this->getRate();
+}
+
+std::chrono::steady_clock::duration BandwidthLimiter::acquire(std::size_t size)
+{
+    auto const begin = std::chrono::steady_clock::now();
+
+    std::unique_lock lock(this->_g_mutex);
+    auto remaining = static_cast<uint64_t>(size);
+    while (remaining > 0)
+    {
+        auto const rate = this->getRate();
+        auto const now = std::chrono::steady_clock::now();
+        if (rate == 0)
+        {
+            //Unlimited, the bucket stays full for when a limit is set
+            this->_g_tokens = static_cast<double>(this->_g_burst);
+            this->_g_lastRefill = now;
+            break;
+        }
+
+        std::chrono::duration<double> const elapsed = now - this->_g_lastRefill;
+        this->_g_tokens = std::min(static_cast<double>(this->_g_burst), this->_g_tokens + elapsed.count() * static_cast<double>(rate));
+        this->_g_lastRefill = now;
+
+        //A chunk larger than the burst is taken in many parts
+        auto const chunk = std::min(remaining, this->_g_burst);
+        if (this->_g_tokens >= static_cast<double>(chunk))
+        {
+            this->_g_tokens -= static_cast<double>(chunk);
+            remaining -= chunk;
+            continue;
+        }
+
+        std::chrono::duration<double> const missing{(static_cast<double>(chunk) - this->_g_tokens) / static_cast<double>(rate)};
+        this->_g_condition.wait_for(lock, std::min<std::chrono::duration<double>>(missing, std::chrono::milliseconds{GRUPDATER_BANDWIDTH_MAX_WAIT_MS}));
+    }
+    return std::chrono::steady_clock::now() - begin;
+}
+
+uint64_t BandwidthLimiter::getRate() const
+{
+    if (!this->_g_profiles.empty())
+    {
+        auto const minute = LocalMinuteOfDay();
+        for (auto const& profile : this->_g_profiles)
+        {
+            bool const inside = profile._begin <= profile._end ? (profile._begin <= minute && minute < profile._end)
+                                                               : (profile._begin <= minute || minute < profile._end);
+            if (inside)
+            {
+                return profile._bytesPerSecond;
+            }
+        }
+    }
+    return this->_g_bytesPerSecond;
+}
+
+BandwidthLimiter& GetBandwidthLimiter()
+{
+    static BandwidthLimiter limiter;
+    return limiter;
+}
+
+//Origins
+
+void SetOrigins(Origins origins)
+{
+    auto& state = GetOriginsState();
+    std::scoped_lock const lock(state._mutex);
+    state._origins = std::move(origins);
+}
+Origins GetOrigins()
+{
+    auto& state = GetOriginsState();
+    std::scoped_lock const lock(state._mutex);
+    return state._origins;
+}
+
+//MirrorSelector
+
+MirrorSelector::MirrorSelector(std::vector<std::string> mirrors, std::map<std::string, MirrorStats> stats) :
+        _g_mirrors(std::move(mirrors)),
+        _g_stats(std::move(stats))
+{}
+
+std::vector<std::string> const& MirrorSelector::getMirrors() const
+{
+    return this->_g_mirrors;
+}
+std::vector<std::string> MirrorSelector::rankByLatency(std::string const& origin) const
+{
+    return this->rank(origin, [](MirrorStats const& stats) -> std::optional<double> {
+        return stats._ttfb;
+    });
+}
+std::vector<std::string> MirrorSelector::rankByThroughput(std::string const& origin) const
+{
+    return this->rank(origin, [](MirrorStats const& stats) -> std::optional<double> {
+        return stats._throughput ? std::optional{-*stats._throughput} : std::nullopt;
+    });
+}
+std::chrono::milliseconds MirrorSelector::getHedgeDelay(std::string const& candidate) const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto const it = this->_g_stats.find(candidate);
+    if (it == this->_g_stats.end() || !it->second._ttfb)
+    {
+        return std::chrono::milliseconds{GRUPDATER_MIRROR_DEFAULT_HEDGE_DELAY_MS};
+    }
+    return std::chrono::milliseconds{std::clamp<std::chrono::milliseconds::rep>(static_cast<std::chrono::milliseconds::rep>(2.0 * *it->second._ttfb),
+                                                                                GRUPDATER_MIRROR_MIN_HEDGE_DELAY_MS,
+                                                                                GRUPDATER_MIRROR_DEFAULT_HEDGE_DELAY_MS)};
+}
+
+void MirrorSelector::recordTimeToFirstByte(std::string const& candidate, std::chrono::milliseconds ttfb)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& value = this->_g_stats[candidate]._ttfb;
+    value = UpdateAverage(value, static_cast<double>(ttfb.count()));
+}
+void MirrorSelector::recordThroughput(std::string const& candidate, double bytesPerSecond)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& value = this->_g_stats[candidate]._throughput;
+    value = UpdateAverage(value, bytesPerSecond);
+}
+void MirrorSelector::recordFailure(std::string const& candidate)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& stats = this->_g_stats[candidate];
+    stats._ttfb = UpdateAverage(stats._ttfb, GRUPDATER_MIRROR_FAILURE_PENALTY_MS);
+    stats._throughput = UpdateAverage(stats._throughput, 0.0);
+}
+
+std::map<std::string, MirrorStats> MirrorSelector::getStats() const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    return this->_g_stats;
+}
+
+template<class TScore>
+std::vector<std::string> MirrorSelector::rank(std::string const& origin, TScore const& score) const
+{
+    std::vector<std::string> candidates;
+    candidates.reserve(this->_g_mirrors.size() + 1);
+    for (auto const& mirror : this->_g_mirrors)
+    {
+        if (mirror != origin && std::ranges::find(candidates, mirror) == candidates.end())
+        {
+            candidates.push_back(mirror);
+        }
+    }
+    candidates.push_back(origin);
+
+    //(group, score): unmeasured mirrors, measured candidates by score, unmeasured origin
+    std::map<std::string, std::pair<int, double>> keys;
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        for (auto const& candidate : candidates)
+        {
+            auto const it = this->_g_stats.find(candidate);
+            auto const value = it == this->_g_stats.end() ? std::nullopt : score(it->second);
+            keys[candidate] = value ? std::pair{1, *value} : std::pair{candidate == origin ? 2 : 0, 0.0};
+        }
+    }
+    std::ranges::stable_sort(candidates, [&keys](std::string const& left, std::string const& right) {
+        return keys.at(left) < keys.at(right);
+    });
+    return candidates;
+}
+
+//ClientPool
+
+ClientPool::ClientPool(std::size_t maxIdle) :
+        _g_maxIdle(maxIdle)
+{}
+ClientPool::~ClientPool() = default;
+
+std::shared_ptr<httplib::Client> ClientPool::acquire(std::string const& baseUrl)
+{
+    std::unique_ptr<httplib::Client> client;
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        auto& idle = this->_g_idle[baseUrl];
+        if (!idle.empty())
+        {
+            client = std::move(idle.back());
+            idle.pop_back();
+        }
+    }
+    if (!client)
+    {
+        client = std::make_unique<httplib::Client>(baseUrl);
+        client->set_keep_alive(true);
+        InstrumentClient(*client);
+    }
+
+    //The lease may outlive the pool, the client is then closed
+    return {client.release(), [pool = this->weak_from_this(), baseUrl](httplib::Client* released) {
+        if (auto const owner = pool.lock())
+        {
+            owner->release(baseUrl, released);
+            return;
+        }
+        delete released;
+    }};
+}
+std::size_t ClientPool::getIdleCount() const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    std::size_t count = 0;
+    for (auto const& [baseUrl, idle] : this->_g_idle)
+    {
+        count += idle.size();
+    }
+    return count;
+}
+void ClientPool::clear()
+{
+    std::map<std::string, std::vector<std::unique_ptr<httplib::Client>>> idle;
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        idle.swap(this->_g_idle);
+    }
+}
+void ClientPool::release(std::string const& baseUrl, httplib::Client* client)
+{
+    std::unique_ptr<httplib::Client> owned{client};
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& idle = this->_g_idle[baseUrl];
+    if (idle.size() < this->_g_maxIdle)
+    {
+        idle.push_back(std::move(owned));
+    }
+}
+
+//Transport
+
+std::string HttpResponse::getHeader(std::string_view key) const
+{
+    auto const it = std::ranges::find_if(this->_headers, [key](auto const& header) {
+        return EqualsIgnoreCase(header.first, key);
+    });
+    return it == this->_headers.end() ? std::string{} : it->second;
+}
+bool HttpResponse::hasHeader(std::string_view key) const
+{
+    return std::ranges::any_of(this->_headers, [key](auto const& header) {
+        return EqualsIgnoreCase(header.first, key);
+    });
+}
+
+void SetTransport(std::shared_ptr<Transport> transport)
+{
+    auto& state = GetTransportState();
+    std::scoped_lock const lock(state._mutex);
+    state._transport = std::move(transport);
+}
+std::shared_ptr<Transport> GetTransport()
+{
+    {
+        auto& state = GetTransportState();
+        std::scoped_lock const lock(state._mutex);
+        if (state._transport)
+        {
+            return state._transport;
+        }
+    }
+    static auto const transport = std::make_shared<HttplibTransport>();
+    return transport;
+}
+
+HttplibTransport::HttplibTransport(std::shared_ptr<ClientPool> pool) :
+        _g_pool(std::move(pool))
+{}
+
+std::optional<HttpResponse> HttplibTransport::get(HttpRequest const& request,
+                                                  HttpResponseHandler const& onResponse,
+                                                  HttpDataHandler const& onData)
+{
+    if (request._stopToken.stop_requested())
+    {
+        return std::nullopt;
+    }
+
+    //A leased client keeps the settings of its previous request
+    auto const client = this->_g_pool->acquire(request._baseUrl);
+    client->set_follow_location(request._followRedirects);
+    client->set_connection_timeout(request._connectionTimeout.value_or(std::chrono::seconds{CPPHTTPLIB_CONNECTION_TIMEOUT_SECOND}));
+
+    httplib::Headers headers(request._headers.begin(), request._headers.end());
+    if (request._rangeFrom)
+    {
+        headers.emplace("Range", "bytes=" + std::to_string(*request._rangeFrom) + '-');
+    }
+
+    HttpResponse response;
+    auto const readHead = [&response](httplib::Response const& res) {
+        response._status = res.status;
+        response._headers.assign(res.headers.begin(), res.headers.end());
+    };
+    //Close the socket to interrupt a pending connection or read
+    std::stop_callback const stop{request._stopToken, [&client] {
+        client->stop();
+    }};
+    auto result = Probe(MetricsScope::current(), [&] {
+        return client->Get(request._path, headers,
+            [&](httplib::Response const& res) {
+                MarkFirstByte();
+                readHead(res);
+                return !onResponse || onResponse(response);
+            },
+            [&](char const* data, std::size_t dataLength) {
+                if (request._stopToken.stop_requested())
+                {
+                    return false;
+                }
+                if (!onData)
+                {
+                    response._body.append(data, dataLength);
+                    return true;
+                }
+                return onData(data, dataLength);
+            });
+    });
+    if (!result)
+    {
+        return std::nullopt;
+    }
+    readHead(result.value());
+    return response;
+}
+
+ClientPool& HttplibTransport::getClientPool()
+{
+    return *this->_g_pool;
+}
+
+//ReleaseIndex
+
+ReleaseIndex::ReleaseIndex(std::string owner, std::string repo) :
+        _g_owner(std::move(owner)),
+        _g_repo(std::move(repo)),
+        _g_origin(GetOrigins()._api)
+{}
+
+bool ReleaseIndex::load(std::filesystem::path const& indexFile)
+{
+    if (indexFile.empty() || !std::filesystem::is_regular_file(indexFile))
+    {
+        return false;
+    }
+
+    std::ifstream file(indexFile);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+    file.close();
+    if (json.is_discarded() || !json.is_object())
+    {
+        return false;
+    }
+
+    if (JsonValue(json, "owner", std::string{}) != this->_g_owner || JsonValue(json, "repo", std::string{}) != this->_g_repo)
+    {
+        return false;
+    }
+    //A damaged cache is dropped as a whole
+    if (!IsJsonFieldValid<uint64_t>(json, "head") || !IsJsonFieldValid<std::size_t>(json, "fetched")
+        || !IsJsonFieldValid<std::string>(json, "etag") || !IsJsonFieldValid<bool>(json, "complete"))
+    {
+        return false;
+    }
+    auto const releases = json.value("releases", nlohmann::json::array());
+    if (!releases.is_array())
+    {
+        return false;
+    }
+
+    std::vector<ReleaseEntry> entries;
+    for (auto const& release : releases)
+    {
+        if (!release.is_object() || !IsJsonFieldValid<uint64_t>(release, "id") || !IsJsonFieldValid<bool>(release, "prerelease")
+            || !IsJsonFieldValid<std::string>(release, "asset") || !IsJsonFieldValid<std::string>(release, "url")
+            || !IsJsonFieldValid<std::chrono::seconds::rep>(release, "published"))
+        {
+            return false;
+        }
+        auto tag = ParseTag(JsonValue(release, "tag", std::string{}));
+        if (!tag)
+        {
+            return false;
+        }
+
+        ReleaseEntry entry{};
+        entry._key = tag->key();
+        entry._tag = *tag;
+        entry._id = JsonValue(release, "id", uint64_t{0});
+        entry._prerelease = JsonValue(release, "prerelease", false);
+        entry._asset = JsonValue(release, "asset", std::string{});
+        entry._assetUrl = JsonValue(release, "url", std::string{});
+        if (release.contains("published"))
+        {
+            entry._publishedAt = FromSeconds(release["published"].get<std::chrono::seconds::rep>());
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    this->_g_entries.clear();
+    this->merge(std::move(entries));
+    this->_g_headId = JsonValue(json, "head", uint64_t{0});
+    this->_g_fetchedCount = JsonValue(json, "fetched", std::size_t{0});
+    this->_g_etag = JsonValue(json, "etag", std::string{});
+    this->_g_complete = JsonValue(json, "complete", false);
+    this->_g_upToDate = false;
+    return true;
+}
+bool ReleaseIndex::save(std::filesystem::path const& indexFile) const
+{
+    if (indexFile.empty())
+    {
+        return false;
+    }
+
+    nlohmann::json releases = nlohmann::json::array();
+    for (auto const& entry : this->_g_entries)
+    {
+        nlohmann::json release{{"id", entry._id},
+                               {"tag", ToString(entry._tag)},
+                               {"prerelease", entry._prerelease},
+                               {"asset", entry._asset},
+                               {"url", entry._assetUrl}};
+        if (entry._publishedAt)
+        {
+            release["published"] = ToSeconds(*entry._publishedAt);
+        }
+        releases.push_back(std::move(release));
+    }
+
+    nlohmann::json json{{"owner", this->_g_owner},
+                        {"repo", this->_g_repo},
+                        {"head", this->_g_headId},
+                        {"fetched", this->_g_fetchedCount},
+                        {"etag", this->_g_etag},
+                        {"complete", this->_g_complete},
+                        {"releases", std::move(releases)}};
+
+    std::ofstream file(indexFile);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    file << json.dump();
+    file.close();
+    return true;
+}
+
+bool ReleaseIndex::update()
+{
+    using namespace httplib;
+
+    if (this->_g_owner.empty() || this->_g_repo.empty())
+    {
+        return false;
+    }
+
+    auto& telemetry = GetTelemetry();
+    telemetry._checks.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t const previousHeadId = this->_g_headId;
+    std::vector<ReleaseEntry> entries;
+    std::size_t newCount = 0;
+    std::size_t scannedCount = 0;
+    uint64_t oldestId = std::numeric_limits<uint64_t>::max();
+    bool reachedEnd = false;
+    //Only committed with the merged entries, a failure on a later page keeps the previous state
+    std::string etag = this->_g_etag;
+    uint64_t headId = previousHeadId;
+
+    for (std::size_t page = 1;; ++page)
+    {
+        bool const conditional = page == 1 && previousHeadId != 0;
+        auto res = this->get(ReleasesPath(this->_g_owner, this->_g_repo, page), conditional ? this->_g_etag : std::string{});
+        if (!res)
+        {
+            telemetry._checkFailures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ReadRateLimit(res.value(), this->_g_rateLimit);
+        if (res->_status == StatusCode::NotModified_304)
+        {
+            telemetry._checksNotModified.fetch_add(1, std::memory_order_relaxed);
+            this->_g_upToDate = true;
+            return true;
+        }
+        if (res->_status != StatusCode::OK_200)
+        {
+            telemetry._checkFailures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        nlohmann::json json = nlohmann::json::parse(res->_body, nullptr, false);
+        if (json.is_discarded() || !json.is_array())
+        {
+            telemetry._checkFailures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (page == 1)
+        {
+            etag = res->getHeader("ETag");
+            if (!json.empty() && json[0].is_object())
+            {
+                headId = json[0].value("id", uint64_t{0});
+            }
+        }
+
+        //Every release of the page is parsed again, a cached one may have changed (asset uploaded, prerelease flag)
+        bool reachedHead = false;
+        for (auto const& release : json)
+        {
+            auto const id = release.value("id", uint64_t{0});
+            oldestId = std::min(oldestId, id);
+            ++scannedCount;
+            if (previousHeadId != 0 && id == previousHeadId)
+            {
+                reachedHead = true;
+            }
+            if (previousHeadId == 0 || !reachedHead)
+            {
+                ++newCount;
+            }
+            if (auto entry = ParseRelease(release))
+            {
+                entries.push_back(std::move(*entry));
+            }
+        }
+
+        if (json.size() < GRUPDATER_RELEASES_PER_PAGE)
+        {//End of the history
+            reachedEnd = true;
+            break;
+        }
+        if (reachedHead)
+        {
+            break;
+        }
+        if (previousHeadId == 0)
+        {//Fresh index, older pages are fetched lazily
+            break;
+        }
+    }
+
+    //The cached releases of the fetched range that are not listed anymore were deleted
+    auto const removedCount = this->merge(std::move(entries), reachedEnd ? 0 : oldestId);
+    this->_g_etag = std::move(etag);
+    this->_g_headId = headId;
+    this->_g_complete = this->_g_complete || reachedEnd;
+    std::size_t fetchedCount = this->_g_fetchedCount + newCount;
+    fetchedCount -= std::min(removedCount, fetchedCount);
+    this->_g_fetchedCount = std::max(fetchedCount, scannedCount);
+    this->_g_upToDate = true;
+    return true;
+}
+bool ReleaseIndex::fetchOlder()
+{
+    using namespace httplib;
+
+    if (this->_g_complete)
+    {
+        return false;
+    }
+    //The page offset is only valid with an up to date head
+    if (!this->_g_upToDate && (!this->update() || this->_g_complete))
+    {
+        return false;
+    }
+
+    std::size_t const page = this->_g_fetchedCount / GRUPDATER_RELEASES_PER_PAGE + 1;
+    std::size_t const skip = this->_g_fetchedCount % GRUPDATER_RELEASES_PER_PAGE;
+
+    auto res = this->get(ReleasesPath(this->_g_owner, this->_g_repo, page));
+    if (!res)
+    {
+        return false;
+    }
+    ReadRateLimit(res.value(), this->_g_rateLimit);
+    if (res->_status != StatusCode::OK_200)
+    {
+        return false;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(res->_body, nullptr, false);
+    if (json.is_discarded() || !json.is_array())
+    {
+        return false;
+    }
+
+    std::vector<ReleaseEntry> entries;
+    for (std::size_t i = skip; i < json.size(); ++i)
+    {
+        ++this->_g_fetchedCount;
+        if (auto entry = ParseRelease(json[i]))
+        {
+            entries.push_back(std::move(*entry));
+        }
+    }
+
+    if (json.size() < GRUPDATER_RELEASES_PER_PAGE)
+    {
+        this->_g_complete = true;
+    }
+
+    this->merge(std::move(entries));
+    return true;
+}
+
+ReleaseEntry const* ReleaseIndex::latest(bool allowPrerelease)
+{
+    return this->findLatest([allowPrerelease](ReleaseEntry const& entry){
+        return allowPrerelease || !entry._prerelease;
+    });
+}
+ReleaseEntry const* ReleaseIndex::latestWithin(TagRange const& range, bool allowPrerelease)
+{
+    return this->findLatest([&range, allowPrerelease](ReleaseEntry const& entry){
+        return (allowPrerelease || !entry._prerelease) && range.contains(entry._key);
+    });
+}
+ReleaseEntry const* ReleaseIndex::latestChannel(std::string_view channel)
+{
+    return this->findLatest([channel](ReleaseEntry const& entry){
+        if (channel.empty())
+        {
+            return !entry._prerelease;
+        }
+        auto const prerelease = entry._tag.getPrerelease();
+        return prerelease.substr(0, prerelease.find('.')) == channel;
+    });
+}
+
+std::vector<ReleaseEntry> const& ReleaseIndex::getEntries() const
+{
+    return this->_g_entries;
+}
+bool ReleaseIndex::isComplete() const
+{
+    return this->_g_complete;
+}
+RateLimitState const& ReleaseIndex::getRateLimit() const
+{
+    return this->_g_rateLimit;
+}
+std::string const& ReleaseIndex::getEtag() const
+{
+    return this->_g_etag;
+}
+void ReleaseIndex::setTransport(std::shared_ptr<Transport> transport)
+{
+    this->_g_transport = std::move(transport);
+}
+void ReleaseIndex::setClientPool(std::shared_ptr<ClientPool> pool)
+{
+    this->_g_transport = std::make_shared<HttplibTransport>(std::move(pool));
+}
+void ReleaseIndex::setMirrors(std::shared_ptr<MirrorSelector> selector)
+{
+    this->_g_selector = std::move(selector);
+}
+RepoContext ReleaseIndex::makeContext(ReleaseEntry const& entry) const
+{
+    RepoContext context;
+    context._owner = this->_g_owner;
+    context._repo = this->_g_repo;
+    context._asset = entry._asset;
+    context._assetUrl = entry._assetUrl;
+    context._latestTag = entry._tag;
+    context._publishedAt = entry._publishedAt;
+    return context;
+}
+
+template<class TPredicate>
+ReleaseEntry const* ReleaseIndex::findLatest(TPredicate const& predicate)
+{
+    do
+    {
+        //Entries are sorted from the highest tag, so the first match is the latest
+        auto it = std::ranges::find_if(this->_g_entries, [&predicate](ReleaseEntry const& entry){
+            return !entry._assetUrl.empty() && predicate(entry);
+        });
+        if (it != this->_g_entries.end())
+        {
+            return &(*it);
+        }
+    }
+    while (this->fetchOlder());
+    return nullptr;
+}
+std::optional<HttpResponse> ReleaseIndex::get(std::string const& path, std::string const& etag)
+{
+    auto headers = GitHubHeaders();
+    if (!etag.empty())
+    {
+        headers.emplace_back("If-None-Match", etag);
+    }
+
+    if (!this->_g_selector)
+    {
+        this->_g_selector = std::make_shared<MirrorSelector>(std::vector<std::string>{});
+    }
+    if (!this->_g_transport)
+    {
+        this->_g_transport = GetTransport();
+    }
+    return GetHedged(*this->_g_selector,
+                     this->_g_selector->rankByLatency(this->_g_origin),
+                     this->_g_origin,
+                     *this->_g_transport,
+                     path,
+                     headers);
+}
+std::size_t ReleaseIndex::merge(std::vector<ReleaseEntry>&& entries, std::optional<uint64_t> refetchedFromId)
+{
+    std::size_t removedCount = 0;
+    if (refetchedFromId)
+    {
+        removedCount = std::erase_if(this->_g_entries, [&entries, &refetchedFromId](ReleaseEntry const& cached){
+            return cached._id >= *refetchedFromId && std::ranges::none_of(entries, [&cached](ReleaseEntry const& e){ return e._id == cached._id; });
+        });
+    }
+    for (auto& entry : entries)
+    {
+        auto const it = std::ranges::find_if(this->_g_entries, [&entry](ReleaseEntry const& e){ return e._id == entry._id; });
+        if (it != this->_g_entries.end())
+        {
+            *it = std::move(entry);
+        }
+        else
+        {
+            this->_g_entries.push_back(std::move(entry));
+        }
+    }
+    std::ranges::sort(this->_g_entries, [](ReleaseEntry const& left, ReleaseEntry const& right){
+        return left._key > right._key;
+    });
+    return removedCount;
+}
+
+//ArchiveBackend
+
+void RegisterArchiveBackend(std::shared_ptr<ArchiveBackend> backend)
+{
+    auto& state = GetArchiveBackendsState();
+    std::scoped_lock const lock(state._mutex);
+    state._backends.insert(state._backends.begin(), std::move(backend));
+}
+std::vector<std::shared_ptr<ArchiveBackend>> GetArchiveBackends()
+{
+    auto& state = GetArchiveBackendsState();
+    std::scoped_lock const lock(state._mutex);
+    return state._backends;
+}
+std::shared_ptr<ArchiveBackend> FindArchiveBackend(std::string_view name)
+{
+    auto& state = GetArchiveBackendsState();
+    std::scoped_lock const lock(state._mutex);
+    auto const it = std::ranges::find_if(state._backends, [name](auto const& backend) {
+        return HasExtension(name, backend->getExtension());
+    });
+    return it == state._backends.end() ? nullptr : *it;
+}
+
+//FileSystem
+
+bool FileSystem::copy(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+    if (this->stat(to)._type != FileType::None)
+    {
+        return false;
+    }
+    auto const reader = this->openRead(from);
+    auto const writer = reader ? this->openWrite(to) : nullptr;
+    if (!writer)
+    {
+        return false;
+    }
+
+    std::vector<char> buffer(GRUPDATER_SESSION_BUFFER_SIZE);
+    int64_t dataSize = 0;
+    while ((dataSize = reader->read(buffer.data(), buffer.size())) > 0)
+    {
+        if (!writer->write(buffer.data(), static_cast<std::size_t>(dataSize)))
+        {
+            break;
+        }
+    }
+    return writer->close() && dataSize == 0;
+}
+
+std::unique_ptr<FileReader> OsFileSystem::openRead(std::filesystem::path const& path)
+{
+    auto reader = std::make_unique<OsFileReader>(path);
+    return reader->isOpen() ? std::move(reader) : nullptr;
+}
+std::unique_ptr<FileWriter> OsFileSystem::openWrite(std::filesystem::path const& path)
+{
+    auto writer = std::make_unique<OsFileWriter>(path);
+    return writer->isOpen() ? std::move(writer) : nullptr;
+}
+bool OsFileSystem::createDirectories(std::filesystem::path const& path)
+{
+    std::error_code errorCode;
+    std::filesystem::create_directories(path, errorCode);
+    return !errorCode && std::filesystem::is_directory(path, errorCode);
+}
+bool OsFileSystem::rename(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+    std::error_code errorCode;
+    std::filesystem::rename(from, to, errorCode);
+    return !errorCode;
+}
+bool OsFileSystem::remove(std::filesystem::path const& path)
+{
+    std::error_code errorCode;
+    std::filesystem::remove(path, errorCode);
+    return !errorCode;
+}
+FileStatus OsFileSystem::stat(std::filesystem::path const& path)
+{
+    std::error_code errorCode;
+    return ToFileStatus(std::filesystem::status(path, errorCode), path);
+}
+bool OsFileSystem::iterate(std::filesystem::path const& directory, FileVisitor const& visitor)
+{
+    std::error_code errorCode;
+    std::filesystem::recursive_directory_iterator it(directory, errorCode);
+    for (; !errorCode && it != std::filesystem::recursive_directory_iterator{}; it.increment(errorCode))
+    {
+        std::error_code statusError;
+        if (!visitor(it->path(), ToFileStatus(it->status(statusError), it->path())))
+        {
+            return true;
+        }
+    }
+    return !errorCode;
+}
+bool OsFileSystem::link(std::filesystem::path const& target, std::filesystem::path const& link)
+{
+    std::error_code errorCode;
+    std::filesystem::create_hard_link(target, link, errorCode);
+    return !errorCode;
+}
+bool OsFileSystem::copy(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+    std::error_code errorCode;
+    return std::filesystem::copy_file(from, to, errorCode) && !errorCode;
+}
+
+std::unique_ptr<FileReader> MemoryFileSystem::openRead(std::filesystem::path const& path)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto const it = this->_g_nodes.find(MemoryKey(path));
+    if (it == this->_g_nodes.end() || !it->second)
+    {
+        return nullptr;
+    }
+    return std::make_unique<MemoryFileReader>(it->second);
+}
+std::unique_ptr<FileWriter> MemoryFileSystem::openWrite(std::filesystem::path const& path)
+{
+    auto const key = MemoryKey(path);
+    std::scoped_lock const lock(this->_g_mutex);
+    if (IsMemoryRoot(key) || !this->isDirectory(MemoryParentKey(key)))
+    {
+        return nullptr;
+    }
+
+    auto const it = this->_g_nodes.find(key);
+    if (it == this->_g_nodes.end())
+    {
+        auto content = std::make_shared<std::string>();
+        this->_g_nodes.emplace(key, content);
+        return std::make_unique<MemoryFileWriter>(std::move(content));
+    }
+    if (!it->second)
+    {
+        return nullptr;
+    }
+    //Truncated like a file opened by the OS, so also through its hard links
+    it->second->clear();
+    return std::make_unique<MemoryFileWriter>(it->second);
+}
+bool MemoryFileSystem::createDirectories(std::filesystem::path const& path)
+{
+    std::vector<std::string> keys;
+    for (auto key = MemoryKey(path); !IsMemoryRoot(key); key = MemoryParentKey(key))
+    {
+        keys.push_back(key);
+    }
+
+    std::scoped_lock const lock(this->_g_mutex);
+    //From the root
+    for (auto it = keys.rbegin(); it != keys.rend(); ++it)
+    {
+        auto const [node, inserted] = this->_g_nodes.emplace(*it, nullptr);
+        if (!inserted && node->second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+bool MemoryFileSystem::rename(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+    auto const fromKey = MemoryKey(from);
+    auto const toKey = MemoryKey(to);
+    std::scoped_lock const lock(this->_g_mutex);
+    auto const source = this->_g_nodes.find(fromKey);
+    if (source == this->_g_nodes.end() || IsMemoryRoot(toKey) || !this->isDirectory(MemoryParentKey(toKey)))
+    {
+        return false;
+    }
+    if (fromKey == toKey)
+    {
+        return true;
+    }
+
+    auto const destination = this->_g_nodes.find(toKey);
+    if (source->second)
+    {
+        if (destination != this->_g_nodes.end() && !destination->second)
+        {
+            return false;
+        }
+        this->_g_nodes[toKey] = source->second;
+        this->_g_nodes.erase(fromKey);
+        return true;
+    }
+
+    //A directory replaces a missing or empty directory, and can't be moved below itself
+    auto const fromPrefix = MemoryChildPrefix(fromKey);
+    if (toKey.starts_with(fromPrefix)
+        || (destination != this->_g_nodes.end() && (destination->second || this->hasChildren(toKey))))
+    {
+        return false;
+    }
+    std::vector<std::pair<std::string, std::shared_ptr<std::string>>> moved;
+    for (auto it = this->_g_nodes.lower_bound(fromPrefix); it != this->_g_nodes.end() && it->first.starts_with(fromPrefix);)
+    {
+        moved.emplace_back(MemoryChildPrefix(toKey) + it->first.substr(fromPrefix.size()), std::move(it->second));
+        it = this->_g_nodes.erase(it);
+    }
+    this->_g_nodes.erase(fromKey);
+    this->_g_nodes[toKey] = nullptr;
+    for (auto& [key, content] : moved)
+    {
+        this->_g_nodes[key] = std::move(content);
+    }
+    return true;
+}
+bool MemoryFileSystem::remove(std::filesystem::path const& path)
+{
+    auto const key = MemoryKey(path);
+    std::scoped_lock const lock(this->_g_mutex);
+    if (IsMemoryRoot(key))
+    {
+        return false;
+    }
+    auto const it = this->_g_nodes.find(key);
+    if (it == this->_g_nodes.end())
+    {
+        return true;
+    }
+    if (!it->second && this->hasChildren(key))
+    {
+        return false;
+    }
+    this->_g_nodes.erase(it);
+    return true;
+}
+FileStatus MemoryFileSystem::stat(std::filesystem::path const& path)
+{
+    auto const key = MemoryKey(path);
+    std::scoped_lock const lock(this->_g_mutex);
+    if (IsMemoryRoot(key))
+    {
+        return {FileType::Directory, 0};
+    }
+    auto const it = this->_g_nodes.find(key);
+    if (it == this->_g_nodes.end())
+    {
+        return {};
+    }
+    if (!it->second)
+    {
+        return {FileType::Directory, 0};
+    }
+    return {FileType::Regular, it->second->size()};
+}
+bool MemoryFileSystem::iterate(std::filesystem::path const& directory, FileVisitor const& visitor)
+{
+    auto const key = MemoryKey(directory);
+    auto const prefix = MemoryChildPrefix(key);
+
+    //The visitor is called without the lock, so it can use this file system
+    std::vector<std::pair<std::filesystem::path, FileStatus>> entries;
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        if (!this->isDirectory(key))
+        {
+            return false;
+        }
+        for (auto it = this->_g_nodes.lower_bound(prefix); it != this->_g_nodes.end() && it->first.starts_with(prefix); ++it)
+        {
+            if (!IsMemoryChild(it->first, prefix))
+            {
+                continue;
+            }
+            FileStatus status{FileType::Directory, 0};
+            if (it->second)
+            {
+                status = {FileType::Regular, it->second->size()};
+            }
+            entries.emplace_back(directory / it->first.substr(prefix.size()), status);
+        }
+    }
+
+    for (auto const& [path, status] : entries)
+    {
+        if (!visitor(path, status))
+        {
+            break;
+        }
+    }
+    return true;
+}
+bool MemoryFileSystem::link(std::filesystem::path const& target, std::filesystem::path const& link)
+{
+    auto const targetKey = MemoryKey(target);
+    auto const linkKey = MemoryKey(link);
+    std::scoped_lock const lock(this->_g_mutex);
+    auto const it = this->_g_nodes.find(targetKey);
+    if (it == this->_g_nodes.end() || !it->second || IsMemoryRoot(linkKey)
+        || this->_g_nodes.contains(linkKey) || !this->isDirectory(MemoryParentKey(linkKey)))
+    {
+        return false;
+    }
+    this->_g_nodes.emplace(linkKey, it->second);
+    return true;
+}
+bool MemoryFileSystem::copy(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+    auto const fromKey = MemoryKey(from);
+    auto const toKey = MemoryKey(to);
+    std::scoped_lock const lock(this->_g_mutex);
+    auto const it = this->_g_nodes.find(fromKey);
+    if (it == this->_g_nodes.end() || !it->second || IsMemoryRoot(toKey)
+        || this->_g_nodes.contains(toKey) || !this->isDirectory(MemoryParentKey(toKey)))
+    {
+        return false;
+    }
+    this->_g_nodes.emplace(toKey, std::make_shared<std::string>(*it->second));
+    return true;
+}
+
+uint64_t MemoryFileSystem::getSize() const
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    std::vector<std::string const*> contents;
+    for (auto const& [key, content] : this->_g_nodes)
+    {
+        if (content)
+        {
+            contents.push_back(content.get());
+        }
+    }
+    std::ranges::sort(contents);
+    auto const last = std::unique(contents.begin(), contents.end());
+    return std::accumulate(contents.begin(), last, uint64_t{0}, [](uint64_t size, std::string const* content) {
+        return size + content->size();
+    });
+}
+
+bool MemoryFileSystem::isDirectory(std::string const& key) const
+{
+    if (IsMemoryRoot(key))
+    {
+        return true;
+    }
+    auto const it = this->_g_nodes.find(key);
+    return it != this->_g_nodes.end() && !it->second;
+}
+bool MemoryFileSystem::hasChildren(std::string const& key) const
+{
+    auto const prefix = MemoryChildPrefix(key);
+    for (auto it = this->_g_nodes.lower_bound(prefix); it != this->_g_nodes.end() && it->first.starts_with(prefix); ++it)
+    {
+        if (IsMemoryChild(it->first, prefix))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<FileSystem> GetOsFileSystem()
+{
+    static auto const fileSystem = std::make_shared<OsFileSystem>();
+    return fileSystem;
+}
+
+//Session
+
+struct Session::Check
+{
+    std::optional<RepoContext> _context;
+    RateLimitState _rateLimit;
+    std::vector<ReleaseEntry> _entries;
+};
+
+struct Session::CachedIndex
+{
+    CachedIndex(std::string owner, std::string repo) :
+            _index(std::move(owner), std::move(repo))
+    {}
+
+    std::mutex _mutex;
+    ReleaseIndex _index;
+    bool _loaded{false};
+};
+
+//Threads started by the first batches and kept until the end of the session
+struct Session::Workers
+{
+    explicit Workers(std::size_t capacity) :
+            _capacity(capacity)
+    {}
+    ~Workers()
+    {
+        {
+            std::scoped_lock const lock(this->_mutex);
+            this->_stopped = true;
+        }
+        this->_condition.notify_all();
+        for (auto& thread : this->_threads)
+        {
+            thread.join();
+        }
+    }
+
+    //Run task on count threads (the caller included) and wait for all of them
+    void run(std::size_t count, std::function<void()> const& task)
+    {
+        std::size_t const queued = std::min(count, this->_capacity) - std::min<std::size_t>(count, 1);
+        std::latch done{static_cast<std::ptrdiff_t>(queued)};
+        {
+            std::scoped_lock const lock(this->_mutex);
+            while (this->_threads.size() < queued)
+            {
+                this->_threads.emplace_back([this] { this->loop(); });
+            }
+            for (std::size_t i = 0; i < queued; ++i)
+            {
+                this->_tasks.emplace_back([&task, &done] {
+                    task();
+                    done.count_down();
+                });
+            }
+        }
+        this->_condition.notify_all();
+        task();
+        done.wait();
+    }
+
+    void loop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(this->_mutex);
+                this->_condition.wait(lock, [this] { return this->_stopped || !this->_tasks.empty(); });
+                if (this->_tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(this->_tasks.front());
+                this->_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::size_t _capacity;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread> _threads;
+    bool _stopped{false};
+};
+
+Session::Session(SessionConfig config) :
+        _g_config(std::move(config)),
+        _g_clients(std::make_shared<ClientPool>(this->_g_config._maxIdleConnections)),
+        _g_transport(std::make_shared<HttplibTransport>(this->_g_clients)),
+        _g_workers(std::make_unique<Workers>(std::max<std::size_t>(this->_g_config._workers, 1)))
+{}
+Session::~Session() = default;
+
+Session& Session::getDefault()
+{
+    static Session session;
+    return session;
+}
+
+std::optional<RepoContext> Session::retrieveContext(std::string const& owner,
+                                                    std::string const& repo,
+                                                    [[maybe_unused]] bool allowPrerelease,
+                                                    [[maybe_unused]] std::vector<std::string> const& mirrors)
+{
+    if (owner.empty() || repo.empty())
+    {
+        return std::nullopt;
+    }
+    TraceSpan const span{"RetrieveContext", {owner, "/", repo}};
+
+#ifdef _UPDATER_DEF_DUMMYTEST
+    RepoContext context;
+    context._owner = owner;
+    context._repo = repo;
+    context._asset = "dummy.zip";
+    context._assetUrl = "dummy.zip";
+    context._latestTag = { 2, 0, 0 };
+    return context;
+#else
+    std::error_code errorCode;
+    std::filesystem::create_directories(this->_g_config._indexDirectory, errorCode);
+
+    auto const selector = this->getSelector(mirrors);
+    std::vector<RepoRequest> const requests{{owner, repo, allowPrerelease}};
+    std::vector<Check> checks;
+    checks.push_back(this->check(requests.front(), this->getIndexFile(requests.front()), selector));
+
+    if (!this->record(requests, checks, *selector))
+    {
+        Log(LogLevel::Warning) << "Failed to write the schedule file";
+    }
+    return std::move(checks.front()._context);
+#endif // _UPDATER_DEF_DUMMYTEST
+}
+std::vector<std::optional<RepoContext>> Session::retrieveContexts(std::vector<RepoRequest> const& requests,
+                                                                  [[maybe_unused]] std::size_t maxConnections,
+                                                                  [[maybe_unused]] std::vector<std::string> const& mirrors)
+{
+    std::vector<std::optional<RepoContext>> contexts(requests.size());
+    if (requests.empty())
+    {
+        return contexts;
+    }
+    TraceSpan const span{"RetrieveContexts"};
+
+#ifdef _UPDATER_DEF_DUMMYTEST
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        contexts[i] = this->retrieveContext(requests[i]._owner, requests[i]._repo, requests[i]._allowPrerelease, mirrors);
+    }
+    return contexts;
+#else
+    std::error_code errorCode;
+    std::filesystem::create_directories(this->_g_config._indexDirectory, errorCode);
+
+    auto const selector = this->getSelector(mirrors);
+    std::vector<Check> checks(requests.size());
+    std::atomic_size_t nextRequest{0};
+
+    //The workers measure into (and are cancelled by) the scopes of the caller
+    auto* const scope = MetricsScope::current();
+    auto* const cancelScope = CancelScope::current();
+    this->_g_workers->run(std::clamp<std::size_t>(maxConnections, 1, requests.size()), [&]() {
+        auto* const previousScope = std::exchange(gMetricsScope, scope);
+        auto* const previousCancelScope = std::exchange(gCancelScope, cancelScope);
+        for (std::size_t i = nextRequest++; i < requests.size() && !CancelScope::isCancelled(); i = nextRequest++)
+        {
+            auto const& request = requests[i];
+            if (request._owner.empty() || request._repo.empty())
+            {
+                continue;
+            }
+
+            TraceSpan const requestSpan{"RetrieveContext", {request._owner, "/", request._repo}};
+            checks[i] = this->check(request, this->getIndexFile(request), selector);
+        }
+        gCancelScope = previousCancelScope;
+        gMetricsScope = previousScope;
+    });
+
+    if (!this->record(requests, checks, *selector))
+    {
+        Log(LogLevel::Warning) << "Failed to write the schedule file";
+    }
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        contexts[i] = std::move(checks[i]._context);
+    }
+    return contexts;
+#endif // _UPDATER_DEF_DUMMYTEST
+}
+
+void Session::clearCaches()
+{
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_indexes.clear();
+        this->_g_selectors.clear();
+        this->_g_buffers.clear();
+    }
+    this->_g_clients->clear();
+}
+SessionConfig const& Session::getConfig() const
+{
+    return this->_g_config;
+}
+ClientPool& Session::getClientPool()
+{
+    return *this->_g_clients;
+}
+std::shared_ptr<Transport> Session::getTransport() const
+{
+    if (this->_g_config._transport)
+    {
+        return this->_g_config._transport;
+    }
+    {
+        auto& state = GetTransportState();
+        std::scoped_lock const lock(state._mutex);
+        if (state._transport)
+        {
+            return state._transport;
+        }
+    }
+    return this->_g_transport;
+}
+
+std::shared_ptr<MirrorSelector> Session::getSelector(std::vector<std::string> const& mirrors)
+{
+    std::string key;
+    for (auto const& mirror : mirrors)
+    {
+        key += mirror;
+        key += '\n';
+    }
+
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& selector = this->_g_selectors[key];
+    if (!selector)
+    {
+        selector = LoadMirrorSelector(mirrors, this->_g_config._scheduleFile);
+    }
+    return selector;
+}
+std::shared_ptr<Session::CachedIndex> Session::getIndex(std::string const& owner, std::string const& repo, std::filesystem::path const& indexFile)
+{
+    //An index keeps the API origin of its construction
+    auto const key = GetOrigins()._api + '\n' + owner + '/' + repo + '\n' + indexFile.generic_string();
+
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& index = this->_g_indexes[key];
+    if (!index)
+    {
+        index = std::make_shared<CachedIndex>(owner, repo);
+    }
+    return index;
+}
+std::filesystem::path Session::getIndexFile(RepoRequest const& request) const
+{
+    return this->_g_config._indexDirectory / (request._owner + '_' + request._repo + ".json");
+}
+Session::Check Session::check(RepoRequest const& request, std::filesystem::path const& indexFile, std::shared_ptr<MirrorSelector> const& selector)
+{
+    auto const cached = this->getIndex(request._owner, request._repo, indexFile);
+    std::scoped_lock const lock(cached->_mutex);
+    auto& index = cached->_index;
+    index.setTransport(this->getTransport());
+    index.setMirrors(selector);
+    if (!cached->_loaded)
+    {
+        cached->_loaded = true;
+        if (!index.load(indexFile))
+        {
+            Log(LogLevel::Info) << "No usable release index cache " << indexFile << ", starting a new one";
+        }
+    }
+
+    Check result;
+    auto const etag = index.getEtag();
+    auto const count = index.getEntries().size();
+    if (index.update())
+    {
+        if (auto const* entry = index.latest(request._allowPrerelease))
+        {
+            result._context = index.makeContext(*entry);
+        }
+    }
+    //Nothing to write after a 304
+    if ((index.getEtag() != etag || index.getEntries().size() != count) && !index.save(indexFile))
+    {
+        Log(LogLevel::Warning) << "Failed to save the release index cache " << indexFile;
+    }
+
+    result._rateLimit = index.getRateLimit();
+    result._entries = index.getEntries();
+    return result;
+}
+bool Session::record(std::vector<RepoRequest> const& requests, std::vector<Check> const& checks, MirrorSelector const& selector)
+{
+    auto state = GetScheduleState(this->_g_config._scheduleFile).value_or(ScheduleState{});
+    auto const now = std::chrono::system_clock::now();
+    //The lowest remaining budget is the most recent one
+    bool rateLimitReplaced = false;
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        if (requests[i]._owner.empty() || requests[i]._repo.empty())
+        {
+            continue;
+        }
+        TrackRepo(state, requests[i]._owner + '/' + requests[i]._repo, now);
+
+        auto const& rateLimit = checks[i]._rateLimit;
+        if (rateLimit._remaining && (!rateLimitReplaced || *rateLimit._remaining < *state._rateLimit._remaining))
+        {
+            state._rateLimit._limit = rateLimit._limit;
+            state._rateLimit._remaining = rateLimit._remaining;
+            state._rateLimit._reset = rateLimit._reset;
+            rateLimitReplaced = true;
+        }
+        if (rateLimit._retryAfter && (!state._rateLimit._retryAfter || *rateLimit._retryAfter > *state._rateLimit._retryAfter))
+        {
+            state._rateLimit._retryAfter = rateLimit._retryAfter;
+        }
+
+        MergeReleaseTimes(state._releaseTimes, checks[i]._entries);
+    }
+    for (auto& [candidate, stats] : selector.getStats())
+    {
+        state._mirrors[candidate] = stats;
+    }
+    return SetScheduleState(state, this->_g_config._scheduleFile);
+}
+std::shared_ptr<std::vector<char>> Session::acquireBuffer()
+{
+    std::unique_ptr<std::vector<char>> buffer;
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        if (!this->_g_buffers.empty())
+        {
+            buffer = std::move(this->_g_buffers.back());
+            this->_g_buffers.pop_back();
+        }
+    }
+    if (!buffer)
+    {
+        buffer = std::make_unique<std::vector<char>>(GRUPDATER_SESSION_BUFFER_SIZE);
+    }
+    return {buffer.release(), [this](std::vector<char>* released) {
+        std::unique_ptr<std::vector<char>> owned{released};
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_buffers.push_back(std::move(owned));
+    }};
+}
+
+std::optional<RepoContext> RetrieveContext(std::string const& owner,
+                                           std::string const& repo,
+                                           bool allowPrerelease,
+                                           std::vector<std::string> const& mirrors)
+{
+    return Session::getDefault().retrieveContext(owner, repo, allowPrerelease, mirrors);
+}
+std::vector<std::optional<RepoContext>> RetrieveContexts(std::vector<RepoRequest> const& requests,
+                                                        std::size_t maxConnections,
+                                                        std::vector<std::string> const& mirrors)
+{
+    return Session::getDefault().retrieveContexts(requests, maxConnections, mirrors);
+}
+std::optional<std::filesystem::path> DownloadAsset(RepoContext const& context,
+                                                   std::filesystem::path const& tempDir,
+                                                   std::vector<std::string> const& mirrors)
+{
+    return Session::getDefault().downloadAsset(context, tempDir, mirrors);
+}
+std::optional<std::filesystem::path> ExtractAsset(std::filesystem::path const& assetPath)
+{
+    return Session::getDefault().extractAsset(assetPath);
+}
+
+TagStatus VerifyTag(RepoContext const& context, Tag const& currentTag)
+{
+    auto const order = context._latestTag <=> currentTag;
+    if (order == 0)
+    {
+        return TagStatus::SameTag;
+    }
+    return order > 0 ? TagStatus::NewerTag : TagStatus::OlderTag;
+}
+
+std::optional<std::filesystem::path> Session::downloadAsset(RepoContext const& context,
+                                                            std::filesystem::path const& tempDir,
+                                                            [[maybe_unused]] std::vector<std::string> const& mirrors)
+{
+	using namespace httplib;
+
+    if (context._assetUrl.empty())
+    {
+        return std::nullopt;
+    }
+
+    if (tempDir.empty() || !tempDir.is_relative())
+    {
+        return std::nullopt;
+    }
+
+    //Check if tempDir is inside working directory
+    auto currentPath = std::filesystem::current_path();
+    auto fullPath = std::filesystem::absolute(tempDir);
+    auto relativePath = std::filesystem::relative(fullPath, currentPath) / "";
+
+    if (relativePath.lexically_normal() != tempDir.lexically_normal() || currentPath == fullPath)
+    {
+        return std::nullopt;
+    }
+
+    if (!std::filesystem::exists(tempDir))
+    {
+        if (!std::filesystem::create_directories(tempDir))
+        {
+            return std::nullopt;
+        }
+    }
+    else if (!std::filesystem::is_directory(tempDir))
+    {
+        return std::nullopt;
+    }
+
+    if (!std::filesystem::is_empty(tempDir))
+    {
+        std::filesystem::remove_all(tempDir);
+        if (!std::filesystem::create_directories(tempDir))
+        {
+            return std::nullopt;
+        }
+    }
+
+#ifdef _UPDATER_DEF_DUMMYTEST
+    std::filesystem::path assetPath = tempDir / context._asset;
+    std::ofstream file(assetPath, std::ios::binary);
+    file << "Dummy data";
+    file.close();
+    return assetPath;
+#else
+    std::filesystem::path assetPath = tempDir / context._asset;
+
+    std::ofstream file(assetPath, std::ios::binary);
+    if (!file.is_open())
+    {
+        return std::nullopt;
+    }
+
+    //The best mirror by throughput first, the others continue the transfer where it stopped
+    TraceSpan const span{"DownloadAsset", {context._asset}};
+    auto const begin = std::chrono::steady_clock::now();
+    auto const selector = this->getSelector(mirrors);
+    uint64_t offset = 0;
+    bool success = false;
+    auto const origins = GetOrigins();
+    auto const [urlOrigin, urlPath] = SplitUrl(context._assetUrl);
+    auto const transport = this->getTransport();
+    ProgressPhaseGuard progress{ProgressPhase::Download, std::nullopt};
+    for (auto const& candidate : selector->rankByThroughput(origins._download))
+    {
+        TraceSpan const segmentSpan{"DownloadSegment", {candidate}};
+        bool const isOrigin = candidate == origins._download;
+        HttpRequest request;
+        request._baseUrl = isOrigin && !urlOrigin.empty() ? urlOrigin : candidate;
+        request._path = isOrigin ? urlPath : AssetPath(context);
+        request._followRedirects = true;
+        if (!isOrigin)
+        {
+            request._connectionTimeout = std::chrono::seconds{2};
+        }
+
+        if (DownloadFrom(*transport, std::move(request), file, offset, *selector, candidate))
+        {
+            success = true;
+            progress._success = true;
+            break;
+        }
+        if (CancelScope::isCancelled())
+        {
+            Log(LogLevel::Warning) << "Download of " << context._asset << " cancelled";
+            break;
+        }
+        Log(LogLevel::Warning) << "Failed to download asset from " << candidate << " (" << offset << " bytes received), trying the next one";
+    }
+    file.close();
+
+    if (!RecordMirrorStats(*selector, this->_g_config._scheduleFile))
+    {
+        Log(LogLevel::Warning) << "Failed to record the mirror measures in the schedule file";
+    }
+
+    auto& telemetry = GetTelemetry();
+    std::error_code errorCode;
+    if (!success)
+    {
+        telemetry._downloadFailures.fetch_add(1, std::memory_order_relaxed);
+        std::filesystem::remove(assetPath, errorCode);
+        return std::nullopt;
+    }
+    //A restarted transfer may be shorter than what was written before
+    std::filesystem::resize_file(assetPath, offset, errorCode);
+    if (errorCode)
+    {
+        telemetry._downloadFailures.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    telemetry._downloads.fetch_add(1, std::memory_order_relaxed);
+    telemetry._downloadSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    return assetPath;
+#endif // _UPDATER_DEF_DUMMYTEST
+}
+std::optional<std::filesystem::path> Session::extractAsset(std::filesystem::path const& assetPath)
+{
+    if (!std::filesystem::exists(assetPath) || !std::filesystem::is_regular_file(assetPath))
+    {
+        return std::nullopt;
+    }
+    auto const backend = FindArchiveBackend(assetPath.filename().string());
+    if (!backend)
+    {
+        return std::nullopt;
+    }
+
+#ifdef _UPDATER_DEF_DUMMYTEST
+    std::filesystem::path extractPath = assetPath.parent_path() / "dummy";
+    if (!std::filesystem::exists(extractPath))
+    {
+        std::filesystem::create_directories(extractPath);
+    }
+    else if (!std::filesystem::is_directory(extractPath))
+    {
+        return std::nullopt;
+    }
+
+    std::ofstream file(extractPath / "dummy.txt");
+    file << "Dummy data";
+    file.close();
+
+    //Copy exe and dll files
+    auto currentPath = std::filesystem::current_path() / GRUPDATER_EXECUTABLE_NAME_W;
+    std::filesystem::copy_file(currentPath, extractPath / GRUPDATER_EXECUTABLE_NAME_W, std::filesystem::copy_options::overwrite_existing);
+    currentPath = std::filesystem::current_path() / GRUPDATER_DLL_NAME_W;
+    std::filesystem::copy_file(currentPath, extractPath / GRUPDATER_DLL_NAME_W, std::filesystem::copy_options::overwrite_existing);
+    currentPath = std::filesystem::current_path() / GRUPDATER_APPLY_EXECUTABLE_NAME_W;
+    if (std::filesystem::exists(currentPath))
+    {
+        std::filesystem::copy_file(currentPath, extractPath / GRUPDATER_APPLY_EXECUTABLE_NAME_W, std::filesystem::copy_options::overwrite_existing);
+    }
+
+    return extractPath;
+#else
+    auto parentPath = assetPath.parent_path();
+    auto assetPathStr = assetPath.string();
+    auto const reader = backend->open(assetPath);
+    if (!reader)
+    {
+        return std::nullopt;
+    }
+
+    TraceSpan const span{"ExtractAsset", {assetPathStr}};
+    auto const fileSystem = this->_g_config._fileSystem ? this->_g_config._fileSystem : GetOsFileSystem();
+    auto const buffer = this->acquireBuffer();
+    bool extractedFilesHaveRoot = true;
+    std::filesystem::path rootPath{};
+    auto const begin = std::chrono::steady_clock::now();
+    uint64_t extractedBytes = 0;
+
+    //The totals are only read when someone observes the progress
+    std::optional<ArchiveTotals> totals;
+    if (ProgressScope::current() != nullptr)
+    {
+        totals = reader->getTotals();
+    }
+    ProgressPhaseGuard progress{ProgressPhase::Extract,
+                                totals ? std::optional{totals->_bytes} : std::nullopt,
+                                totals ? totals->_entries : 0};
+
+    ArchiveEntry entry;
+    for (uint64_t i = 0; reader->next(entry); ++i)
+    {
+        TraceSpan const entrySpan{"ExtractEntry", {entry._name}};
+        auto extractFilePath = std::filesystem::path{entry._name}.lexically_normal();
+        if (extractFilePath.has_root_path() || (extractFilePath.begin() != extractFilePath.end() && *extractFilePath.begin() == ".."))
+        {
+            Log(LogLevel::Error) << "Entry " << entry._name << " of archive " << assetPathStr << " is outside of the extraction directory";
+            return std::nullopt;
+        }
+        auto filePath = parentPath / extractFilePath;
+
+        if (extractFilePath.begin() != extractFilePath.end() && extractedFilesHaveRoot)
+        {
+            if (!extractFilePath.has_parent_path() && extractFilePath.has_filename())
+            {//File inside the root so there is no root directory
+                extractedFilesHaveRoot = false;
+            }
+
+            if (rootPath.empty())
+            {
+                rootPath = *extractFilePath.begin();
+            }
+            else if (rootPath != *extractFilePath.begin())
+            {
+                extractedFilesHaveRoot = false;
+            }
+        }
+
+        if (!fileSystem->createDirectories(filePath.parent_path()))
+        {
+            Log(LogLevel::Error) << "Failed to create directory " << filePath.parent_path();
+            return std::nullopt;
+        }
+
+        if (entry._name.ends_with('/'))
+        {
+            continue;
+        }
+
+        auto const file = fileSystem->openWrite(filePath);
+        if (!file)
+        {
+            Log(LogLevel::Error) << "Failed to create file " << filePath;
+            return std::nullopt;
+        }
+
+        uint64_t total = 0;
+        while (total != entry._size)
+        {
+            if (CancelScope::isCancelled())
+            {
+                Log(LogLevel::Warning) << "Extraction of " << assetPathStr << " cancelled";
+                return std::nullopt;
+            }
+            auto const dataSize = reader->read(buffer->data(), buffer->size());
+            if (dataSize <= 0)
+            {
+                Log(LogLevel::Error) << "Failed to read data from archive " << assetPathStr;
+                return std::nullopt;
+            }
+            if (!file->write(buffer->data(), static_cast<std::size_t>(dataSize)))
+            {
+                Log(LogLevel::Error) << "Failed to write file " << filePath;
+                return std::nullopt;
+            }
+            total += dataSize;
+            if (progress._scope != nullptr)
+            {
+                progress._scope->update(extractedBytes + total, i);
+            }
+        }
+        if (!file->close())
+        {
+            Log(LogLevel::Error) << "Failed to write file " << filePath;
+            return std::nullopt;
+        }
+        extractedBytes += total;
+
+        if (auto* scope = MetricsScope::current())
+        {
+            scope->addFiles(1);
+            scope->addBytes(total);
+        }
+    }
+    if (reader->hasFailed())
+    {
+        Log(LogLevel::Error) << "Failed to read archive " << assetPathStr;
+        return std::nullopt;
+    }
+
+    if (extractedFilesHaveRoot && rootPath.empty())
+    {
+        extractedFilesHaveRoot = false;
+    }
+
+    progress._success = true;
+
+    auto& telemetry = GetTelemetry();
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - begin;
+    telemetry._extractions.fetch_add(1, std::memory_order_relaxed);
+    telemetry._extractBytes.fetch_add(extractedBytes, std::memory_order_relaxed);
+    if (elapsed.count() > 0)
+    {
+        telemetry._extractBytesPerSecond.observe(static_cast<double>(extractedBytes) / elapsed.count());
+    }
+
+    if (!extractedFilesHaveRoot)
+    {
+        return assetPath.parent_path();
+    }
+    return assetPath.parent_path() / rootPath;
+#endif // _UPDATER_DEF_DUMMYTEST
+}
+
+std::optional<ScheduleState> GetScheduleState(std::filesystem::path const& scheduleFile)
+{
+    if (scheduleFile.empty() || !std::filesystem::exists(scheduleFile) || !std::filesystem::is_regular_file(scheduleFile))
+    {
+        return std::nullopt;
+    }
+
+    std::ifstream file(scheduleFile);
+    if (!file.is_open())
+    {
+        return std::nullopt;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+    file.close();
+    if (json.is_discarded() || !json.is_object())
+    {
+        return std::nullopt;
+    }
+
+    auto const getTime = [](nlohmann::json const& object, char const* key) -> std::optional<std::chrono::system_clock::time_point> {
+        if (!object.contains(key) || !object[key].is_number_integer())
+        {
+            return std::nullopt;
+        }
+        return FromSeconds(object[key].get<std::chrono::seconds::rep>());
+    };
+
+    ScheduleState state;
+    state._lastTime = getTime(json, "time");
+
+    auto const rateLimit = json.value("rateLimit", nlohmann::json::object());
+    if (rateLimit.contains("limit") && IsJsonType<uint32_t>(rateLimit["limit"]))
+    {
+        state._rateLimit._limit = rateLimit["limit"].get<uint32_t>();
+    }
+    if (rateLimit.contains("remaining") && IsJsonType<uint32_t>(rateLimit["remaining"]))
+    {
+        state._rateLimit._remaining = rateLimit["remaining"].get<uint32_t>();
+    }
+    state._rateLimit._reset = getTime(rateLimit, "reset");
+    state._rateLimit._retryAfter = getTime(rateLimit, "retryAfter");
+
+    auto const repos = json.value("repos", nlohmann::json::object());
+    if (repos.is_object())
+    {
+        for (auto const& [repo, time] : repos.items())
+        {
+            if (IsJsonType<std::chrono::seconds::rep>(time))
+            {
+                state._repos[repo] = FromSeconds(time.get<std::chrono::seconds::rep>());
+            }
+        }
+    }
+    else if (repos.is_array())
+    {//Previous format without the check times, they are tracked from now
+        for (auto const& repo : repos)
+        {
+            if (repo.is_string())
+            {
+                state._repos[repo.get<std::string>()] = std::chrono::system_clock::now();
+            }
+        }
+    }
+
+    state._splayWindow = std::chrono::seconds{JsonValue(json, "splayWindow", state._splayWindow.count())};
+    state._rolloutWindow = std::chrono::seconds{JsonValue(json, "rolloutWindow", state._rolloutWindow.count())};
+
+    state._adaptive = JsonValue(json, "adaptive", state._adaptive);
+    for (auto const& releaseTime : json.value("releaseTimes", nlohmann::json::array()))
+    {
+        if (IsJsonType<std::chrono::seconds::rep>(releaseTime))
+        {
+            state._releaseTimes.push_back(FromSeconds(releaseTime.get<std::chrono::seconds::rep>()));
+        }
+    }
+    state._minDelay = std::chrono::seconds{JsonValue(json, "minDelay", state._minDelay.count())};
+    state._maxDelay = std::chrono::seconds{JsonValue(json, "maxDelay", state._maxDelay.count())};
+
+    auto const mirrors = json.value("mirrors", nlohmann::json::object());
+    for (auto const& [candidate, measures] : mirrors.items())
+    {
+        if (!measures.is_object())
+        {
+            continue;
+        }
+        auto& stats = state._mirrors[candidate];
+        if (measures.contains("ttfb") && measures["ttfb"].is_number())
+        {
+            stats._ttfb = measures["ttfb"].get<double>();
+        }
+        if (measures.contains("throughput") && measures["throughput"].is_number())
+        {
+            stats._throughput = measures["throughput"].get<double>();
+        }
+    }
+    return state;
+}
+bool SetScheduleState(ScheduleState const& state, std::filesystem::path const& scheduleFile)
+{
+    if (scheduleFile.empty())
+    {
+        return false;
+    }
+
+    nlohmann::json json = nlohmann::json::object();
+    if (state._lastTime)
+    {
+        json["time"] = ToSeconds(*state._lastTime);
+    }
+
+    nlohmann::json rateLimit = nlohmann::json::object();
+    if (state._rateLimit._limit)
+    {
+        rateLimit["limit"] = *state._rateLimit._limit;
+    }
+    if (state._rateLimit._remaining)
+    {
+        rateLimit["remaining"] = *state._rateLimit._remaining;
+    }
+    if (state._rateLimit._reset)
+    {
+        rateLimit["reset"] = ToSeconds(*state._rateLimit._reset);
+    }
+    if (state._rateLimit._retryAfter)
+    {
+        rateLimit["retryAfter"] = ToSeconds(*state._rateLimit._retryAfter);
+    }
+    json["rateLimit"] = std::move(rateLimit);
+    nlohmann::json repos = nlohmann::json::object();
+    for (auto const& [repo, time] : state._repos)
+    {
+        repos[repo] = ToSeconds(time);
+    }
+    json["repos"] = std::move(repos);
+    json["splayWindow"] = state._splayWindow.count();
+    json["rolloutWindow"] = state._rolloutWindow.count();
+
+    json["adaptive"] = state._adaptive;
+    nlohmann::json releaseTimes = nlohmann::json::array();
+    for (auto const& releaseTime : state._releaseTimes)
+    {
+        releaseTimes.push_back(ToSeconds(releaseTime));
+    }
+    json["releaseTimes"] = std::move(releaseTimes);
+    json["minDelay"] = state._minDelay.count();
+    json["maxDelay"] = state._maxDelay.count();
+
+    nlohmann::json mirrors = nlohmann::json::object();
+    for (auto const& [candidate, stats] : state._mirrors)
+    {
+        nlohmann::json measures = nlohmann::json::object();
+        if (stats._ttfb)
+        {
+            measures["ttfb"] = *stats._ttfb;
+        }
+        if (stats._throughput)
+        {
+            measures["throughput"] = *stats._throughput;
+        }
+        mirrors[candidate] = std::move(measures);
+    }
+    json["mirrors"] = std::move(mirrors);
+
+    std::ofstream file(scheduleFile);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    file << json.dump(4);
+    file.close();
+    return true;
+}
+bool RecordRateLimit(std::string const& owner,
+                     std::string const& repo,
+                     RateLimitState const& rateLimit,
+                     std::filesystem::path const& scheduleFile)
+{
+    auto state = GetScheduleState(scheduleFile).value_or(ScheduleState{});
+
+    TrackRepo(state, owner + '/' + repo, std::chrono::system_clock::now());
+
+    //Only the headers present in the last responses are replaced
+    if (rateLimit._limit)
+    {
+        state._rateLimit._limit = rateLimit._limit;
+    }
+    if (rateLimit._remaining)
+    {
+        state._rateLimit._remaining = rateLimit._remaining;
+    }
+    if (rateLimit._reset)
+    {
+        state._rateLimit._reset = rateLimit._reset;
+    }
+    if (rateLimit._retryAfter)
+    {
+        state._rateLimit._retryAfter = rateLimit._retryAfter;
+    }
+
+    return SetScheduleState(state, scheduleFile);
+}
+bool RecordReleaseTimes(std::vector<ReleaseEntry> const& entries, std::filesystem::path const& scheduleFile)
+{
+    auto state = GetScheduleState(scheduleFile).value_or(ScheduleState{});
+    MergeReleaseTimes(state._releaseTimes, entries);
+    return SetScheduleState(state, scheduleFile);
+}
+std::shared_ptr<MirrorSelector> LoadMirrorSelector(std::vector<std::string> const& mirrors, std::filesystem::path const& scheduleFile)
+{
+    auto state = GetScheduleState(scheduleFile);
+    return std::make_shared<MirrorSelector>(mirrors, state ? std::move(state->_mirrors) : std::map<std::string, MirrorStats>{});
+}
+bool RecordMirrorStats(MirrorSelector const& selector, std::filesystem::path const& scheduleFile)
+{
+    auto state = GetScheduleState(scheduleFile).value_or(ScheduleState{});
+    for (auto& [candidate, stats] : selector.getStats())
+    {
+        state._mirrors[candidate] = stats;
+    }
+    return SetScheduleState(state, scheduleFile);
+}
+std::optional<std::chrono::seconds> GetAdaptiveDelay(ScheduleState const& state)
+{
+    if (!state._adaptive || state._releaseTimes.size() < 2)
+    {
+        return std::nullopt;
+    }
+
+    auto releaseTimes = state._releaseTimes;
+    std::ranges::sort(releaseTimes);
+
+    std::vector<std::chrono::seconds> intervals;
+    intervals.reserve(releaseTimes.size() - 1);
+    for (std::size_t i = 1; i < releaseTimes.size(); ++i)
+    {
+        intervals.push_back(std::chrono::duration_cast<std::chrono::seconds>(releaseTimes[i] - releaseTimes[i - 1]));
+    }
+
+    auto const median = intervals.begin() + static_cast<std::ptrdiff_t>(intervals.size() / 2);
+    std::ranges::nth_element(intervals, median);
+
+    auto const delay = *median / GRUPDATER_ADAPTIVE_CHECKS_PER_RELEASE;
+    return std::clamp(delay, state._minDelay, std::max(state._minDelay, state._maxDelay));
+}
+std::chrono::system_clock::time_point GetNextScheduleTime(ScheduleState const& state, std::chrono::hours const& delay)
+{
+    if (!state._lastTime)
+    {
+        return {};
+    }
+
+    auto const lastTime = *state._lastTime;
+    std::chrono::seconds const baseDelay = GetAdaptiveDelay(state).value_or(delay);
+    auto nextTime = lastTime + baseDelay + GetScheduleSplay(state._splayWindow);
+
+    auto const& rateLimit = state._rateLimit;
+    if (rateLimit._retryAfter)
+    {
+        nextTime = std::max(nextTime, *rateLimit._retryAfter);
+    }
+
+    if (rateLimit._remaining && rateLimit._reset && *rateLimit._reset > lastTime)
+    {
+        //Only the repositories still checked share the budget
+        auto const activeCount = std::ranges::count_if(state._repos, [&lastTime](auto const& repo) {
+            return repo.second + std::chrono::hours{GRUPDATER_SCHEDULE_REPO_EXPIRY_HOURS} >= lastTime;
+        });
+        uint64_t const repoCount = std::max<uint64_t>(static_cast<uint64_t>(activeCount), 1);
+        uint64_t const reserve = rateLimit._limit.value_or(0) * uint64_t{GRUPDATER_RATE_LIMIT_RESERVE_PERCENT} / 100;
+        uint64_t const cost = repoCount * GRUPDATER_REQUESTS_PER_CHECK;
+
+        if (*rateLimit._remaining < reserve + cost)
+        {//Back off before the budget is exhausted
+            nextTime = std::max(nextTime, *rateLimit._reset);
+        }
+        else
+        {//Spread the remaining budget until the reset
+            auto const checks = (*rateLimit._remaining - reserve) / cost;
+            nextTime = std::max(nextTime, lastTime + (*rateLimit._reset - lastTime) / static_cast<int64_t>(checks));
+        }
+    }
+    return nextTime;
+}
+
+uint64_t GetMachineHash()
+{
+    static uint64_t const machineHash = HashFnv1a(ReadMachineId());
+    return machineHash;
+}
+std::chrono::seconds GetScheduleSplay(std::chrono::seconds const& window, std::string_view salt)
+{
+    if (window.count() <= 0)
+    {
+        return std::chrono::seconds{0};
+    }
+
+    auto hash = HashFnv1a(salt, GetMachineHash());
+    //Final mix (splitmix64) so the low bits used by the modulo are well distributed
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return std::chrono::seconds{static_cast<std::chrono::seconds::rep>(hash % static_cast<uint64_t>(window.count()))};
+}
+
+std::optional<std::chrono::system_clock::time_point> GetScheduleTime(std::filesystem::path const &scheduleFile)
+{
+    if (auto state = GetScheduleState(scheduleFile))
+    {
+        return state->_lastTime;
+    }
+    return std::nullopt;
+}
+
+bool SetScheduleTime(std::filesystem::path const &scheduleFile, std::chrono::system_clock::time_point const &time)
+{
+    if (scheduleFile.empty())
+    {
+        return false;
+    }
+
+    //Keep the rest of the state (rate limit, tracked repositories)
+    auto state = GetScheduleState(scheduleFile).value_or(ScheduleState{});
+    state._lastTime = time;
+    return SetScheduleState(state, scheduleFile);
+}
+
+bool VerifyScheduleTime(std::chrono::system_clock::time_point const &timePoint,
+                        std::chrono::hours const &delay,
+                        std::chrono::seconds const& splayWindow)
+{
+    return std::chrono::system_clock::now() >= timePoint + delay + GetScheduleSplay(splayWindow);
+}
+bool VerifyRolloutTime(RepoContext const& context, std::chrono::seconds const& rolloutWindow)
+{
+    if (!context._publishedAt || rolloutWindow.count() <= 0)
+    {
+        return true;
+    }
+    return std::chrono::system_clock::now() >= *context._publishedAt + GetScheduleSplay(rolloutWindow, context._owner + '/' + context._repo);
+}
+
+bool ApplyFiles(FileSystem& fileSystem, std::filesystem::path const& source, std::filesystem::path const& target)
+{
+    auto const keptPaths = GetKeptPaths(fileSystem, source, target);
+    if (!keptPaths)
+    {
+        return false;
+    }
+
+    //Remove all files that are not in dynamicFiles and avoid removing the temporary folder
+    std::vector<std::filesystem::path> removedFiles;
+    bool iterated = fileSystem.iterate(target, [&](std::filesystem::path const& path, FileStatus const& status) {
+        if (status._type != FileType::Regular)
+        {
+            return true;
+        }
+
+        if (!IsKept(*keptPaths, path.lexically_relative(target).lexically_normal()))
+        {
+            removedFiles.push_back(path);
+        }
+        return true;
+    });
+    if (!iterated)
+    {
+        Log(LogLevel::Error) << "Failed to list the files of " << target;
+        return false;
+    }
+    for (auto const& file : removedFiles)
+    {
+        Log(LogLevel::Debug) << "Removing file: " << file;
+        TraceSpan const span{"RemoveFile", {file.string()}};
+        if (!fileSystem.remove(file))
+        {
+            Log(LogLevel::Error) << "Failed to remove file " << file;
+            return false;
+        }
+    }
+
+    //Take all files from the extracted asset (root) and copy them to the target directory
+    auto* scope = MetricsScope::current();
+    std::filesystem::path const planPath = std::filesystem::path{GRUPDATER_APPLY_PLAN_FILE}.lexically_normal();
+    bool success = true;
+    iterated = fileSystem.iterate(source, [&](std::filesystem::path const& path, FileStatus const& status) {
+        auto const relativePath = path.lexically_relative(source);
+        if (status._type != FileType::Regular || relativePath == planPath)
+        {
+            return true;
+        }
+
+        auto resultFilePath = target / relativePath;
+        if (fileSystem.stat(resultFilePath)._type != FileType::None)
+        {//A kept dynamic file
+            Log(LogLevel::Debug) << "Keeping file: " << resultFilePath;
+            return true;
+        }
+        Log(LogLevel::Debug) << "Copy file: " << path << " to " << resultFilePath;
+        TraceSpan const span{"CopyFile", {resultFilePath.string()}};
+        if (!fileSystem.createDirectories(resultFilePath.parent_path()) || !fileSystem.copy(path, resultFilePath))
+        {
+            Log(LogLevel::Error) << "Failed to copy file " << path << " to " << resultFilePath;
+            success = false;
+            return false;
+        }
+        if (scope != nullptr)
+        {
+            scope->addFiles(1);
+            scope->addBytes(status._size);
+        }
+        return true;
+    });
+    if (!iterated)
+    {
+        Log(LogLevel::Error) << "Failed to list the files of " << source;
+        return false;
+    }
+    return success;
+}
+
+bool PrepareApply(std::filesystem::path const& rootAssetPath, std::filesystem::path const& target)
+{
+    std::error_code sourceError;
+    std::error_code targetError;
+    auto const source = std::filesystem::absolute(rootAssetPath, sourceError).lexically_normal();
+    auto const absoluteTarget = std::filesystem::absolute(target, targetError).lexically_normal();
+    if (sourceError || targetError)
+    {
+        Log(LogLevel::Error) << "Invalid root asset or target path";
+        return false;
+    }
+
+    auto& fileSystem = *GetOsFileSystem();
+    auto keptPaths = GetKeptPaths(fileSystem, source, absoluteTarget);
+    if (!keptPaths)
+    {
+        return false;
+    }
+
+    ApplyPlan plan;
+    plan._keep = std::move(*keptPaths);
+    std::filesystem::path const planPath = std::filesystem::path{GRUPDATER_APPLY_PLAN_FILE}.lexically_normal();
+    bool const iterated = fileSystem.iterate(source, [&](std::filesystem::path const& path, FileStatus const& status) {
+        auto relativePath = path.lexically_relative(source);
+        if (status._type == FileType::Regular && relativePath != planPath)
+        {
+            plan._copy.push_back(std::move(relativePath));
+        }
+        return true;
+    });
+    if (!iterated)
+    {
+        Log(LogLevel::Error) << "Failed to list the files of " << source;
+        return false;
+    }
+
+    auto const planFile = (source / GRUPDATER_APPLY_PLAN_FILE).lexically_normal();
+    if (!WriteApplyPlan(plan, planFile))
+    {
+        Log(LogLevel::Error) << "Failed to write the apply plan " << planFile;
+        return false;
+    }
+    Log(LogLevel::Info) << "Apply plan written to " << planFile << " (" << plan._copy.size() << " files)";
+    return true;
+}
+
+bool ApplyUpdate(std::filesystem::path const &target, std::filesystem::path callerExecutable, std::optional<uint32_t> callerPid, UpdateMetrics* metrics)
+{
+    MetricsScope scope{metrics, "apply"};
+    TraceSpan const applySpan{"ApplyUpdate"};
+
+    //Wait for the caller to close
+    if (callerPid)
+    {
+        //Get handle
+        HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, *callerPid);
+        if (hProcess != nullptr)
+        {
+            //Wait for the process to finish
+            Log(LogLevel::Info) << "Waiting for process " << *callerPid << " to finish";
+            DWORD ret = WaitForSingleObject(hProcess, GRUPDATER_WAIT_PID_TIMEOUT_MS);
+            CloseHandle(hProcess);
+            if (ret != WAIT_OBJECT_0)
+            {
+                Log(LogLevel::Error) << "Failed to wait for process " << *callerPid;
+                return false;
+            }
+        }
+        else
+        {
+            Log(LogLevel::Warning) << "Failed to open process " << *callerPid;
+        }
+    }
+    //The application is down from here until the files are copied
+    auto const downtimeBegin = std::chrono::steady_clock::now();
+
+    if (!target.is_absolute())
+    {
+        Log(LogLevel::Error) << "Target path must be absolute";
+        return false;
+    }
+    if (target.empty() || !std::filesystem::exists(target) || !std::filesystem::is_directory(target))
+    {
+        Log(LogLevel::Error) << "Invalid target path";
+        return false;
+    }
+
+    Log(LogLevel::Info) << "Current directory: " << std::filesystem::current_path();
+    Log(LogLevel::Info) << "Applying update to " << target;
+
+    //GRUpdater executable (from the caller side) should be in the same directory as the target
+    auto updaterPath = target / GRUPDATER_EXECUTABLE_NAME;
+    if (!std::filesystem::exists(updaterPath) || !std::filesystem::is_regular_file(updaterPath))
+    {
+        Log(LogLevel::Error) << "Invalid updater path: " << updaterPath;
+        return false;
+    }
+
+    if (!ApplyFiles(*GetOsFileSystem(), std::filesystem::current_path(), target))
+    {
+        return false;
+    }
+    scope.setSuccess(true);
+    GetTelemetry()._applies.fetch_add(1, std::memory_order_relaxed);
+    GetTelemetry()._applyDowntimeSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - downtimeBegin).count());
+
+    if (!callerExecutable.empty())
+    {
+        Log(LogLevel::Info) << "Successfully applied update, you can now restart the application !";
+        std::this_thread::sleep_for(std::chrono::seconds{2});
+
+        Log(LogLevel::Info) << "Caller executable: " << callerExecutable;
+        //Launch the caller executable
+        std::wstring callerExecutableW = callerExecutable.wstring();
+        STARTUPINFOW si{};
+        si.cb = sizeof(si);
+        PROCESS_INFORMATION pi{};
+        if (!CreateProcessW(callerExecutableW.c_str(), nullptr,
+            nullptr, nullptr, FALSE,
+            CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS, nullptr,
+            callerExecutable.parent_path().wstring().c_str(), &si, &pi))
+        {
+            Log(LogLevel::Error) << "Failed to create process";
+            return true; //Return true because the update was successful
+        }
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+    }
+
+    return true;
+}
+
+bool RequestApplyUpdate(std::filesystem::path const &rootAssetPath, std::filesystem::path const& callerExecutable, ApplyMode mode)
+{
+    if (rootAssetPath.empty() || !std::filesystem::exists(rootAssetPath) || !std::filesystem::is_directory(rootAssetPath))
+    {
+        Log(LogLevel::Error) << "Invalid root asset path";
+        return false;
+    }
+
+    //GRUpdater executable (from the extracted assets) should be in the same directory as the root asset
+    bool const lean = mode == ApplyMode::Lean;
+    auto updaterPath = rootAssetPath / (lean ? GRUPDATER_APPLY_EXECUTABLE_NAME : GRUPDATER_EXECUTABLE_NAME);
+    if (!std::filesystem::exists(updaterPath) || !std::filesystem::is_regular_file(updaterPath))
+    {
+        Log(LogLevel::Error) << "Invalid updater path";
+        return false;
+    }
+    //The plan is written now for the target given to the executable, with the current dynamic files
+    auto const target = std::filesystem::current_path();
+    if (lean && !PrepareApply(rootAssetPath, target))
+    {
+        Log(LogLevel::Error) << "Failed to prepare the apply plan";
+        return false;
+    }
+
+    //Get the caller process id
+    auto callerPid = GetCurrentProcessId();
+
+    //Launch the updater executable
+    std::wstring updaterPathW = updaterPath.wstring();
+    std::wstring commandLine = (lean ? GRUPDATER_APPLY_EXECUTABLE_NAME_W L" --target \""
+                                     : GRUPDATER_EXECUTABLE_NAME_W L" apply --target \"")
+            + target.wstring()
+            + L"\" --pid " + std::to_wstring(callerPid)
+            + L" --caller \"" + callerExecutable.wstring() + L'\"';
+
+    Log(LogLevel::Debug) << "Command line: " << (lean ? GRUPDATER_APPLY_EXECUTABLE_NAME : GRUPDATER_EXECUTABLE_NAME " apply")
+                         << " --target " << target << " --pid " << callerPid << " --caller " << callerExecutable;
+    Log(LogLevel::Debug) << "Updater path: " << updaterPath;
+
+    STARTUPINFOW si{};
+    si.cb = sizeof(si);
+    PROCESS_INFORMATION pi{};
+    if (!CreateProcessW(updaterPathW.c_str(), commandLine.data(),
+        nullptr, nullptr, FALSE,
+        CREATE_NEW_PROCESS_GROUP | CREATE_NEW_CONSOLE, nullptr,
+        rootAssetPath.wstring().c_str(), &si, &pi))
+    {
+        Log(LogLevel::Error) << "Failed to create process";
+        return false;
+    }
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return true;
+}
+
+//TimerWheel
+
+TimerWheel::TimerWheel(uint64_t currentTick) :
+        _g_currentTick(currentTick)
+{}
+
+void TimerWheel::schedule(Id id, uint64_t expiryTick)
+{
+    ++this->_g_size;
+    this->insert({id, std::max(expiryTick, this->_g_currentTick + 1)}, nullptr);
+}
+void TimerWheel::advance(uint64_t tick, std::vector<Id>& expired)
+{
+    if (tick <= this->_g_currentTick)
+    {
+        return;
+    }
+
+    //Nothing to expire before the next timer, jump and re-insert the timers instead of cascading tick by tick
+    auto const nextExpiry = this->getNextExpiry();
+    if (!nextExpiry || *nextExpiry > this->_g_currentTick + SlotCount)
+    {
+        auto const jumpTick = nextExpiry ? std::min(tick, *nextExpiry - 1) : tick;
+
+        std::vector<Timer> timers;
+        timers.reserve(this->_g_size);
+        for (auto& level : this->_g_slots)
+        {
+            for (auto& slot : level)
+            {
+                timers.insert(timers.end(), slot.begin(), slot.end());
+                slot.clear();
+            }
+        }
+
+        this->_g_currentTick = jumpTick;
+        for (auto const& timer : timers)
+        {
+            this->insert(timer, &expired);
+        }
+    }
+
+    while (this->_g_currentTick < tick)
+    {
+        ++this->_g_currentTick;
+
+        //Cascade from the highest level so the timers can go down more than one level
+        for (std::size_t level = LevelCount - 1; level > 0; --level)
+        {
+            auto const shift = level * LevelBits;
+            if ((this->_g_currentTick & ((uint64_t{1} << shift) - 1)) != 0)
+            {
+                continue;
+            }
+
+            auto timers = std::move(this->_g_slots[level][(this->_g_currentTick >> shift) & (SlotCount - 1)]);
+            this->_g_slots[level][(this->_g_currentTick >> shift) & (SlotCount - 1)].clear();
+            for (auto const& timer : timers)
+            {
+                this->insert(timer, &expired);
+            }
+        }
+
+        auto& slot = this->_g_slots[0][this->_g_currentTick & (SlotCount - 1)];
+        for (auto const& timer : slot)
+        {
+            expired.push_back(timer._id);
+            --this->_g_size;
+        }
+        slot.clear();
+    }
+}
+std::optional<uint64_t> TimerWheel::getNextExpiry() const
+{
+    std::optional<uint64_t> result;
+    for (auto const& level : this->_g_slots)
+    {
+        for (auto const& slot : level)
+        {
+            for (auto const& timer : slot)
+            {
+                if (!result || timer._expiry < *result)
+                {
+                    result = timer._expiry;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+uint64_t TimerWheel::getCurrentTick() const
+{
+    return this->_g_currentTick;
+}
+std::size_t TimerWheel::getSize() const
+{
+    return this->_g_size;
+}
+
+void TimerWheel::insert(Timer timer, std::vector<Id>* expired)
+{
+    if (timer._expiry <= this->_g_currentTick && expired != nullptr)
+    {
+        expired->push_back(timer._id);
+        --this->_g_size;
+        return;
+    }
+
+    uint64_t const maxDelta = (uint64_t{1} << (LevelBits * LevelCount)) - 1;
+    timer._expiry = std::min(timer._expiry, this->_g_currentTick + maxDelta);
+
+    auto const delta = timer._expiry - this->_g_currentTick;
+    std::size_t level = 0;
+    while (level < LevelCount - 1 && delta >= (uint64_t{1} << (LevelBits * (level + 1))))
+    {
+        ++level;
+    }
+
+    this->_g_slots[level][(timer._expiry >> (LevelBits * level)) & (SlotCount - 1)].push_back(timer);
+}
+
+std::optional<std::vector<WatchEntry>> LoadManifest(std::filesystem::path const& manifestFile)
+{
+    std::ifstream file(manifestFile);
+    if (!file.is_open())
+    {
+        return std::nullopt;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+    file.close();
+    if (json.is_discarded() || !json.is_object() || !json.contains("repos") || !json["repos"].is_array())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<WatchEntry> entries;
+    for (auto const& repo : json["repos"])
+    {
+        if (!repo.is_object())
+        {
+            return std::nullopt;
+        }
+
+        WatchEntry entry;
+        entry._owner = repo.value("owner", std::string{});
+        entry._repo = repo.value("repo", std::string{});
+        entry._allowPrerelease = repo.value("prerelease", false);
+
+        auto currentTag = ParseTag(repo.value("current", std::string{}));
+        if (entry._owner.empty() || entry._repo.empty() || !currentTag)
+        {
+            Log(LogLevel::Error) << "Invalid manifest entry " << repo.dump();
+            return std::nullopt;
+        }
+        entry._currentTag = *currentTag;
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+//Daemon
+
+Daemon::Daemon(Callback onNewerTag, ScheduleState schedule) :
+        _g_onNewerTag(std::move(onNewerTag)),
+        _g_schedule(std::move(schedule)),
+        _g_wheel(static_cast<uint64_t>(ToSeconds(std::chrono::system_clock::now())))
+{
+    this->_g_schedule._lastTime.reset();
+    this->_g_schedule._releaseTimes.clear();
+    this->_g_schedule._repos.clear();
+}
+
+void Daemon::watch(WatchEntry entry)
+{
+    this->_g_schedule._repos[entry._owner + '/' + entry._repo] = std::chrono::system_clock::now();
+
+    ReleaseIndex index{entry._owner, entry._repo};
+    this->_g_watched.push_back({std::move(entry), std::move(index), std::nullopt, {}});
+
+    //First check as soon as possible
+    this->_g_wheel.schedule(this->_g_watched.size() - 1, this->_g_wheel.getCurrentTick() + 1);
+}
+
+std::optional<std::chrono::system_clock::time_point> Daemon::poll()
+{
+    std::vector<TimerWheel::Id> expired;
+    this->_g_wheel.advance(static_cast<uint64_t>(ToSeconds(std::chrono::system_clock::now())), expired);
+
+    for (auto const id : expired)
+    {
+        this->check(static_cast<std::size_t>(id));
+    }
+
+    if (auto const nextExpiry = this->_g_wheel.getNextExpiry())
+    {
+        return FromSeconds(static_cast<std::chrono::seconds::rep>(*nextExpiry));
+    }
+    return std::nullopt;
+}
+void Daemon::run()
+{
+    this->_g_running = true;
+    while (this->_g_running)
+    {
+        auto const nextTime = this->poll();
+        if (!nextTime)
+        {
+            break;
+        }
+
+        //Sleep by small steps so stop() is taken into account quickly
+        while (this->_g_running && std::chrono::system_clock::now() < *nextTime)
+        {
+            std::this_thread::sleep_for(std::min<std::chrono::system_clock::duration>(*nextTime - std::chrono::system_clock::now(),
+                                                                                    std::chrono::seconds{1}));
+        }
+    }
+    this->_g_running = false;
+}
+void Daemon::stop()
+{
+    this->_g_running = false;
+}
+
+void Daemon::check(std::size_t id)
+{
+    auto& watched = this->_g_watched[id];
+    auto const now = std::chrono::system_clock::now();
+    this->_g_schedule._repos[watched._entry._owner + '/' + watched._entry._repo] = now;
+
+    bool const updated = watched._index.update();
+
+    //The rate limit is shared by every watched repository
+    auto const& rateLimit = watched._index.getRateLimit();
+    if (rateLimit._limit)
+    {
+        this->_g_schedule._rateLimit._limit = rateLimit._limit;
+    }
+    if (rateLimit._remaining)
+    {
+        this->_g_schedule._rateLimit._remaining = rateLimit._remaining;
+    }
+    if (rateLimit._reset)
+    {
+        this->_g_schedule._rateLimit._reset = rateLimit._reset;
+    }
+    if (rateLimit._retryAfter)
+    {
+        this->_g_schedule._rateLimit._retryAfter = rateLimit._retryAfter;
+    }
+
+    if (updated)
+    {
+        MergeReleaseTimes(watched._releaseTimes, watched._index.getEntries());
+
+        auto const* entry = watched._index.latest(watched._entry._allowPrerelease);
+        if (entry != nullptr && entry->_tag > watched._entry._currentTag)
+        {
+            auto const context = watched._index.makeContext(*entry);
+            if (VerifyRolloutTime(context, this->_g_schedule._rolloutWindow))
+            {
+                //Only notify once per handled new tag
+                if (!this->_g_onNewerTag || this->_g_onNewerTag(watched._entry, context))
+                {
+                    watched._entry._currentTag = entry->_tag;
+                }
+            }
+        }
+    }
+    else
+    {
+        Log(LogLevel::Error) << "Failed to check " << watched._entry._owner << '/' << watched._entry._repo;
+    }
+
+    watched._lastTime = now;
+
+    auto schedule = this->_g_schedule;
+    schedule._lastTime = watched._lastTime;
+    schedule._releaseTimes = watched._releaseTimes;
+    auto const nextTime = GetNextScheduleTime(schedule);
+    this->_g_wheel.schedule(id, static_cast<uint64_t>(ToSeconds(nextTime)));
+}
+
+//PeerServer
+
+struct PeerServer::Repo
+{
+    explicit Repo(std::string const& owner, std::string const& repo) :
+            _index(owner, repo)
+    {}
+
+    std::mutex _mutex;
+    ReleaseIndex _index;
+    std::optional<std::chrono::steady_clock::time_point> _lastRefresh;
+};
+
+struct PeerServer::AssetListener
+{
+    std::atomic<socket_t> _socket{INVALID_SOCKET};
+    std::thread _thread;
+};
+
+PeerServer::PeerServer(std::filesystem::path cacheDirectory, std::chrono::seconds refreshDelay) :
+        _g_cacheDirectory(std::move(cacheDirectory)),
+        _g_refreshDelay(refreshDelay),
+        _g_server(std::make_unique<httplib::Server>())
+{
+    using namespace httplib;
+
+    this->_g_server->Get(R"(/repos/([^/]+)/([^/]+)/releases)", [this](Request const& req, Response& res) {
+        auto const owner = req.matches[1].str();
+        auto const repoName = req.matches[2].str();
+        if (!IsSafeName(owner) || !IsSafeName(repoName))
+        {
+            res.status = StatusCode::BadRequest_400;
+            return;
+        }
+
+        auto const readParam = [&req](char const* key, std::size_t defaultValue) {
+            std::size_t value = defaultValue;
+            if (req.has_param(key))
+            {
+                auto const param = req.get_param_value(key);
+                std::from_chars(param.data(), param.data() + param.size(), value);
+            }
+            return std::max<std::size_t>(value, 1);
+        };
+        auto const page = readParam("page", 1);
+        auto const perPage = std::min<std::size_t>(readParam("per_page", 30), 100);
+
+        auto repo = this->getRepo(owner, repoName);
+        std::scoped_lock const lock(repo->_mutex);
+
+        if (!this->refresh(*repo) && repo->_index.getEntries().empty())
+        {
+            res.status = StatusCode::BadGateway_502;
+            return;
         }
+        while (repo->_index.getEntries().size() < page * perPage && repo->_index.fetchOlder())
+        {}
 
-        if (zipStat.name[std::strlen(zipStat.name) - 1] == '/')
+        //Same order as GitHub, from the newest to the oldest
+        std::vector<ReleaseEntry const*> entries;
+        entries.reserve(repo->_index.getEntries().size());
+        for (auto const& entry : repo->_index.getEntries())
         {
-            continue;
+            entries.push_back(&entry);
         }
+        std::ranges::sort(entries, [](ReleaseEntry const* left, ReleaseEntry const* right) {
+            return std::tie(left->_publishedAt, left->_id) > std::tie(right->_publishedAt, right->_id);
+        });
 
-        zip_file* zipFile = zip_fopen_index(zip, i, 0);
-        if (zipFile == nullptr)
+        nlohmann::json json = nlohmann::json::array();
+        for (std::size_t i = (page - 1) * perPage; i < std::min(entries.size(), page * perPage); ++i)
         {
-            std::cerr << "Failed to open index " << i << " in zip archive " << assetPathStr << '\n';
-            zip_close(zip);
-            return std::nullopt;
+            auto const& entry = *entries[i];
+
+            nlohmann::json assets = nlohmann::json::array();
+            auto const backend = FindArchiveBackend(entry._asset);
+            if (!entry._assetUrl.empty() && backend)
+            {
+                assets.push_back({{"name", entry._asset},
+                                  {"content_type", backend->getContentTypes().front()},
+                                  {"browser_download_url", entry._assetUrl}});
+            }
+
+            json.push_back({{"id", entry._id},
+                            {"tag_name", ToString(entry._tag)},
+                            {"draft", false},
+                            {"prerelease", entry._prerelease},
+                            {"published_at", entry._publishedAt ? FormatIsoTime(*entry._publishedAt) : std::string{}},
+                            {"assets", std::move(assets)}});
         }
 
-        std::ofstream file(filePath, std::ios::binary);
-        if (!file.is_open())
+        //Hash of the served page, so any edit of a release (asset, prerelease flag) changes it
+        auto body = json.dump();
+        std::array<char, 16> buffer{};
+        auto const [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), HashFnv1a(body), 16);
+        auto const etag = '"' + std::string(buffer.data(), ptr) + '"';
+        res.set_header("ETag", etag);
+        if (req.get_header_value("If-None-Match") == etag)
         {
-            std::cerr << "Failed to create file " << filePath << '\n';
-            zip_fclose(zipFile);
-            zip_close(zip);
-            return std::nullopt;
+            res.status = StatusCode::NotModified_304;
+            return;
         }
+        res.set_content(std::move(body), "application/json");
+    });
 
-        std::array<char, 100> buffer{};
-        zip_uint64_t total = 0;
-        while (total != zipStat.size)
+    this->_g_server->Get(R"(/assets/([^/]+)/([^/]+)/([^/]+)/([^/]+))", [this](Request const& req, Response& res) {
+        std::filesystem::path assetPath;
+        auto const status = this->cacheAsset(req.matches[1].str(), req.matches[2].str(), req.matches[3].str(), req.matches[4].str(), assetPath);
+        if (status != StatusCode::OK_200)
         {
-            auto const dataSize = zip_fread(zipFile, buffer.data(), buffer.size());
-            if (dataSize < 0)
-            {
-                std::cerr << "Failed to read data from zip archive " << assetPathStr << '\n';
-                zip_fclose(zipFile);
-                zip_close(zip);
-                return std::nullopt;
-            }
-            file.write(buffer.data(), dataSize);
-            total += dataSize;
+            res.status = status;
+            return;
         }
-        file.close();
-        zip_fclose(zipFile);
+        //The status is left unset so httplib can answer Range requests
+        res.set_file_content(assetPath.string(), "application/octet-stream");
+    });
+}
+PeerServer::~PeerServer()
+{
+    this->stop();
+    if (this->_g_assetListener && this->_g_assetListener->_thread.joinable())
+    {
+        this->_g_assetListener->_thread.join();
     }
+}
 
-    if (extractedFilesHaveRoot && rootPath.empty())
+bool PeerServer::listen(std::string const& host, int port, int assetPort)
+{
+    std::error_code errorCode;
+    std::filesystem::create_directories(this->_g_cacheDirectory, errorCode);
+
+    if (assetPort != 0)
     {
-        extractedFilesHaveRoot = false;
-    }
+        auto const sock = OpenListenSocket(host, assetPort);
+        if (sock == INVALID_SOCKET)
+        {
+            return false;
+        }
+        this->_g_assetListener = std::make_unique<AssetListener>();
+        this->_g_assetListener->_socket = sock;
+        this->_g_assetListener->_thread = std::thread([this, sock] {
+            FileResolver const resolve = [this](std::string_view target, std::filesystem::path& filePath) {
+                //Same path as the httplib endpoint: /assets/{owner}/{repo}/{tag}/{asset}
+                std::array<std::string, 4> parts;
+                if (!target.starts_with("/assets/"))
+                {
+                    return static_cast<int>(httplib::StatusCode::NotFound_404);
+                }
+                target.remove_prefix(8);
+                for (std::size_t i = 0; i < parts.size(); ++i)
+                {
+                    auto const slash = target.find('/');
+                    if ((slash == std::string_view::npos) != (i + 1 == parts.size()))
+                    {
+                        return static_cast<int>(httplib::StatusCode::NotFound_404);
+                    }
+                    parts[i] = target.substr(0, slash);
+                    target.remove_prefix(slash == std::string_view::npos ? target.size() : slash + 1);
+                }
+                return this->cacheAsset(parts[0], parts[1], parts[2], parts[3], filePath);
+            };
 
-    zip_close(zip);
+            httplib::ThreadPool pool(CPPHTTPLIB_THREAD_POOL_COUNT);
+            while (true)
+            {
+                auto const client = accept(sock, nullptr, nullptr);
+                if (client == INVALID_SOCKET)
+                {
+                    if (this->_g_assetListener->_socket == INVALID_SOCKET)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                int const noDelay = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char const*>(&noDelay), sizeof(noDelay));
+                if (!pool.enqueue([client, &resolve] {
+                        ServeFileConnection(client, resolve);
+                        httplib::detail::shutdown_socket(client);
+                        httplib::detail::close_socket(client);
+                    }))
+                {
+                    httplib::detail::close_socket(client);
+                }
+            }
+            pool.shutdown();
+        });
+    }
 
-    if (!extractedFilesHaveRoot)
+    bool const success = this->_g_server->listen(host, port);
+    this->stop();
+    if (this->_g_assetListener && this->_g_assetListener->_thread.joinable())
     {
-        return assetPath.parent_path();
+        this->_g_assetListener->_thread.join();
     }
-    return assetPath.parent_path() / rootPath;
-#endif // _UPDATER_DEF_DUMMYTEST
+    return success;
 }
-
-std::optional<std::chrono::system_clock::time_point> GetScheduleTime(std::filesystem::path const &scheduleFile)
+void PeerServer::stop()
 {
-    if (scheduleFile.empty() || !std::filesystem::exists(scheduleFile) || !std::filesystem::is_regular_file(scheduleFile))
+    this->_g_server->stop();
+    if (this->_g_assetListener)
     {
-        return std::nullopt;
+        auto const sock = this->_g_assetListener->_socket.exchange(INVALID_SOCKET);
+        if (sock != INVALID_SOCKET)
+        {
+            //Unblock the accept of the listener thread
+            httplib::detail::shutdown_socket(sock);
+            httplib::detail::close_socket(sock);
+        }
     }
+}
 
-    std::ifstream file(scheduleFile);
-    if (!file.is_open())
+std::shared_ptr<PeerServer::Repo> PeerServer::getRepo(std::string const& owner, std::string const& repo)
+{
+    std::scoped_lock const lock(this->_g_mutex);
+    auto& result = this->_g_repos[owner + '/' + repo];
+    if (!result)
     {
-        return std::nullopt;
+        result = std::make_shared<Repo>(owner, repo);
     }
+    return result;
+}
 
-    try
+bool PeerServer::refresh(Repo& repo)
+{
+    auto const now = std::chrono::steady_clock::now();
+    if (repo._lastRefresh && now - *repo._lastRefresh < this->_g_refreshDelay)
     {
-        nlohmann::json json = nlohmann::json::parse(file);
-        auto scheduleTimePoint = std::chrono::system_clock::time_point(std::chrono::seconds{json["time"].get<std::chrono::seconds::rep>()});
-        file.close();
-        return scheduleTimePoint;
+        return true;
     }
-    catch (const nlohmann::json::parse_error& e)
+    if (!repo._index.update())
     {
-        file.close();
+        return false;
     }
-    return std::nullopt;
+    repo._lastRefresh = now;
+    return true;
 }
 
-bool SetScheduleTime(std::filesystem::path const &scheduleFile, std::chrono::system_clock::time_point const &time)
+int PeerServer::cacheAsset(std::string const& owner,
+                           std::string const& repoName,
+                           std::string const& tag,
+                           std::string const& asset,
+                           std::filesystem::path& assetPath)
 {
-    if (scheduleFile.empty())
+    using namespace httplib;
+
+    if (!IsSafeName(owner) || !IsSafeName(repoName) || !IsSafeName(tag) || !IsSafeName(asset))
     {
-        return false;
+        return StatusCode::BadRequest_400;
     }
 
-    nlohmann::json scheduleTime = nlohmann::json{{"time", std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count()}};
-    std::ofstream file(scheduleFile);
-    if (!file.is_open())
+    assetPath = this->_g_cacheDirectory / owner / repoName / tag / asset;
+    if (std::filesystem::is_regular_file(assetPath))
     {
-        return false;
+        return StatusCode::OK_200;
     }
-    file << scheduleTime.dump(4);
-    file.close();
-    return true;
-}
-
-bool VerifyScheduleTime(std::chrono::system_clock::time_point const &timePoint, std::chrono::hours const &delay)
-{
-    auto const now = std::chrono::system_clock::now();
-    return std::chrono::duration_cast<std::chrono::hours>(now - timePoint).count() >= delay.count();
-}
 
-bool ApplyUpdate(std::filesystem::path const &target, std::filesystem::path callerExecutable, std::optional<uint32_t> callerPid)
-{
-    //Wait for the caller to close
-    if (callerPid)
+    //The requests of an asset being downloaded wait for that download
+    std::promise<int> download;
+    std::shared_future<int> inFlight;
     {
-        //Get handle
-        HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, *callerPid);
-        if (hProcess != nullptr)
+        std::scoped_lock const lock(this->_g_mutex);
+        if (auto const it = this->_g_downloads.find(assetPath); it != this->_g_downloads.end())
         {
-            //Wait for the process to finish
-            std::cout << "Waiting for process " << *callerPid << " to finish\n";
-            DWORD ret = WaitForSingleObject(hProcess, GRUPDATER_WAIT_PID_TIMEOUT_MS);
-            CloseHandle(hProcess);
-            if (ret != WAIT_OBJECT_0)
-            {
-                std::cerr << "Failed to wait for process " << *callerPid << '\n';
-                return false;
-            }
+            inFlight = it->second;
+        }
+        else if (std::filesystem::is_regular_file(assetPath))
+        {//Renamed by a download that ended since the first check
+            return StatusCode::OK_200;
         }
         else
         {
-            std::cout << "Failed to open process " << *callerPid << '\n';
+            this->_g_downloads.emplace(assetPath, download.get_future().share());
         }
     }
+    if (inFlight.valid())
+    {
+        return inFlight.get();
+    }
 
-    if (!target.is_absolute())
+    auto const status = this->downloadAsset(owner, repoName, tag, asset, assetPath);
     {
-        std::cerr << "Target path must be absolute\n";
-        return false;
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_downloads.erase(assetPath);
     }
-    if (target.empty() || !std::filesystem::exists(target) || !std::filesystem::is_directory(target))
+    download.set_value(status);
+    return status;
+}
+int PeerServer::downloadAsset(std::string const& owner,
+                              std::string const& repoName,
+                              std::string const& tag,
+                              std::string const& asset,
+                              std::filesystem::path const& assetPath)
+{
+    using namespace httplib;
+
+    //Only assets of known releases are downloaded, the index is not locked during the download
+    HttpRequest request;
     {
-        std::cerr << "Invalid target path\n";
-        return false;
+        auto repo = this->getRepo(owner, repoName);
+        std::scoped_lock const lock(repo->_mutex);
+
+        auto findEntry = [&]() -> ReleaseEntry const* {
+            auto const& entries = repo->_index.getEntries();
+            auto it = std::ranges::find_if(entries, [&](ReleaseEntry const& entry) {
+                return entry._asset == asset && ToString(entry._tag) == tag;
+            });
+            return it == entries.end() ? nullptr : &(*it);
+        };
+
+        auto const* entry = findEntry();
+        if (entry == nullptr && this->refresh(*repo))
+        {
+            entry = findEntry();
+        }
+        if (entry == nullptr)
+        {
+            return StatusCode::NotFound_404;
+        }
+
+        auto const [urlOrigin, urlPath] = SplitUrl(entry->_assetUrl);
+        request._baseUrl = urlOrigin.empty() ? GetOrigins()._download : urlOrigin;
+        request._path = urlPath;
+        request._followRedirects = true;
     }
 
-    std::cout << "Current directory: " << std::filesystem::current_path() << '\n';
-    std::cout << "Applying update to " << target << '\n';
+    std::error_code errorCode;
+    std::filesystem::create_directories(assetPath.parent_path(), errorCode);
 
-    //GRUpdater executable (from the caller side) should be in the same directory as the target
-    auto updaterPath = target / GRUPDATER_EXECUTABLE_NAME;
-    if (!std::filesystem::exists(updaterPath) || !std::filesystem::is_regular_file(updaterPath))
+    auto partialPath = assetPath;
+    partialPath += ".part";
+    if (!DownloadToFile(*GetTransport(), request, partialPath))
     {
-        std::cerr << "Invalid updater path: " << updaterPath << '\n';
-        return false;
+        return StatusCode::BadGateway_502;
     }
-
-    //Retrieve where this executable is stored (only the first folder from caller root (this should be "temp/"))
-    std::filesystem::path temporaryPath = std::filesystem::relative(std::filesystem::current_path(), target);
-    if (temporaryPath.empty())
+    std::filesystem::rename(partialPath, assetPath, errorCode);
+    if (errorCode)
     {
-        std::cerr << "Failed to get temporary path\n";
-        return false;
+        return StatusCode::InternalServerError_500;
     }
+    Log(LogLevel::Info) << "Cached asset " << assetPath;
+    return StatusCode::OK_200;
+}
 
-    std::cout << "Temporary path: " << temporaryPath << '\n';
+//CancelScope
 
-    if (temporaryPath.has_parent_path())
-    {
-        temporaryPath = temporaryPath.parent_path();
-    }
+CancelScope::CancelScope(std::stop_token stopToken) :
+        _g_token(std::move(stopToken)),
+        _g_previous(std::exchange(gCancelScope, this))
+{}
+CancelScope::~CancelScope()
+{
+    gCancelScope = this->_g_previous;
+}
 
-    //Get the current json file telling where is all the dynamic files that should not be touched
-    std::vector<std::filesystem::path> dynamicFiles;
-    auto dynamicFilesPath = target / GRUPDATER_DEFAULT_DYNAMIC_FILE;
-    if (std::filesystem::exists(dynamicFilesPath) && std::filesystem::is_regular_file(dynamicFilesPath))
-    {
-        std::ifstream dynamicFile(dynamicFilesPath);
-        if (!dynamicFile.is_open())
-        {
-            std::cerr << "Failed to open dynamic files json\n";
-            return false;
-        }
+CancelScope* CancelScope::current()
+{
+    return gCancelScope;
+}
+bool CancelScope::isCancelled()
+{
+    return gCancelScope != nullptr && gCancelScope->_g_token.stop_requested();
+}
+std::stop_token const& CancelScope::getToken() const
+{
+    return this->_g_token;
+}
 
-        try
-        {
-            nlohmann::json dynamicFilesJson = nlohmann::json::parse(dynamicFile);
-            dynamicFile.close();
+//ProgressScope
 
-            for (auto& dynamicFileJson : dynamicFilesJson["files"])
-            {
-                dynamicFiles.emplace_back(dynamicFileJson.get<std::filesystem::path>());
-            }
-        }
-        catch (const nlohmann::json::parse_error& e)
-        {
-            dynamicFile.close();
-            std::cerr << "Failed to parse dynamicFiles.json: " << e.what() << '\n';
-            return false;
-        }
+const char* ToString(ProgressPhase phase)
+{
+    switch (phase)
+    {
+    case ProgressPhase::Download:
+        return "download";
+    case ProgressPhase::Extract:
+        return "extract";
+    default:
+        return "unknown";
     }
+}
 
-    //Remove all files that are not in dynamicFiles and avoid removing the temporary folder
-    std::filesystem::recursive_directory_iterator itTarget(target);
-    for (auto& file : itTarget)
-    {
-        if (!file.is_regular_file())
-        {
-            continue;
-        }
+ProgressScope::ProgressScope(ProgressObserver observer, std::chrono::milliseconds interval) :
+        _g_observer(std::move(observer)),
+        _g_interval(interval),
+        _g_previous(std::exchange(gProgressScope, this))
+{}
+ProgressScope::~ProgressScope()
+{
+    gProgressScope = this->_g_previous;
+}
 
-        if (IsSubDirectory(std::filesystem::relative(file.path(), target), temporaryPath))
-        {
-            continue;
-        }
+ProgressScope* ProgressScope::current()
+{
+    return gProgressScope;
+}
 
-        if (std::ranges::find(dynamicFiles, std::filesystem::relative(file.path(), target)) == dynamicFiles.end())
-        {
-            std::cout << "Removing file: " << file << '\n';
-            std::filesystem::remove(file);
-        }
+void ProgressScope::start(ProgressPhase phase, std::optional<uint64_t> bytesTotal, uint64_t entryCount)
+{
+    this->_g_progress = Progress{};
+    this->_g_progress._phase = phase;
+    this->_g_progress._bytesTotal = bytesTotal;
+    this->_g_progress._entryCount = entryCount;
+    this->_g_lastBytes = 0;
+    this->_g_started = true;
+    this->report(std::chrono::steady_clock::now());
+}
+void ProgressScope::setTotal(uint64_t bytesTotal)
+{
+    this->_g_progress._bytesTotal = bytesTotal;
+}
+void ProgressScope::update(uint64_t bytesDone, uint64_t entryIndex)
+{
+    if (!this->_g_started)
+    {
+        return;
     }
+    this->_g_progress._bytesDone = bytesDone;
+    this->_g_progress._entryIndex = entryIndex;
 
-    //Take all files from the extracted asset (root) and copy them to the target directory
-    std::filesystem::path currentPath = "./";
-    std::filesystem::recursive_directory_iterator itAsset(currentPath);
-    for (auto& file : itAsset)
+    auto const now = std::chrono::steady_clock::now();
+    if (now - this->_g_lastTime >= this->_g_interval)
     {
-        if (!itAsset->is_regular_file())
-        {
-            continue;
-        }
-
-        auto resultFilePath = target / std::filesystem::relative(file.path(), currentPath);
-        std::filesystem::create_directories(resultFilePath.parent_path());
-        std::cout << "Copy file: " << file << " to " << resultFilePath << '\n';
-        std::filesystem::copy(file, resultFilePath);
+        this->report(now);
     }
-
-    if (!callerExecutable.empty())
+}
+void ProgressScope::finish(bool success)
+{
+    if (!this->_g_started)
     {
-        std::cout << "Successfully applied update, you can now restart the application !\n";
-        std::this_thread::sleep_for(std::chrono::seconds{2});
-
-        std::cout << "Caller executable: " << callerExecutable << '\n';
-        //Launch the caller executable
-        std::wstring callerExecutableW = callerExecutable.wstring();
-        STARTUPINFOW si{};
-        si.cb = sizeof(si);
-        PROCESS_INFORMATION pi{};
-        if (!CreateProcessW(callerExecutableW.c_str(), nullptr,
-            nullptr, nullptr, FALSE,
-            CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS, nullptr,
-            callerExecutable.parent_path().wstring().c_str(), &si, &pi))
-        {
-            std::cerr << "Failed to create process\n";
-            return true; //Return true because the update was successful
-        }
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
+        return;
     }
-
-    return true;
+    this->_g_started = false;
+    this->_g_progress._finished = true;
+    if (success && !this->_g_progress._bytesTotal)
+    {
+        this->_g_progress._bytesTotal = this->_g_progress._bytesDone;
+    }
+    this->report(std::chrono::steady_clock::now());
 }
 
-bool RequestApplyUpdate(std::filesystem::path const &rootAssetPath, std::filesystem::path const& callerExecutable)
+void ProgressScope::report(std::chrono::steady_clock::time_point now)
 {
-    if (rootAssetPath.empty() || !std::filesystem::exists(rootAssetPath) || !std::filesystem::is_directory(rootAssetPath))
+    auto& progress = this->_g_progress;
+    std::chrono::duration<double> const elapsed = now - this->_g_lastTime;
+    //The first report of a phase has no rate
+    if (progress._bytesDone > 0 && elapsed.count() > 0 && progress._bytesDone >= this->_g_lastBytes)
     {
-        std::cerr << "Invalid root asset path\n";
-        return false;
+        progress._bytesPerSecond = static_cast<double>(progress._bytesDone - this->_g_lastBytes) / elapsed.count();
+    }
+    progress._eta.reset();
+    if (progress._bytesTotal && progress._bytesPerSecond > 0 && *progress._bytesTotal >= progress._bytesDone)
+    {
+        auto const remaining = static_cast<double>(*progress._bytesTotal - progress._bytesDone);
+        progress._eta = std::chrono::seconds{static_cast<int64_t>(std::ceil(remaining / progress._bytesPerSecond))};
     }
+    this->_g_lastTime = now;
+    this->_g_lastBytes = progress._bytesDone;
 
-    //GRUpdater executable (from the extracted assets) should be in the same directory as the root asset
-    auto updaterPath = rootAssetPath / GRUPDATER_EXECUTABLE_NAME;
-    if (!std::filesystem::exists(updaterPath) || !std::filesystem::is_regular_file(updaterPath))
+    if (this->_g_observer)
     {
-        std::cerr << "Invalid updater path\n";
-        return false;
+        this->_g_observer(progress);
     }
+}
 
-    //Get the caller process id
-    auto callerPid = GetCurrentProcessId();
+//Executor
 
-    //Launch the updater executable
-    std::wstring updaterPathW = updaterPath.wstring();
-    std::wstring commandLine = GRUPDATER_EXECUTABLE_NAME_W L" apply --target \""
-            + std::filesystem::current_path().wstring()
-            + L"\" --pid " + std::to_wstring(callerPid)
-            + L" --caller \"" + callerExecutable.wstring() + L'\"';
+Executor::~Executor()
+{
+    {
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_stopped = true;
+    }
+    this->_g_condition.notify_all();
+    for (auto& thread : this->_g_threads)
+    {
+        thread.join();
+    }
+}
 
-    std::wcout << "Command line: " << commandLine << '\n';
-    std::wcout << "Updater path: " << updaterPathW << '\n';
+Executor& Executor::get()
+{
+    static Executor executor;
+    return executor;
+}
 
-    STARTUPINFOW si{};
-    si.cb = sizeof(si);
-    PROCESS_INFORMATION pi{};
-    if (!CreateProcessW(updaterPathW.c_str(), commandLine.data(),
-        nullptr, nullptr, FALSE,
-        CREATE_NEW_PROCESS_GROUP | CREATE_NEW_CONSOLE, nullptr,
-        rootAssetPath.wstring().c_str(), &si, &pi))
+void Executor::post(std::function<void()> job)
+{
     {
-        std::cerr << "Failed to create process\n";
-        return false;
+        std::scoped_lock const lock(this->_g_mutex);
+        this->_g_jobs.push_back(std::move(job));
+        if (this->_g_threads.size() < GRUPDATER_EXECUTOR_THREADS)
+        {
+            this->_g_threads.emplace_back([this] { this->loop(); });
+        }
+    }
+    this->_g_condition.notify_one();
+}
+void Executor::loop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(this->_g_mutex);
+            this->_g_condition.wait(lock, [this] { return this->_g_stopped || !this->_g_jobs.empty(); });
+            if (this->_g_jobs.empty())
+            {
+                return;
+            }
+            job = std::move(this->_g_jobs.front());
+            this->_g_jobs.pop_front();
+        }
+        try
+        {
+            job();
+        }
+        catch (std::exception const& exception)
+        {
+            Log(LogLevel::Error) << "Executor job failed: " << exception.what();
+        }
+        catch (...)
+        {
+            Log(LogLevel::Error) << "Executor job failed";
+        }
     }
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    return true;
 }
 
+//MakeAvailable
+
 std::optional<std::filesystem::path> MakeAvailable(Tag const& currentTag,
                                                    std::string const& owner,
                                                    std::string const& repo,
                                                    std::filesystem::path const& tempDir,
-                                                   bool allowPrerelease)
+                                                   bool allowPrerelease,
+                                                   std::vector<std::string> const& mirrors,
+                                                   UpdateMetrics* metrics)
 {
     //Verify schedule time in order to avoid spamming GitHub API requests
-    auto scheduleTime = GetScheduleTime();
-    if (scheduleTime && !VerifyScheduleTime(*scheduleTime))
+    auto scheduleState = GetScheduleState();
+    if (scheduleState && std::chrono::system_clock::now() < GetNextScheduleTime(*scheduleState))
     {
-        std::cerr << "Schedule time not reached yet\n";
+        Log(LogLevel::Error) << "Schedule time not reached yet";
         return std::nullopt;
     }
     if (!SetScheduleTime())
     {
-        std::cerr << "Failed to set schedule time (will continue anyway)\n";
+        Log(LogLevel::Warning) << "Failed to set schedule time (will continue anyway)";
     }
 
-    auto context = RetrieveContext(owner, repo, allowPrerelease);
+    std::optional<RepoContext> context;
+    {
+        MetricsScope scope{metrics, "retrieve"};
+        context = RetrieveContext(owner, repo, allowPrerelease, mirrors);
+        scope.setSuccess(context.has_value());
+    }
     if (!context)
     {
-        std::cerr << "Failed to retrieve context\n";
+        Log(LogLevel::Error) << (CancelScope::isCancelled() ? "Update cancelled" : "Failed to retrieve context");
         return std::nullopt;
     }
-    std::cout << "Context retrieved :\n";
-    std::cout << "\tOwner: " << context->_owner << '\n';
-    std::cout << "\tRepo: " << context->_repo << '\n';
-    std::cout << "\tAsset: " << context->_asset << '\n';
-    std::cout << "\tAsset URL: " << context->_assetUrl << '\n';
-    std::cout << "\tLatest Tag: " << context->_latestTag.major << '.' << context->_latestTag.minor << '.' << context->_latestTag.patch << '\n';
+    Log(LogLevel::Info) << "Context retrieved :";
+    Log(LogLevel::Info) << "\tOwner: " << context->_owner;
+    Log(LogLevel::Info) << "\tRepo: " << context->_repo;
+    Log(LogLevel::Info) << "\tAsset: " << context->_asset;
+    Log(LogLevel::Info) << "\tAsset URL: " << context->_assetUrl;
+    Log(LogLevel::Info) << "\tLatest Tag: " << ToString(context->_latestTag);
 
     if (VerifyTag(*context, currentTag) != TagStatus::NewerTag)
     {
-        std::cerr << "No newer tag available\n";
+        Log(LogLevel::Error) << "No newer tag available";
+        return std::nullopt;
+    }
+    Log(LogLevel::Info) << "Newer tag available";
+
+    auto const rolloutWindow = scheduleState ? scheduleState->_rolloutWindow : std::chrono::hours{GRUPDATER_DEFAULT_ROLLOUT_WINDOW_HOURS};
+    if (!VerifyRolloutTime(*context, rolloutWindow))
+    {
+        Log(LogLevel::Error) << "Rollout time of this machine not reached yet";
         return std::nullopt;
     }
-    std::cout << "Newer tag available\n";
 
-    auto zipFile = DownloadAsset(*context, tempDir);
+    std::optional<std::filesystem::path> zipFile;
+    {
+        MetricsScope scope{metrics, "download"};
+        zipFile = DownloadAsset(*context, tempDir, mirrors);
+        scope.setSuccess(zipFile.has_value());
+    }
     if (!zipFile)
     {
-        std::cerr << "Failed to download asset\n";
+        Log(LogLevel::Error) << (CancelScope::isCancelled() ? "Update cancelled" : "Failed to download asset");
         return std::nullopt;
     }
 
-    std::cout << "Asset downloaded to " << *zipFile << '\n';
+    Log(LogLevel::Info) << "Asset downloaded to " << *zipFile;
+    if (CancelScope::isCancelled())
+    {
+        Log(LogLevel::Error) << "Update cancelled";
+        return std::nullopt;
+    }
 
-    auto extractRoot = ExtractAsset(*zipFile);
+    std::optional<std::filesystem::path> extractRoot;
+    {
+        MetricsScope scope{metrics, "extract"};
+        extractRoot = ExtractAsset(*zipFile);
+        scope.setSuccess(extractRoot.has_value());
+    }
     if (!extractRoot)
     {
-        std::cerr << "Failed to extract asset\n";
+        Log(LogLevel::Error) << (CancelScope::isCancelled() ? "Update cancelled" : "Failed to extract asset");
         return std::nullopt;
     }
 
-    std::cout << "Asset extracted to " << *extractRoot << '\n';
+    Log(LogLevel::Info) << "Asset extracted to " << *extractRoot;
     return extractRoot;
 }
+Async<std::optional<std::filesystem::path>> MakeAvailableAsync(Tag const& currentTag,
+                                                               std::string owner,
+                                                               std::string repo,
+                                                               std::filesystem::path tempDir,
+                                                               bool allowPrerelease,
+                                                               std::vector<std::string> mirrors,
+                                                               std::stop_token stopToken,
+                                                               ProgressObserver progress,
+                                                               UpdateMetrics* metrics)
+{
+    return Async<std::optional<std::filesystem::path>>{[=, owner = std::move(owner), repo = std::move(repo), tempDir = std::move(tempDir),
+                                                        mirrors = std::move(mirrors), stopToken = std::move(stopToken),
+                                                        progress = std::move(progress)] {
+        CancelScope const cancelScope{stopToken};
+        std::optional<ProgressScope> progressScope;
+        if (progress)
+        {
+            progressScope.emplace(progress);
+        }
+        return MakeAvailable(currentTag, owner, repo, tempDir, allowPrerelease, mirrors, metrics);
+    }};
+}
 
 }//namespace updater
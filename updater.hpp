@@ -1,10 +1,29 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
+#include <array>
+#include <algorithm>
+#include <compare>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <filesystem>
 #include <chrono>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <sstream>
+#include <deque>
+#include <coroutine>
+#include <future>
+#include <exception>
+#include <stop_token>
 
 #ifndef _WIN32
     #define UPDATER_API
@@ -24,8 +43,28 @@
 #define GRUPDATER_TAG_STR "v" GRUPDATER_TOSTRING(GRUPDATER_TAG_MAJOR) "." GRUPDATER_TOSTRING(GRUPDATER_TAG_MINOR) "." GRUPDATER_TOSTRING(GRUPDATER_TAG_PATCH)
 #define GRUPDATER_TAG updater::Tag{GRUPDATER_TAG_MAJOR, GRUPDATER_TAG_MINOR, GRUPDATER_TAG_PATCH}
 
+//Maximum size (with the null terminator) of the prerelease and build labels of a Tag
+#define GRUPDATER_TAG_LABEL_SIZE 32
+//Size of the packed precedence key of a Tag (enough for any label of GRUPDATER_TAG_LABEL_SIZE)
+#define GRUPDATER_TAG_KEY_SIZE 64
+
 #define GRUPDATER_DEFAULT_SCHEDULE_FILE "./schedule.json"
 #define GRUPDATER_DEFAULT_SCHEDULE_DELAY_HOURS 2
+//Part of the GitHub API rate limit that is never used by the scheduler
+#define GRUPDATER_RATE_LIMIT_RESERVE_PERCENT 10
+//Estimated number of API requests done by one check of a repository
+#define GRUPDATER_REQUESTS_PER_CHECK 1
+//A tracked repository not checked for this long stops sharing the rate limit (e.g. a removed daemon watch)
+#define GRUPDATER_SCHEDULE_REPO_EXPIRY_HOURS 72
+//Every machine delay its checks by a deterministic part of this window (derived from the machine id)
+#define GRUPDATER_DEFAULT_SCHEDULE_SPLAY_MINUTES 30
+//Every machine delay the download of a new release by a deterministic part of this window (0 to disable)
+#define GRUPDATER_DEFAULT_ROLLOUT_WINDOW_HOURS 0
+//Adaptive schedule: number of recent release times kept and number of checks between two releases
+#define GRUPDATER_ADAPTIVE_RELEASE_HISTORY 8
+#define GRUPDATER_ADAPTIVE_CHECKS_PER_RELEASE 4
+#define GRUPDATER_ADAPTIVE_MIN_DELAY_MINUTES 30
+#define GRUPDATER_ADAPTIVE_MAX_DELAY_HOURS 48
 
 #define GRUPDATER_WAIT_PID_TIMEOUT_MS 5000
 
@@ -33,17 +72,252 @@
 #define GRUPDATER_EXECUTABLE_NAME_W L"GRUpdaterCmd.exe"
 #define GRUPDATER_DLL_NAME "libGRUpdater_d.dll"
 #define GRUPDATER_DLL_NAME_W L"libGRUpdater_d.dll"
+//Lean apply-only executable (no TLS, zip, JSON nor GRUpdater library), see ApplyMode::Lean
+#define GRUPDATER_APPLY_EXECUTABLE_NAME "GRUpdaterApply.exe"
+#define GRUPDATER_APPLY_EXECUTABLE_NAME_W L"GRUpdaterApply.exe"
 
 #define GRUPDATER_DEFAULT_DYNAMIC_FILE "./dynamicFiles.json"
 
+#define GRUPDATER_DEFAULT_RELEASE_INDEX_FILE "./releases.json"
+#define GRUPDATER_RELEASES_PER_PAGE 100
+//Release index caches of the batch checks, one file per repository
+#define GRUPDATER_DEFAULT_RELEASE_INDEX_DIRECTORY "./releases/"
+#define GRUPDATER_DEFAULT_MAX_CONNECTIONS 8
+//Idle keep-alive connections kept by base URL in a ClientPool
+#define GRUPDATER_DEFAULT_MAX_IDLE_CONNECTIONS 4
+//Size of the reusable I/O buffers of a Session
+#define GRUPDATER_SESSION_BUFFER_SIZE (256 * 1024)
+
+//Streaming .tar.zst extraction (built with UPDATER_ZSTD): decompressed blocks queued ahead of the writes
+//and largest accepted zstd window, the memory is bounded by their product plus the window
+#define GRUPDATER_ZSTD_BLOCK_SIZE (256 * 1024)
+#define GRUPDATER_ZSTD_QUEUE_BLOCKS 8
+#define GRUPDATER_ZSTD_WINDOW_LOG_MAX 27
+//Largest GNU long name or pax header accepted in a .tar.zst asset
+#define GRUPDATER_TAR_MAX_HEADER_SIZE (64 * 1024)
+
+//Peer cache server (serve mode)
+#define GRUPDATER_DEFAULT_PEER_CACHE_DIRECTORY "./cache/"
+#define GRUPDATER_DEFAULT_PEER_PORT 8080
+#define GRUPDATER_DEFAULT_PEER_REFRESH_MINUTES 5
+
+//Mirror selection, the origins are the GitHub hosts used when no mirror is configured
+#define GRUPDATER_ORIGIN_API "https://api.github.com"
+#define GRUPDATER_ORIGIN_DOWNLOAD "https://github.com"
+#define GRUPDATER_MIRROR_EWMA_WEIGHT 0.3
+//Time to first byte recorded for a failed request
+#define GRUPDATER_MIRROR_FAILURE_PENALTY_MS 10000
+//Delay before the hedged request when the first candidate has no measure yet
+#define GRUPDATER_MIRROR_DEFAULT_HEDGE_DELAY_MS 500
+#define GRUPDATER_MIRROR_MIN_HEDGE_DELAY_MS 20
+
+//Download bandwidth limiter (token bucket), a rate of 0 is unlimited
+#define GRUPDATER_DEFAULT_BANDWIDTH_BURST (256 * 1024)
+//Longest wait before a waiting download checks the limit again (runtime changes, profiles)
+#define GRUPDATER_BANDWIDTH_MAX_WAIT_MS 100
+
+//Messages queued per thread by the logger before the caller waits for the sink
+#define GRUPDATER_LOG_QUEUE_SIZE 1024
+
+//Shortest delay between two progress reports (the first and the last are always reported)
+#define GRUPDATER_PROGRESS_INTERVAL_MS 100
+
+//Threads of the Executor running the asynchronous API
+#define GRUPDATER_EXECUTOR_THREADS 2
+
+//Spans kept per thread by the tracer, the oldest are overwritten
+#define GRUPDATER_TRACE_RING_SIZE 4096
+
+namespace httplib
+{
+class Client;
+class Server;
+}//namespace httplib
+
 namespace updater
 {
 
+enum class LogLevel : uint8_t
+{
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+[[nodiscard]] UPDATER_API const char* ToString(LogLevel level);
+[[nodiscard]] UPDATER_API std::optional<LogLevel> ParseLogLevel(std::string_view level);
+
+/*
+ * Logger:
+ * Asynchronous leveled logger. Every thread pushes its messages into its own lock-free queue
+ * (single producer, single consumer), a background thread writes them to the sink in their global order.
+ * A message below the level costs an atomic load. The default sink is the console at the Info level.
+ */
+class UPDATER_API Logger
+{
+public:
+    using Sink = std::function<void(LogLevel level, std::string_view message)>;
+
+    [[nodiscard]] static Logger& get();
+
+    //Debug and Info to stdout, Warning and Error to stderr
+    [[nodiscard]] static Sink consoleSink();
+    //Append "time [level] message" lines to the file, nullptr if it can't be opened
+    [[nodiscard]] static Sink fileSink(std::filesystem::path const& logFile);
+
+    Logger(Logger const&) = delete;
+    Logger& operator=(Logger const&) = delete;
+
+    void setLevel(LogLevel level);
+    [[nodiscard]] bool isEnabled(LogLevel level) const
+    {
+        return level >= this->_g_level.load(std::memory_order_relaxed) && level != LogLevel::Off;
+    }
+    void setSink(Sink sink);
+
+    void log(LogLevel level, std::string message);
+    //Wait until the messages logged so far are written
+    void flush();
+
+private:
+    struct Queue;
+
+    Logger();
+    ~Logger();
+
+    [[nodiscard]] Queue& getQueue();
+    //Write the queued messages, return the count written
+    std::size_t drain();
+    void run();
+
+    std::atomic<LogLevel> _g_level{LogLevel::Info};
+    std::mutex _g_sinkMutex;
+    Sink _g_sink;
+    std::mutex _g_queuesMutex;
+    std::vector<std::shared_ptr<Queue>> _g_queues;
+    std::atomic<uint64_t> _g_sequence{0};
+    std::atomic<uint64_t> _g_pushed{0};
+    std::atomic<uint64_t> _g_written{0};
+    std::atomic_bool _g_running{true};
+    std::thread _g_thread;
+};
+
+/*
+ * LogStream:
+ * Build a message with operator<< and log it at the end of the statement,
+ * nothing is formatted when the level is disabled, e.g. Log(LogLevel::Debug) << "Copy file: " << path;
+ */
+class UPDATER_API LogStream
+{
+public:
+    explicit LogStream(LogLevel level);
+    ~LogStream();
+
+    LogStream(LogStream const&) = delete;
+    LogStream& operator=(LogStream const&) = delete;
+
+    template<class T>
+    LogStream& operator<<(T const& value)
+    {
+        if (this->_g_stream)
+        {
+            *this->_g_stream << value;
+        }
+        return *this;
+    }
+
+private:
+    LogLevel _g_level;
+    std::unique_ptr<std::ostringstream> _g_stream;
+};
+[[nodiscard]] inline LogStream Log(LogLevel level)
+{
+    return LogStream{level};
+}
+
+/*
+ * TagKey:
+ * Packed, precomputed precedence key of a Tag following the SemVer 2.0 ordering rules.
+ * Two keys are compared with a single memcmp, build metadata is not part of the key.
+ *
+ * Layout:
+ * - major, minor, patch as big endian 32 bits integers
+ * - 0x01 if the tag has a prerelease, 0x02 if it's a release (a release is always greater)
+ * - for every prerelease identifier:
+ *   - numeric: 0x01, length, digits (numeric identifiers have no leading zeros)
+ *   - alphanumeric: 0x02, characters, 0x00
+ * - 0x00 padding (also acting as the end marker, fewer identifiers are lower)
+ */
+struct TagKey
+{
+    std::array<uint8_t, GRUPDATER_TAG_KEY_SIZE> _data{};
+
+    [[nodiscard]] constexpr std::strong_ordering operator<=>(TagKey const& right) const
+    {
+        if (std::is_constant_evaluated())
+        {
+            return std::lexicographical_compare_three_way(this->_data.begin(), this->_data.end(),
+                                                          right._data.begin(), right._data.end());
+        }
+        return std::memcmp(this->_data.data(), right._data.data(), this->_data.size()) <=> 0;
+    }
+    [[nodiscard]] constexpr bool operator==(TagKey const& right) const
+    {
+        return (*this <=> right) == 0;
+    }
+};
+
 struct Tag
 {
     uint32_t major;
     uint32_t minor;
     uint32_t patch;
+    //Dot separated prerelease identifiers (without the leading '-'), null terminated
+    std::array<char, GRUPDATER_TAG_LABEL_SIZE> prerelease{};
+    //Dot separated build metadata (without the leading '+'), null terminated, ignored for precedence
+    std::array<char, GRUPDATER_TAG_LABEL_SIZE> build{};
+
+    [[nodiscard]] constexpr bool isPrerelease() const
+    {
+        return this->prerelease[0] != '\0';
+    }
+    [[nodiscard]] constexpr std::string_view getPrerelease() const
+    {
+        return {this->prerelease.data(), static_cast<std::size_t>(std::ranges::find(this->prerelease, '\0') - this->prerelease.begin())};
+    }
+    [[nodiscard]] constexpr std::string_view getBuild() const
+    {
+        return {this->build.data(), static_cast<std::size_t>(std::ranges::find(this->build, '\0') - this->build.begin())};
+    }
+
+    [[nodiscard]] constexpr TagKey key() const;
+
+    //The numbers are compared first, the keys are only built for two prereleases of the same version
+    [[nodiscard]] friend constexpr std::strong_ordering operator<=>(Tag const& left, Tag const& right)
+    {
+        if (auto const order = left.major <=> right.major; order != 0)
+        {
+            return order;
+        }
+        if (auto const order = left.minor <=> right.minor; order != 0)
+        {
+            return order;
+        }
+        if (auto const order = left.patch <=> right.patch; order != 0)
+        {
+            return order;
+        }
+        if (!left.isPrerelease() || !right.isPrerelease())
+        {//A release is greater than its prereleases
+            return right.isPrerelease() <=> left.isPrerelease();
+        }
+        return left.key() <=> right.key();
+    }
+    [[nodiscard]] friend constexpr bool operator==(Tag const& left, Tag const& right)
+    {
+        return (left <=> right) == 0;
+    }
 };
 enum class TagStatus
 {
@@ -51,8 +325,8 @@ enum class TagStatus
     NewerTag,
     OlderTag
 };
-const char* ToString(TagStatus status);
-std::optional<TagStatus> FromString(std::string const& status);
+[[nodiscard]] UPDATER_API const char* ToString(TagStatus status);
+[[nodiscard]] UPDATER_API std::optional<TagStatus> FromString(std::string const& status);
 struct RepoContext
 {
     std::string _owner;
@@ -60,24 +334,1057 @@ struct RepoContext
     std::string _asset;
     std::string _assetUrl;
     Tag _latestTag;
+    std::optional<std::chrono::system_clock::time_point> _publishedAt;
+};
+
+/*
+ * TagRange:
+ * Half open range of tags [_lower, _upper) on the packed precedence keys.
+ */
+struct TagRange
+{
+    TagKey _lower;
+    TagKey _upper;
+
+    [[nodiscard]] constexpr bool contains(TagKey const& key) const
+    {
+        return key >= this->_lower && key < this->_upper;
+    }
+};
+
+/*
+ * ParseTagRange:
+ * Supported syntax:
+ * - "*" : any tag
+ * - "1.4.2" or "v1.4.2" : exactly this tag
+ * - "^1.4" or "^1.4.2" : compatible tags (same major, or same minor for 0.x)
+ * - "~1.4" or "~1.4.2" : same major and minor
+ * Prerelease tags of the lower bound are not included, as for the usual SemVer ranges.
+ */
+[[nodiscard]] UPDATER_API std::optional<TagRange> ParseTagRange(std::string_view range);
+
+/*
+ * RateLimitState:
+ * Last known GitHub API rate limit, from the X-RateLimit-Limit, X-RateLimit-Remaining,
+ * X-RateLimit-Reset and Retry-After response headers.
+ */
+struct RateLimitState
+{
+    std::optional<uint32_t> _limit;
+    std::optional<uint32_t> _remaining;
+    std::optional<std::chrono::system_clock::time_point> _reset;
+    std::optional<std::chrono::system_clock::time_point> _retryAfter;
+};
+
+/*
+ * Origins:
+ * Base URLs of the GitHub API and of the release downloads, replaceable by a GitHub Enterprise instance
+ * or a MockGitHubServer. An absolute asset URL is downloaded from its own host.
+ * The mirror measures of the origins are recorded under these URLs.
+ */
+struct Origins
+{
+    std::string _api{GRUPDATER_ORIGIN_API};
+    std::string _download{GRUPDATER_ORIGIN_DOWNLOAD};
+};
+UPDATER_API void SetOrigins(Origins origins);
+[[nodiscard]] UPDATER_API Origins GetOrigins();
+
+/*
+ * MirrorStats:
+ * Exponentially weighted moving averages of the measures of a mirror (or origin), saved in the schedule file.
+ * A failure counts as a GRUPDATER_MIRROR_FAILURE_PENALTY_MS time to first byte and a null throughput,
+ * so a failing mirror moves down the ranking and comes back once it works again.
+ */
+struct MirrorStats
+{
+    std::optional<double> _ttfb;       //Milliseconds
+    std::optional<double> _throughput; //Bytes per second
+};
+
+/*
+ * MirrorSelector:
+ * Rank the configured mirrors and the origin, thread-safe so it can be shared by concurrent requests.
+ * - metadata calls use rankByLatency (the top two are raced with a hedged request)
+ * - bulk downloads use rankByThroughput (the next candidates are the failover, resuming at the current offset)
+ * Candidates without measures are ranked first (in the configured order) so they get measured,
+ * except the origin which is ranked last until it is measured.
+ */
+class UPDATER_API MirrorSelector
+{
+public:
+    explicit MirrorSelector(std::vector<std::string> mirrors, std::map<std::string, MirrorStats> stats = {});
+
+    [[nodiscard]] std::vector<std::string> const& getMirrors() const;
+    [[nodiscard]] std::vector<std::string> rankByLatency(std::string const& origin) const;
+    [[nodiscard]] std::vector<std::string> rankByThroughput(std::string const& origin) const;
+    //Delay before racing the next candidate, twice the usual time to first byte of this one
+    [[nodiscard]] std::chrono::milliseconds getHedgeDelay(std::string const& candidate) const;
+
+    void recordTimeToFirstByte(std::string const& candidate, std::chrono::milliseconds ttfb);
+    void recordThroughput(std::string const& candidate, double bytesPerSecond);
+    void recordFailure(std::string const& candidate);
+
+    [[nodiscard]] std::map<std::string, MirrorStats> getStats() const;
+
+private:
+    template<class TScore>
+    [[nodiscard]] std::vector<std::string> rank(std::string const& origin, TScore const& score) const;
+
+    std::vector<std::string> _g_mirrors;
+    std::map<std::string, MirrorStats> _g_stats;
+    mutable std::mutex _g_mutex;
+};
+
+/*
+ * BandwidthProfile:
+ * Rate applied between two local times of the day, parsed from "HH:MM-HH:MM=rate" with the rate in bytes per second
+ * and an optional K, M or G suffix (powers of 1024), e.g. "08:00-18:00=512K". The end can be past midnight ("22:00-06:00=0").
+ */
+struct BandwidthProfile
+{
+    std::chrono::minutes _begin;
+    std::chrono::minutes _end;
+    uint64_t _bytesPerSecond;
+};
+[[nodiscard]] UPDATER_API std::optional<BandwidthProfile> ParseBandwidthProfile(std::string_view profile);
+
+/*
+ * BandwidthLimiter:
+ * Token bucket on the download receive path, every download of the process shares the one of GetBandwidthLimiter().
+ * The rate is the one of the first profile matching the local time, or the default one (0 is unlimited).
+ * The limit can be changed at any time from another thread, the waiting downloads follow the new rate.
+ */
+class UPDATER_API BandwidthLimiter
+{
+public:
+    explicit BandwidthLimiter(uint64_t bytesPerSecond = 0, uint64_t burst = GRUPDATER_DEFAULT_BANDWIDTH_BURST);
+
+    void setLimit(uint64_t bytesPerSecond, uint64_t burst = GRUPDATER_DEFAULT_BANDWIDTH_BURST);
+    void setProfiles(std::vector<BandwidthProfile> profiles);
+    //Rate in use now (bytes per second)
+    [[nodiscard]] uint64_t getLimit() const;
+    //Wait until size bytes are allowed, return the time spent waiting
+    std::chrono::steady_clock::duration acquire(std::size_t size);
+
+private:
+    //The mutex must be locked
+    [[nodiscard]] uint64_t getRate() const;
+
+    mutable std::mutex _g_mutex;
+    std::condition_variable _g_condition;
+    uint64_t _g_bytesPerSecond;
+    uint64_t _g_burst;
+    std::vector<BandwidthProfile> _g_profiles;
+    double _g_tokens;
+    std::chrono::steady_clock::time_point _g_lastRefill;
+};
+[[nodiscard]] UPDATER_API BandwidthLimiter& GetBandwidthLimiter();
+
+struct ReleaseEntry
+{
+    TagKey _key;
+    Tag _tag;
+    uint64_t _id;
+    bool _prerelease;
+    std::string _asset;    //Empty if the release don't have a compatible asset
+    std::string _assetUrl;
+    std::optional<std::chrono::system_clock::time_point> _publishedAt;
+};
+
+using HttpHeaders = std::vector<std::pair<std::string, std::string>>;
+
+/*
+ * HttpRequest:
+ * GET sent by a Transport to _baseUrl (scheme://host[:port]) + _path.
+ */
+struct HttpRequest
+{
+    std::string _baseUrl;
+    std::string _path;
+    HttpHeaders _headers;
+    std::optional<uint64_t> _rangeFrom;                     //Range: bytes=N- (answered by a 206 or a whole 200)
+    bool _followRedirects{false};                           //A 304 is then taken for a redirect
+    std::optional<std::chrono::seconds> _connectionTimeout; //Default of the transport if empty
+    std::stop_token _stopToken;                             //Aborts the connection or the transfer
+};
+
+/*
+ * HttpResponse:
+ * Status and headers of an answer, the body is only kept when the request has no data handler.
+ */
+struct UPDATER_API HttpResponse
+{
+    int _status{0};
+    HttpHeaders _headers;
+    std::string _body;
+
+    //Case insensitive, empty if missing
+    [[nodiscard]] std::string getHeader(std::string_view key) const;
+    [[nodiscard]] bool hasHeader(std::string_view key) const;
+};
+//Called once the status and headers are received (after the redirects), false aborts the request
+using HttpResponseHandler = std::function<bool(HttpResponse const&)>;
+//Called for each body chunk, false aborts the request
+using HttpDataHandler = std::function<bool(char const* data, std::size_t size)>;
+
+/*
+ * Transport:
+ * HTTP stack of the release checks and downloads (httplib by default, see HttplibTransport), e.g. a proxy,
+ * an HTTP/2 client or an in-memory transport for the benchmarks.
+ * get() is called concurrently from many threads and returns nullopt when no answer was received
+ * (connection failure, aborted by a handler or by the stop token).
+ */
+class UPDATER_API Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    [[nodiscard]] virtual std::optional<HttpResponse> get(HttpRequest const& request,
+                                                          HttpResponseHandler const& onResponse = {},
+                                                          HttpDataHandler const& onData = {}) = 0;
+};
+//Transport of the sessions and release indexes without their own one, nullptr restores httplib
+UPDATER_API void SetTransport(std::shared_ptr<Transport> transport);
+[[nodiscard]] UPDATER_API std::shared_ptr<Transport> GetTransport();
+
+/*
+ * ClientPool:
+ * Keep-alive HTTP clients by base URL. A leased client is only used by its holder and goes back to the pool
+ * with its open connection (and its settings) when the last copy is released, at most maxIdle are kept by base URL.
+ */
+class UPDATER_API ClientPool : public std::enable_shared_from_this<ClientPool>
+{
+public:
+    //Only usable through a shared_ptr (std::make_shared)
+    explicit ClientPool(std::size_t maxIdle = GRUPDATER_DEFAULT_MAX_IDLE_CONNECTIONS);
+    ~ClientPool();
+
+    ClientPool(ClientPool const&) = delete;
+    ClientPool& operator=(ClientPool const&) = delete;
+
+    [[nodiscard]] std::shared_ptr<httplib::Client> acquire(std::string const& baseUrl);
+    [[nodiscard]] std::size_t getIdleCount() const;
+    //Close the idle connections
+    void clear();
+
+private:
+    void release(std::string const& baseUrl, httplib::Client* client);
+
+    std::size_t _g_maxIdle;
+    mutable std::mutex _g_mutex;
+    std::map<std::string, std::vector<std::unique_ptr<httplib::Client>>> _g_idle;
+};
+
+/*
+ * HttplibTransport:
+ * Default Transport, the requests lease keep-alive clients from pool and add their connection timings
+ * to the MetricsScope of the calling thread.
+ */
+class UPDATER_API HttplibTransport : public Transport
+{
+public:
+    explicit HttplibTransport(std::shared_ptr<ClientPool> pool = std::make_shared<ClientPool>());
+
+    [[nodiscard]] std::optional<HttpResponse> get(HttpRequest const& request,
+                                                  HttpResponseHandler const& onResponse = {},
+                                                  HttpDataHandler const& onData = {}) override;
+
+    [[nodiscard]] ClientPool& getClientPool();
+
+private:
+    std::shared_ptr<ClientPool> _g_pool;
+};
+
+/*
+ * ReleaseIndex:
+ * Local cache of the releases of a repository, sorted from the highest to the lowest tag.
+ *
+ * update() only fetch the pages newer than the cached head (the first page is a conditional request),
+ * older pages are fetched lazily by the queries when the loaded history is not enough to answer.
+ * GitHub lists releases from the newest to the oldest, so the first match in the loaded history is kept.
+ * The API origin is the one of GetOrigins() at construction.
+ */
+class UPDATER_API ReleaseIndex
+{
+public:
+    ReleaseIndex(std::string owner, std::string repo);
+
+    [[nodiscard]] bool load(std::filesystem::path const& indexFile = GRUPDATER_DEFAULT_RELEASE_INDEX_FILE);
+    [[nodiscard]] bool save(std::filesystem::path const& indexFile = GRUPDATER_DEFAULT_RELEASE_INDEX_FILE) const;
+
+    [[nodiscard]] bool update();
+    //Fetch the next page of older releases, return false if there is nothing more to fetch
+    [[nodiscard]] bool fetchOlder();
+
+    [[nodiscard]] ReleaseEntry const* latest(bool allowPrerelease = false);
+    [[nodiscard]] ReleaseEntry const* latestWithin(TagRange const& range, bool allowPrerelease = false);
+    //Latest release with the first prerelease identifier equal to channel (e.g. "beta"), an empty channel is the stable one
+    [[nodiscard]] ReleaseEntry const* latestChannel(std::string_view channel);
+
+    [[nodiscard]] std::vector<ReleaseEntry> const& getEntries() const;
+    [[nodiscard]] bool isComplete() const;
+    [[nodiscard]] RepoContext makeContext(ReleaseEntry const& entry) const;
+    [[nodiscard]] RateLimitState const& getRateLimit() const;
+    [[nodiscard]] std::string const& getEtag() const;
+    //GetTransport() if not set
+    void setTransport(std::shared_ptr<Transport> transport);
+    //Same as setTransport(std::make_shared<HttplibTransport>(pool))
+    void setClientPool(std::shared_ptr<ClientPool> pool);
+    //Peer/mirror base URLs (e.g. "http://cache.local:8080") ranked with api.github.com by the selector
+    void setMirrors(std::shared_ptr<MirrorSelector> selector);
+
+private:
+    template<class TPredicate>
+    [[nodiscard]] ReleaseEntry const* findLatest(TPredicate const& predicate);
+    //Overwrite the entries with the same id, and remove the ones from refetchedFromId that are not in entries
+    //(ids grow with the creation, so these are the cached releases of the fetched pages), return the removed count
+    std::size_t merge(std::vector<ReleaseEntry>&& entries, std::optional<uint64_t> refetchedFromId = std::nullopt);
+    //Hedged request on the mirrors and the origin, conditional (If-None-Match) if etag is not empty
+    [[nodiscard]] std::optional<HttpResponse> get(std::string const& path, std::string const& etag = {});
+
+    std::string _g_owner;
+    std::string _g_repo;
+    std::string _g_origin;
+    std::vector<ReleaseEntry> _g_entries;
+    uint64_t _g_headId{0};
+    std::size_t _g_fetchedCount{0};
+    std::string _g_etag;
+    bool _g_complete{false};
+    bool _g_upToDate{false};
+    RateLimitState _g_rateLimit;
+    std::shared_ptr<MirrorSelector> _g_selector;
+    std::shared_ptr<Transport> _g_transport;
 };
 
-[[nodiscard]] UPDATER_API std::optional<Tag> ParseTag(std::string const& tag);
+/*
+ * ParseTag:
+ * Parse a SemVer 2.0 tag with an optional 'v' prefix, e.g. "v1.2.0-rc.1+build5".
+ * Labels longer than GRUPDATER_TAG_LABEL_SIZE-1 characters are rejected.
+ * This don't depend on the locale and can be used in a constant expression.
+ */
+[[nodiscard]] constexpr std::optional<Tag> ParseTag(std::string_view tag);
+/*
+ * MakeTag:
+ * Compile time version of ParseTag, a malformed tag is a build error.
+ * e.g. constexpr auto currentTag = updater::MakeTag("v1.4.2"); or "v1.4.2"_tag
+ */
+[[nodiscard]] consteval Tag MakeTag(std::string_view tag);
+[[nodiscard]] UPDATER_API std::string ToString(Tag const& tag);
 
-[[nodiscard]] UPDATER_API std::optional<RepoContext> RetrieveContext(std::string const& owner, std::string const& repo, bool allowPrerelease = false);
+[[nodiscard]] UPDATER_API std::optional<RepoContext> RetrieveContext(std::string const& owner,
+                                                                     std::string const& repo,
+                                                                     bool allowPrerelease = false,
+                                                                     std::vector<std::string> const& mirrors = {});
+
+struct RepoRequest
+{
+    std::string _owner;
+    std::string _repo;
+    bool _allowPrerelease{false};
+};
+/*
+ * RetrieveContexts:
+ * Batch version of RetrieveContext, the repositories are checked concurrently by at most
+ * maxConnections workers sharing the keep-alive connections of the Session.
+ * The release indexes are cached in GRUPDATER_DEFAULT_RELEASE_INDEX_DIRECTORY (one file per repository, as for RetrieveContext)
+ * and the schedule file is written once.
+ * The result is in the same order as the requests.
+ */
+[[nodiscard]] UPDATER_API std::vector<std::optional<RepoContext>> RetrieveContexts(std::vector<RepoRequest> const& requests,
+                                                                                  std::size_t maxConnections = GRUPDATER_DEFAULT_MAX_CONNECTIONS,
+                                                                                  std::vector<std::string> const& mirrors = {});
 [[nodiscard]] UPDATER_API TagStatus VerifyTag(RepoContext const& context, Tag const& currentTag);
 
-[[nodiscard]] UPDATER_API std::optional<std::filesystem::path> DownloadAsset(RepoContext const& context, std::filesystem::path const& tempDir);
+/*
+ * DownloadAsset:
+ * The mirrors (on their /assets/{owner}/{repo}/{tag}/{asset} path) and github.com are ranked by throughput,
+ * a failed transfer continues on the next candidate from the current offset (Range request).
+ */
+[[nodiscard]] UPDATER_API std::optional<std::filesystem::path> DownloadAsset(RepoContext const& context,
+                                                                            std::filesystem::path const& tempDir,
+                                                                            std::vector<std::string> const& mirrors = {});
 [[nodiscard]] UPDATER_API std::optional<std::filesystem::path> ExtractAsset(std::filesystem::path const& assetPath);
 
+struct ArchiveEntry
+{
+    std::string _name; //Relative path with '/' separators, a directory ends with '/'
+    uint64_t _size{0};
+};
+struct ArchiveTotals
+{
+    uint64_t _bytes{0};
+    uint64_t _entries{0};
+};
+
+/*
+ * ArchiveReader:
+ * Sequential reader of the entries of an archive opened by an ArchiveBackend.
+ */
+class UPDATER_API ArchiveReader
+{
+public:
+    virtual ~ArchiveReader() = default;
+
+    //Move to the next entry (the rest of the current one is skipped), false at the end or on failure
+    [[nodiscard]] virtual bool next(ArchiveEntry& entry) = 0;
+    //Read the data of the current entry, 0 at its end and -1 on failure
+    [[nodiscard]] virtual int64_t read(char* data, std::size_t size) = 0;
+    [[nodiscard]] virtual bool hasFailed() const = 0;
+    //Only asked when the progress is observed, nullopt if unknown without reading the whole archive
+    [[nodiscard]] virtual std::optional<ArchiveTotals> getTotals()
+    {
+        return std::nullopt;
+    }
+};
+
+/*
+ * ArchiveBackend:
+ * Format of the release assets, chosen by the extension of the asset name (case insensitive).
+ * The libzip backend (.zip) is always registered, the .tar.zst one when built with UPDATER_ZSTD.
+ */
+class UPDATER_API ArchiveBackend
+{
+public:
+    virtual ~ArchiveBackend() = default;
+
+    //e.g. ".zip"
+    [[nodiscard]] virtual std::string_view getExtension() const = 0;
+    //Accepted content types of the GitHub assets, the first one is advertised by the PeerServer
+    [[nodiscard]] virtual std::vector<std::string> getContentTypes() const = 0;
+    //nullptr if the archive can't be opened (logged)
+    [[nodiscard]] virtual std::unique_ptr<ArchiveReader> open(std::filesystem::path const& archivePath) = 0;
+};
+//Registered before the previous ones, so preferred by the asset selection when a release has many formats
+UPDATER_API void RegisterArchiveBackend(std::shared_ptr<ArchiveBackend> backend);
+//Most preferred first (the fastest to extract: .tar.zst then .zip)
+[[nodiscard]] UPDATER_API std::vector<std::shared_ptr<ArchiveBackend>> GetArchiveBackends();
+//Backend of an asset or archive name, nullptr if none
+[[nodiscard]] UPDATER_API std::shared_ptr<ArchiveBackend> FindArchiveBackend(std::string_view name);
+
+enum class FileType : uint8_t
+{
+    None, //Missing
+    Regular,
+    Directory,
+    Other
+};
+struct FileStatus
+{
+    FileType _type{FileType::None};
+    uint64_t _size{0}; //Of a regular file
+};
+
+class UPDATER_API FileReader
+{
+public:
+    virtual ~FileReader() = default;
+
+    //0 at the end and -1 on failure
+    [[nodiscard]] virtual int64_t read(char* data, std::size_t size) = 0;
+};
+class UPDATER_API FileWriter
+{
+public:
+    virtual ~FileWriter() = default;
+
+    [[nodiscard]] virtual bool write(char const* data, std::size_t size) = 0;
+    //False if any write failed
+    [[nodiscard]] virtual bool close() = 0;
+};
+
+using FileVisitor = std::function<bool(std::filesystem::path const& path, FileStatus const& status)>;
+
+/*
+ * FileSystem:
+ * File operations of the extraction (SessionConfig::_fileSystem) and of ApplyFiles, on the disk (OsFileSystem)
+ * or in memory (MemoryFileSystem) to measure the work of the engines without the disk.
+ * Nothing throws, a failure returns false, nullptr or the None type.
+ */
+class UPDATER_API FileSystem
+{
+public:
+    virtual ~FileSystem() = default;
+
+    [[nodiscard]] virtual std::unique_ptr<FileReader> openRead(std::filesystem::path const& path) = 0;
+    //Created or truncated, the parent directory must exist
+    [[nodiscard]] virtual std::unique_ptr<FileWriter> openWrite(std::filesystem::path const& path) = 0;
+    [[nodiscard]] virtual bool createDirectories(std::filesystem::path const& path) = 0;
+    //Replace the file to if it exists
+    [[nodiscard]] virtual bool rename(std::filesystem::path const& from, std::filesystem::path const& to) = 0;
+    //A file or an empty directory, true if already missing
+    [[nodiscard]] virtual bool remove(std::filesystem::path const& path) = 0;
+    [[nodiscard]] virtual FileStatus stat(std::filesystem::path const& path) = 0;
+    //Every entry below directory (a directory before its content) until visitor returns false
+    [[nodiscard]] virtual bool iterate(std::filesystem::path const& directory, FileVisitor const& visitor) = 0;
+    //Hard link, both paths share the same content
+    [[nodiscard]] virtual bool link(std::filesystem::path const& target, std::filesystem::path const& link) = 0;
+    //Fail if to exists, the default copies through openRead and openWrite
+    [[nodiscard]] virtual bool copy(std::filesystem::path const& from, std::filesystem::path const& to);
+};
+
+class UPDATER_API OsFileSystem : public FileSystem
+{
+public:
+    [[nodiscard]] std::unique_ptr<FileReader> openRead(std::filesystem::path const& path) override;
+    [[nodiscard]] std::unique_ptr<FileWriter> openWrite(std::filesystem::path const& path) override;
+    [[nodiscard]] bool createDirectories(std::filesystem::path const& path) override;
+    [[nodiscard]] bool rename(std::filesystem::path const& from, std::filesystem::path const& to) override;
+    [[nodiscard]] bool remove(std::filesystem::path const& path) override;
+    [[nodiscard]] FileStatus stat(std::filesystem::path const& path) override;
+    [[nodiscard]] bool iterate(std::filesystem::path const& directory, FileVisitor const& visitor) override;
+    [[nodiscard]] bool link(std::filesystem::path const& target, std::filesystem::path const& link) override;
+    [[nodiscard]] bool copy(std::filesystem::path const& from, std::filesystem::path const& to) override;
+};
+
+/*
+ * MemoryFileSystem:
+ * Tree of the lexically normal paths, the root ("/" or "" for the relative paths) always exists.
+ * The tree is thread safe, the content of a file should not be written and read at the same time.
+ */
+class UPDATER_API MemoryFileSystem : public FileSystem
+{
+public:
+    [[nodiscard]] std::unique_ptr<FileReader> openRead(std::filesystem::path const& path) override;
+    [[nodiscard]] std::unique_ptr<FileWriter> openWrite(std::filesystem::path const& path) override;
+    [[nodiscard]] bool createDirectories(std::filesystem::path const& path) override;
+    [[nodiscard]] bool rename(std::filesystem::path const& from, std::filesystem::path const& to) override;
+    [[nodiscard]] bool remove(std::filesystem::path const& path) override;
+    [[nodiscard]] FileStatus stat(std::filesystem::path const& path) override;
+    [[nodiscard]] bool iterate(std::filesystem::path const& directory, FileVisitor const& visitor) override;
+    [[nodiscard]] bool link(std::filesystem::path const& target, std::filesystem::path const& link) override;
+    [[nodiscard]] bool copy(std::filesystem::path const& from, std::filesystem::path const& to) override;
+
+    //Bytes of the distinct contents (the hard links are counted once)
+    [[nodiscard]] uint64_t getSize() const;
+
+private:
+    //With the lock held
+    [[nodiscard]] bool isDirectory(std::string const& key) const;
+    [[nodiscard]] bool hasChildren(std::string const& key) const;
+
+    mutable std::mutex _g_mutex;
+    std::map<std::string, std::shared_ptr<std::string>> _g_nodes; //Generic path to content, null for a directory
+};
+
+[[nodiscard]] UPDATER_API std::shared_ptr<FileSystem> GetOsFileSystem();
+
+struct SessionConfig
+{
+    std::filesystem::path _scheduleFile{GRUPDATER_DEFAULT_SCHEDULE_FILE};
+    std::filesystem::path _indexDirectory{GRUPDATER_DEFAULT_RELEASE_INDEX_DIRECTORY}; //One owner_repo.json per repository
+    std::size_t _workers{GRUPDATER_DEFAULT_MAX_CONNECTIONS};                          //Threads of retrieveContexts
+    std::size_t _maxIdleConnections{GRUPDATER_DEFAULT_MAX_IDLE_CONNECTIONS};
+    std::shared_ptr<Transport> _transport; //SetTransport() or httplib over the ClientPool of the session if empty
+    std::shared_ptr<FileSystem> _fileSystem; //Of the extracted files (the archive is read from the disk), the OS if empty
+};
+
+/*
+ * Session:
+ * State kept between the update steps of an embedding application, the free functions RetrieveContext(s),
+ * DownloadAsset and ExtractAsset are wrappers of the default session:
+ * - keep-alive connections (ClientPool) shared by the checks and the downloads, through getTransport()
+ * - worker threads of retrieveContexts, started once
+ * - release indexes loaded once (the file is only written when the ETag or the entries changed)
+ *   and mirror selectors read once from the schedule file
+ * - extraction buffers of GRUPDATER_SESSION_BUFFER_SIZE
+ * A check writes the schedule file once. Thread safe, clearCaches() forgets the files read by another process.
+ */
+class UPDATER_API Session
+{
+public:
+    explicit Session(SessionConfig config = {});
+    ~Session();
+
+    Session(Session const&) = delete;
+    Session& operator=(Session const&) = delete;
+
+    [[nodiscard]] static Session& getDefault();
+
+    [[nodiscard]] std::optional<RepoContext> retrieveContext(std::string const& owner,
+                                                             std::string const& repo,
+                                                             bool allowPrerelease = false,
+                                                             std::vector<std::string> const& mirrors = {});
+    [[nodiscard]] std::vector<std::optional<RepoContext>> retrieveContexts(std::vector<RepoRequest> const& requests,
+                                                                           std::size_t maxConnections = GRUPDATER_DEFAULT_MAX_CONNECTIONS,
+                                                                           std::vector<std::string> const& mirrors = {});
+    [[nodiscard]] std::optional<std::filesystem::path> downloadAsset(RepoContext const& context,
+                                                                     std::filesystem::path const& tempDir,
+                                                                     std::vector<std::string> const& mirrors = {});
+    [[nodiscard]] std::optional<std::filesystem::path> extractAsset(std::filesystem::path const& assetPath);
+
+    void clearCaches();
+    [[nodiscard]] SessionConfig const& getConfig() const;
+    [[nodiscard]] ClientPool& getClientPool();
+    //Of the configuration, else the one of SetTransport(), else httplib over getClientPool()
+    [[nodiscard]] std::shared_ptr<Transport> getTransport() const;
+
+private:
+    struct Check;
+    struct CachedIndex;
+    struct Workers;
+
+    [[nodiscard]] std::shared_ptr<MirrorSelector> getSelector(std::vector<std::string> const& mirrors);
+    [[nodiscard]] std::shared_ptr<CachedIndex> getIndex(std::string const& owner, std::string const& repo, std::filesystem::path const& indexFile);
+    //Release index file of the repository in _indexDirectory
+    [[nodiscard]] std::filesystem::path getIndexFile(RepoRequest const& request) const;
+    [[nodiscard]] Check check(RepoRequest const& request, std::filesystem::path const& indexFile, std::shared_ptr<MirrorSelector> const& selector);
+    //Write the results of the checks in the schedule file at once
+    [[nodiscard]] bool record(std::vector<RepoRequest> const& requests, std::vector<Check> const& checks, MirrorSelector const& selector);
+    [[nodiscard]] std::shared_ptr<std::vector<char>> acquireBuffer();
+
+    SessionConfig _g_config;
+    std::shared_ptr<ClientPool> _g_clients;
+    std::shared_ptr<Transport> _g_transport;
+    std::unique_ptr<Workers> _g_workers;
+    std::mutex _g_mutex;
+    std::map<std::string, std::shared_ptr<CachedIndex>> _g_indexes;     //By origin and index file
+    std::map<std::string, std::shared_ptr<MirrorSelector>> _g_selectors; //By mirror list
+    std::vector<std::unique_ptr<std::vector<char>>> _g_buffers;
+};
+
+/*
+ * ScheduleState:
+ * Content of the schedule file.
+ */
+struct ScheduleState
+{
+    std::optional<std::chrono::system_clock::time_point> _lastTime;
+    RateLimitState _rateLimit;
+    std::map<std::string, std::chrono::system_clock::time_point> _repos; //"owner/repo" of the tracked repositories sharing the rate limit, by last check time
+    std::chrono::seconds _splayWindow{std::chrono::minutes{GRUPDATER_DEFAULT_SCHEDULE_SPLAY_MINUTES}};
+    std::chrono::seconds _rolloutWindow{std::chrono::hours{GRUPDATER_DEFAULT_ROLLOUT_WINDOW_HOURS}};
+
+    //Adaptive schedule, the delay between checks follows the release cadence
+    bool _adaptive{true};
+    std::vector<std::chrono::system_clock::time_point> _releaseTimes; //Most recent first
+    std::chrono::seconds _minDelay{std::chrono::minutes{GRUPDATER_ADAPTIVE_MIN_DELAY_MINUTES}};
+    std::chrono::seconds _maxDelay{std::chrono::hours{GRUPDATER_ADAPTIVE_MAX_DELAY_HOURS}};
+
+    std::map<std::string, MirrorStats> _mirrors; //By base URL (mirrors and origins)
+};
+
+/*
+ * GetMachineHash:
+ * Stable 64 bits hash of this machine id (MachineGuid on Windows),
+ * the GRUPDATER_MACHINE_ID environment variable can override the id.
+ */
+[[nodiscard]] UPDATER_API uint64_t GetMachineHash();
+/*
+ * GetScheduleSplay:
+ * Deterministic offset in [0, window) for this machine, the salt (e.g. "owner/repo") gives
+ * a different offset for every repository of the same machine.
+ */
+[[nodiscard]] UPDATER_API std::chrono::seconds GetScheduleSplay(std::chrono::seconds const& window, std::string_view salt = {});
+
+[[nodiscard]] UPDATER_API std::optional<ScheduleState> GetScheduleState(std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
+[[nodiscard]] UPDATER_API bool SetScheduleState(ScheduleState const& state, std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
+//Merge the rate limit of the last requests done for owner/repo into the schedule file
+[[nodiscard]] UPDATER_API bool RecordRateLimit(std::string const& owner,
+                                               std::string const& repo,
+                                               RateLimitState const& rateLimit,
+                                               std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
+//Merge the published times of the most recent releases into the schedule file
+[[nodiscard]] UPDATER_API bool RecordReleaseTimes(std::vector<ReleaseEntry> const& entries,
+                                                  std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
+//Selector of the mirrors with the measures saved in the schedule file
+[[nodiscard]] UPDATER_API std::shared_ptr<MirrorSelector> LoadMirrorSelector(std::vector<std::string> const& mirrors,
+                                                                             std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
+//Save the measures of the selector into the schedule file
+[[nodiscard]] UPDATER_API bool RecordMirrorStats(MirrorSelector const& selector,
+                                                 std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
+/*
+ * GetAdaptiveDelay:
+ * Median interval between the recorded releases divided by GRUPDATER_ADAPTIVE_CHECKS_PER_RELEASE,
+ * clamped to [_minDelay, _maxDelay]. Return nothing if disabled or with less than 2 recorded releases.
+ */
+[[nodiscard]] UPDATER_API std::optional<std::chrono::seconds> GetAdaptiveDelay(ScheduleState const& state);
+/*
+ * GetNextScheduleTime:
+ * Earliest time of the next check, at least delay (or the adaptive delay when known) + this machine splay after the last one.
+ * The remaining API budget (minus a reserve) is spread over the tracked repositories until the reset time,
+ * when the budget is exhausted or a Retry-After was received, the next check is pushed after it.
+ */
+[[nodiscard]] UPDATER_API std::chrono::system_clock::time_point GetNextScheduleTime(ScheduleState const& state,
+                                                                                   std::chrono::hours const& delay = std::chrono::hours{GRUPDATER_DEFAULT_SCHEDULE_DELAY_HOURS});
+
 [[nodiscard]] UPDATER_API std::optional<std::chrono::system_clock::time_point> GetScheduleTime(std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE);
 [[nodiscard]] UPDATER_API bool SetScheduleTime(std::filesystem::path const& scheduleFile = GRUPDATER_DEFAULT_SCHEDULE_FILE, std::chrono::system_clock::time_point const& time = std::chrono::system_clock::now());
-[[nodiscard]] UPDATER_API bool VerifyScheduleTime(std::chrono::system_clock::time_point const& timePoint, std::chrono::hours const& delay = std::chrono::hours{GRUPDATER_DEFAULT_SCHEDULE_DELAY_HOURS});
+[[nodiscard]] UPDATER_API bool VerifyScheduleTime(std::chrono::system_clock::time_point const& timePoint,
+                                                  std::chrono::hours const& delay = std::chrono::hours{GRUPDATER_DEFAULT_SCHEDULE_DELAY_HOURS},
+                                                  std::chrono::seconds const& splayWindow = std::chrono::minutes{GRUPDATER_DEFAULT_SCHEDULE_SPLAY_MINUTES});
+//Verify that this machine rollout time of the release (published time + splay of the rollout window) is reached
+[[nodiscard]] UPDATER_API bool VerifyRolloutTime(RepoContext const& context,
+                                                 std::chrono::seconds const& rolloutWindow = std::chrono::hours{GRUPDATER_DEFAULT_ROLLOUT_WINDOW_HOURS});
+
+/*
+ * HttpTimings:
+ * Sub-timings of the HTTP requests of a phase, summed over its requests.
+ * - dns: until the socket is created, connect: until the TLS handshake starts, tls: the handshake
+ * - ttfb: from the start of the request to the first byte of the response (include the others)
+ * A reused (keep-alive) connection has no dns, connect or tls time, without TLS the connect time is part of the ttfb.
+ */
+struct HttpTimings
+{
+    uint32_t _requests{0};
+    uint32_t _connections{0};
+    std::chrono::microseconds _dns{0};
+    std::chrono::microseconds _connect{0};
+    std::chrono::microseconds _tls{0};
+    std::chrono::microseconds _ttfb{0};
+};
+
+/*
+ * PhaseMetrics:
+ * Measures of one phase of an update ("retrieve", "download", "extract", "apply").
+ * The CPU times and the I/O counters (read/write system calls and their bytes) are the difference of the process
+ * counters between the start and the end of the phase, the peak RSS is the process high-water mark at its end.
+ */
+struct PhaseMetrics
+{
+    std::string _name;
+    bool _success{false};
+    std::chrono::microseconds _wallTime{0};
+    std::chrono::microseconds _userTime{0};
+    std::chrono::microseconds _systemTime{0};
+    uint64_t _bytes{0}; //Payload (downloaded, extracted or copied)
+    uint64_t _files{0};
+    uint64_t _readOperations{0};
+    uint64_t _writeOperations{0};
+    uint64_t _readBytes{0};
+    uint64_t _writeBytes{0};
+    uint64_t _peakRss{0};
+    HttpTimings _http;
+};
+
+struct UpdateMetrics
+{
+    std::vector<PhaseMetrics> _phases;
+};
+[[nodiscard]] UPDATER_API std::string ToJson(UpdateMetrics const& metrics);
+
+/*
+ * MetricsScope:
+ * Measure a phase while alive and append it to metrics (nothing is measured with a null metrics).
+ * The library functions called meanwhile from this thread (and the requests they start) add their bytes,
+ * files and HTTP timings to the innermost scope.
+ */
+class UPDATER_API MetricsScope
+{
+public:
+    MetricsScope(UpdateMetrics* metrics, std::string name);
+    ~MetricsScope();
+
+    MetricsScope(MetricsScope const&) = delete;
+    MetricsScope& operator=(MetricsScope const&) = delete;
+
+    //Innermost scope of this thread, nullptr if none
+    [[nodiscard]] static MetricsScope* current();
+
+    void setSuccess(bool success);
+    void addBytes(uint64_t bytes);
+    void addFiles(uint64_t files);
+    void addHttp(HttpTimings const& timings);
+
+private:
+    UpdateMetrics* _g_metrics;
+    MetricsScope* _g_previous;
+    PhaseMetrics _g_phase;
+    PhaseMetrics _g_start; //Process counters at the start
+    std::chrono::steady_clock::time_point _g_begin;
+    std::mutex _g_mutex;
+};
+
+/*
+ * Histogram:
+ * Fixed buckets histogram, a value goes in the first bucket whose upper bound is greater or equal (the last bucket is +Inf).
+ * observe() is lock-free, a reader may see a count and a sum from slightly different instants.
+ */
+class UPDATER_API Histogram
+{
+public:
+    //The upper bounds must be sorted
+    explicit Histogram(std::vector<double> bounds);
+
+    Histogram(Histogram const&) = delete;
+    Histogram& operator=(Histogram const&) = delete;
+
+    void observe(double value);
+
+    [[nodiscard]] std::vector<double> const& getBounds() const;
+    //Count of the bucket (not cumulative), the index getBounds().size() is the +Inf bucket
+    [[nodiscard]] uint64_t getBucketCount(std::size_t index) const;
+    [[nodiscard]] double getSum() const;
+
+private:
+    std::vector<double> _g_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> _g_buckets;
+    std::atomic<double> _g_sum{0.0};
+};
 
+/*
+ * UpdaterTelemetry:
+ * Process wide counters of the updater, fed by the library functions and exposed by MetricsServer.
+ * Every update is a relaxed atomic operation.
+ */
+struct UpdaterTelemetry
+{
+    std::atomic<uint64_t> _checks{0}; //ReleaseIndex::update() calls
+    std::atomic<uint64_t> _checksNotModified{0}; //Answered by a 304
+    std::atomic<uint64_t> _checkFailures{0};
+    std::atomic<uint64_t> _downloads{0};
+    std::atomic<uint64_t> _downloadFailures{0};
+    std::atomic<uint64_t> _downloadBytes{0};
+    std::atomic<uint64_t> _extractions{0};
+    std::atomic<uint64_t> _extractBytes{0};
+    std::atomic<uint64_t> _applies{0};
+    std::atomic<int64_t> _rateLimitRemaining{-1}; //Last X-RateLimit-Remaining received, -1 if none yet
+    Histogram _downloadSeconds{{0.1, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 300.0}};
+    Histogram _extractBytesPerSecond{{1e6, 5e6, 1e7, 2.5e7, 5e7, 1e8, 2.5e8, 5e8}};
+    Histogram _applyDowntimeSeconds{{0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0}}; //From the caller exit to the copied files
+};
+[[nodiscard]] UPDATER_API UpdaterTelemetry& GetTelemetry();
+//OpenMetrics text exposition (also readable by Prometheus)
+[[nodiscard]] UPDATER_API std::string ToOpenMetrics(UpdaterTelemetry const& telemetry);
+
+/*
+ * MetricsServer:
+ * Serve GetTelemetry() on /metrics from a background thread (for the long running modes).
+ */
+class UPDATER_API MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    MetricsServer(MetricsServer const&) = delete;
+    MetricsServer& operator=(MetricsServer const&) = delete;
+
+    //Return false if the address can't be bound
+    [[nodiscard]] bool start(std::string const& host, int port);
+    void stop();
+
+private:
+    std::unique_ptr<httplib::Server> _g_server;
+    std::thread _g_thread;
+};
+
+/*
+ * Tracer:
+ * Timeline of the TraceSpan of every thread, dumped in the Chrome trace event format (chrome://tracing, Perfetto).
+ * Each thread records into its own ring buffer (GRUPDATER_TRACE_RING_SIZE spans), the buffer of an ended thread
+ * is kept and reused by the next new thread. Disabled by default, a span then costs a relaxed atomic load.
+ */
+class UPDATER_API Tracer
+{
+public:
+    static void setEnabled(bool enabled);
+    [[nodiscard]] static bool isEnabled();
+
+    [[nodiscard]] static std::string dump();
+    [[nodiscard]] static bool dump(std::filesystem::path const& traceFile);
+};
+
+/*
+ * TraceSpan:
+ * Record the lifetime of this object as a span, name must be a string literal.
+ * The details are joined into the "detail" argument of the span (only copied when tracing is enabled).
+ */
+class UPDATER_API TraceSpan
+{
+public:
+    explicit TraceSpan(char const* name, std::initializer_list<std::string_view> details = {});
+    ~TraceSpan();
+
+    TraceSpan(TraceSpan const&) = delete;
+    TraceSpan& operator=(TraceSpan const&) = delete;
+
+private:
+    char const* _g_name;
+    std::string _g_detail;
+    std::chrono::steady_clock::time_point _g_begin;
+    bool _g_enabled;
+};
+
+/*
+ * ApplyFiles:
+ * File part of ApplyUpdate: the regular files of target are removed, except the dynamic files listed in
+ * target/GRUPDATER_DEFAULT_DYNAMIC_FILE and the directory holding source (e.g. target/temp for target/temp/app),
+ * then the files of source are copied into target (counted by the current MetricsScope).
+ */
+[[nodiscard]] UPDATER_API bool ApplyFiles(FileSystem& fileSystem, std::filesystem::path const& source, std::filesystem::path const& target);
 //Called from the extracted GRUpdater executable
-[[nodiscard]] UPDATER_API bool ApplyUpdate(std::filesystem::path const& target, std::filesystem::path callerExecutable, std::optional<uint32_t> callerPid);
+[[nodiscard]] UPDATER_API bool ApplyUpdate(std::filesystem::path const& target,
+                                           std::filesystem::path callerExecutable,
+                                           std::optional<uint32_t> callerPid,
+                                           UpdateMetrics* metrics = nullptr);
+/*
+ * PrepareApply:
+ * Write the apply plan (applyPlan.txt) of the extracted root for the lean GRUpdaterApply executable:
+ * the files to copy and the paths kept by ApplyFiles, with the dynamic files read now.
+ * Called by RequestApplyUpdate(..., ApplyMode::Lean) just before the launch, relative paths are from the current directory.
+ */
+[[nodiscard]] UPDATER_API bool PrepareApply(std::filesystem::path const& rootAssetPath, std::filesystem::path const& target);
+
+enum class ApplyMode : uint8_t
+{
+    Full, //"GRUpdaterCmd apply" of the extracted root
+    Lean  //GRUpdaterApply of the extracted root, with the plan written by PrepareApply (shorter start while the application is down)
+};
 //Called from the caller executable
-[[nodiscard]] UPDATER_API bool RequestApplyUpdate(std::filesystem::path const& rootAssetPath, std::filesystem::path const& callerExecutable);
+[[nodiscard]] UPDATER_API bool RequestApplyUpdate(std::filesystem::path const& rootAssetPath,
+                                                  std::filesystem::path const& callerExecutable,
+                                                  ApplyMode mode = ApplyMode::Full);
+
+/*
+ * TimerWheel:
+ * Hierarchical timer wheel (4 levels of 64 slots), the tick unit is chosen by the user.
+ * Scheduling is O(1), timers are cascaded to the lower level when their slot is reached.
+ * Timers further than 64^4 ticks are clamped.
+ */
+class UPDATER_API TimerWheel
+{
+public:
+    using Id = uint64_t;
+
+    explicit TimerWheel(uint64_t currentTick = 0);
+
+    void schedule(Id id, uint64_t expiryTick);
+    //Advance up to tick (included) and append the expired timers
+    void advance(uint64_t tick, std::vector<Id>& expired);
+    //Earliest expiry tick of the scheduled timers
+    [[nodiscard]] std::optional<uint64_t> getNextExpiry() const;
+
+    [[nodiscard]] uint64_t getCurrentTick() const;
+    [[nodiscard]] std::size_t getSize() const;
+
+private:
+    static constexpr std::size_t LevelBits = 6;
+    static constexpr std::size_t SlotCount = std::size_t{1} << LevelBits;
+    static constexpr std::size_t LevelCount = 4;
+
+    struct Timer
+    {
+        Id _id;
+        uint64_t _expiry;
+    };
+
+    void insert(Timer timer, std::vector<Id>* expired);
+
+    std::array<std::array<std::vector<Timer>, SlotCount>, LevelCount> _g_slots;
+    uint64_t _g_currentTick;
+    std::size_t _g_size{0};
+};
+
+struct WatchEntry
+{
+    std::string _owner;
+    std::string _repo;
+    Tag _currentTag;
+    bool _allowPrerelease{false};
+};
+
+/*
+ * LoadManifest:
+ * Load a list of repositories to check, format:
+ * {"repos": [{"owner": "owner", "repo": "repo", "current": "v1.2.3", "prerelease": false}, ...]}
+ */
+[[nodiscard]] UPDATER_API std::optional<std::vector<WatchEntry>> LoadManifest(std::filesystem::path const& manifestFile);
+
+/*
+ * Daemon:
+ * Long running checker of many repositories, the checks are fired from a TimerWheel (1 second ticks)
+ * following GetNextScheduleTime. Every repository keep its ReleaseIndex (and its keep-alive connection)
+ * in memory, so a check in a steady state is a single conditional request.
+ * The rate limit is shared by all the watched repositories.
+ */
+class UPDATER_API Daemon
+{
+public:
+    //Return false when the newer tag was not handled (e.g. a failed download), it is notified again on the next check
+    using Callback = std::function<bool(WatchEntry const& entry, RepoContext const& context)>;
+
+    //The schedule state provide the windows/bounds configuration (its times are ignored)
+    explicit Daemon(Callback onNewerTag, ScheduleState schedule = {});
+
+    void watch(WatchEntry entry);
+
+    //Check the due repositories once and return the time of the next check
+    std::optional<std::chrono::system_clock::time_point> poll();
+    //Poll until stop() is called (stop() can be called from a signal handler)
+    void run();
+    void stop();
+
+private:
+    struct Watched
+    {
+        WatchEntry _entry;
+        ReleaseIndex _index;
+        std::optional<std::chrono::system_clock::time_point> _lastTime;
+        std::vector<std::chrono::system_clock::time_point> _releaseTimes;
+    };
+
+    void check(std::size_t id);
+
+    Callback _g_onNewerTag;
+    ScheduleState _g_schedule;
+    std::vector<Watched> _g_watched;
+    TimerWheel _g_wheel;
+    std::atomic_bool _g_running{false};
+};
+
+/*
+ * PeerServer:
+ * LAN cache of the releases (serve mode), other nodes use it as a mirror:
+ * - /repos/{owner}/{repo}/releases : GitHub compatible release list from a local ReleaseIndex,
+ *   refreshed from GitHub at most every refreshDelay
+ * - /assets/{owner}/{repo}/{tag}/{asset} : the asset, downloaded once from GitHub into the cache directory
+ *   then served from the file (Range requests are supported)
+ * The assets can also be served on a dedicated plain HTTP port (assetPort), the same /assets path is answered
+ * straight from the cached file to the socket by the kernel (TransmitFile) without userspace copies
+ */
+class UPDATER_API PeerServer
+{
+public:
+    explicit PeerServer(std::filesystem::path cacheDirectory = GRUPDATER_DEFAULT_PEER_CACHE_DIRECTORY,
+                        std::chrono::seconds refreshDelay = std::chrono::minutes{GRUPDATER_DEFAULT_PEER_REFRESH_MINUTES});
+    ~PeerServer();
+
+    PeerServer(PeerServer const&) = delete;
+    PeerServer& operator=(PeerServer const&) = delete;
+
+    //Blocking until stop() is called, no zero-copy asset endpoint if assetPort is 0
+    [[nodiscard]] bool listen(std::string const& host, int port = GRUPDATER_DEFAULT_PEER_PORT, int assetPort = 0);
+    void stop();
+
+private:
+    struct Repo;
+    struct AssetListener;
+
+    [[nodiscard]] std::shared_ptr<Repo> getRepo(std::string const& owner, std::string const& repo);
+    //Refresh the index from GitHub if needed, the repo mutex must be locked
+    [[nodiscard]] bool refresh(Repo& repo);
+    //Download the asset into the cache directory if needed, return the HTTP status (200 when assetPath is ready)
+    [[nodiscard]] int cacheAsset(std::string const& owner,
+                                 std::string const& repo,
+                                 std::string const& tag,
+                                 std::string const& asset,
+                                 std::filesystem::path& assetPath);
+    //Download of cacheAsset, the repo mutex is only held to find the release
+    [[nodiscard]] int downloadAsset(std::string const& owner,
+                                    std::string const& repo,
+                                    std::string const& tag,
+                                    std::string const& asset,
+                                    std::filesystem::path const& assetPath);
+
+    std::filesystem::path _g_cacheDirectory;
+    std::chrono::seconds _g_refreshDelay;
+    std::unique_ptr<httplib::Server> _g_server;
+    std::unique_ptr<AssetListener> _g_assetListener;
+    std::mutex _g_mutex;
+    std::map<std::string, std::shared_ptr<Repo>> _g_repos;
+    std::map<std::filesystem::path, std::shared_future<int>> _g_downloads; //In-flight by asset path, shared by the requests
+};
 
 /*
  * MakeAvailable:
@@ -90,11 +1397,406 @@ struct RepoContext
  * - Download the asset
  * - Extract the asset
  * - Return the extracted root
+ * The retrieve, download and extract phases are measured into metrics if not null.
  */
 [[nodiscard]] UPDATER_API std::optional<std::filesystem::path> MakeAvailable(Tag const& currentTag,
                                                                              std::string const& owner,
                                                                              std::string const& repo,
                                                                              std::filesystem::path const& tempDir,
-                                                                             bool allowPrerelease = false);
+                                                                             bool allowPrerelease = false,
+                                                                             std::vector<std::string> const& mirrors = {},
+                                                                             UpdateMetrics* metrics = nullptr);
+
+enum class ProgressPhase : uint8_t
+{
+    Download,
+    Extract
+};
+[[nodiscard]] UPDATER_API const char* ToString(ProgressPhase phase);
+
+struct Progress
+{
+    ProgressPhase _phase{ProgressPhase::Download};
+    uint64_t _bytesDone{0};
+    std::optional<uint64_t> _bytesTotal;      //Unknown until the response headers (download)
+    double _bytesPerSecond{0.0};              //Since the previous report
+    std::optional<std::chrono::seconds> _eta; //Needs the total and a rate
+    uint64_t _entryIndex{0};                  //Extracted entry
+    uint64_t _entryCount{0};
+    bool _finished{false};                    //Last report of the phase
+};
+using ProgressObserver = std::function<void(Progress const&)>;
+
+/*
+ * ProgressScope:
+ * Report the progress of the downloads and extractions called from this thread while alive to observer, at most
+ * every interval: a report costs a clock read per received or extracted chunk, the observer runs on the working thread.
+ * The library calls start(), update() and finish(), a nested phase replaces the previous one.
+ */
+class UPDATER_API ProgressScope
+{
+public:
+    explicit ProgressScope(ProgressObserver observer, std::chrono::milliseconds interval = std::chrono::milliseconds{GRUPDATER_PROGRESS_INTERVAL_MS});
+    ~ProgressScope();
+
+    ProgressScope(ProgressScope const&) = delete;
+    ProgressScope& operator=(ProgressScope const&) = delete;
+
+    //Innermost scope of this thread, nullptr if none
+    [[nodiscard]] static ProgressScope* current();
+
+    void start(ProgressPhase phase, std::optional<uint64_t> bytesTotal, uint64_t entryCount = 0);
+    void setTotal(uint64_t bytesTotal);
+    void update(uint64_t bytesDone, uint64_t entryIndex);
+    void finish(bool success);
+
+private:
+    void report(std::chrono::steady_clock::time_point now);
+
+    ProgressObserver _g_observer;
+    std::chrono::steady_clock::duration _g_interval;
+    ProgressScope* _g_previous;
+    Progress _g_progress;
+    std::chrono::steady_clock::time_point _g_lastTime;
+    uint64_t _g_lastBytes{0};
+    bool _g_started{false};
+};
+
+/*
+ * CancelScope:
+ * Cooperative cancellation of the library functions called from this thread (and the requests they start)
+ * while alive: once stopToken is requested the transfers and the extraction stop at the next chunk,
+ * MakeAvailable at the next step, and they fail.
+ */
+class UPDATER_API CancelScope
+{
+public:
+    explicit CancelScope(std::stop_token stopToken);
+    ~CancelScope();
+
+    CancelScope(CancelScope const&) = delete;
+    CancelScope& operator=(CancelScope const&) = delete;
+
+    //Innermost scope of this thread, nullptr if none
+    [[nodiscard]] static CancelScope* current();
+    //Of the innermost scope of this thread
+    [[nodiscard]] static bool isCancelled();
+
+    [[nodiscard]] std::stop_token const& getToken() const;
+
+private:
+    std::stop_token _g_token;
+    CancelScope* _g_previous;
+};
+
+/*
+ * Executor:
+ * GRUPDATER_EXECUTOR_THREADS threads of the library running the asynchronous API, started on the first job.
+ * The queued jobs are still run when the process ends.
+ */
+class UPDATER_API Executor
+{
+public:
+    ~Executor();
+
+    Executor(Executor const&) = delete;
+    Executor& operator=(Executor const&) = delete;
+
+    [[nodiscard]] static Executor& get();
+
+    //An exception escaping the job is logged and dropped, the executor thread keeps running
+    void post(std::function<void()> job);
+
+private:
+    Executor() = default;
+    void loop();
+
+    std::mutex _g_mutex;
+    std::condition_variable _g_condition;
+    std::deque<std::function<void()>> _g_jobs;
+    std::vector<std::thread> _g_threads;
+    bool _g_stopped{false};
+};
+
+/*
+ * Async:
+ * A job of the Executor started when it is awaited (co_await, the coroutine is then resumed on the executor thread)
+ * or by toFuture(). Only one of them, once. An exception of the job is rethrown by co_await or the future.
+ */
+template<class T>
+class [[nodiscard]] Async
+{
+public:
+    explicit Async(std::function<T()> job) :
+            _g_job(std::move(job))
+    {}
+
+    [[nodiscard]] bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        Executor::get().post([this, handle] {
+            try
+            {
+                this->_g_result.emplace(this->_g_job());
+            }
+            catch (...)
+            {
+                this->_g_exception = std::current_exception();
+            }
+            handle.resume();
+        });
+    }
+    [[nodiscard]] T await_resume()
+    {
+        if (this->_g_exception)
+        {
+            std::rethrow_exception(this->_g_exception);
+        }
+        return std::move(*this->_g_result);
+    }
+
+    [[nodiscard]] std::future<T> toFuture() &&
+    {
+        auto task = std::make_shared<std::packaged_task<T()>>(std::move(this->_g_job));
+        auto future = task->get_future();
+        Executor::get().post([task = std::move(task)] {
+            (*task)();
+        });
+        return future;
+    }
+
+private:
+    std::function<T()> _g_job;
+    std::optional<T> _g_result;
+    std::exception_ptr _g_exception;
+};
+
+/*
+ * MakeAvailableAsync:
+ * MakeAvailable on the Executor, cancelled through stopToken (a cancelled update is nullopt),
+ * progress is called from the executor thread (see ProgressScope).
+ * e.g. auto extractRoot = co_await updater::MakeAvailableAsync(currentTag, owner, repo, "temp/", ..., stopSource.get_token());
+ *      or MakeAvailableAsync(...).toFuture()
+ * The strings and mirrors are copied, metrics must outlive the job.
+ */
+[[nodiscard]] UPDATER_API Async<std::optional<std::filesystem::path>> MakeAvailableAsync(Tag const& currentTag,
+                                                                                         std::string owner,
+                                                                                         std::string repo,
+                                                                                         std::filesystem::path tempDir,
+                                                                                         bool allowPrerelease = false,
+                                                                                         std::vector<std::string> mirrors = {},
+                                                                                         std::stop_token stopToken = {},
+                                                                                         ProgressObserver progress = {},
+                                                                                         UpdateMetrics* metrics = nullptr);
+
+namespace impl
+{
+
+constexpr bool IsIdentifierChar(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-';
+}
+constexpr bool IsDigits(std::string_view str)
+{
+    return !str.empty() && std::ranges::all_of(str, [](char c){ return c >= '0' && c <= '9'; });
+}
+
+//Plain loop instead of std::string_view::find, as some compilers fail to evaluate it on array members
+constexpr std::size_t FindChar(std::string_view str, char c, std::size_t start = 0)
+{
+    for (std::size_t i = start; i < str.size(); ++i)
+    {
+        if (str[i] == c)
+        {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+constexpr std::optional<uint32_t> ParseNumber(std::string_view str)
+{
+    if (!IsDigits(str) || (str.size() > 1 && str[0] == '0'))
+    {
+        return std::nullopt;
+    }
+
+    uint64_t result = 0;
+    for (char const c : str)
+    {
+        result = result * 10 + static_cast<uint64_t>(c - '0');
+        if (result > UINT32_MAX)
+        {
+            return std::nullopt;
+        }
+    }
+    return static_cast<uint32_t>(result);
+}
+
+//Verify dot separated identifiers and copy them into a null terminated label
+constexpr bool ParseLabel(std::string_view str, std::array<char, GRUPDATER_TAG_LABEL_SIZE>& label, bool isPrerelease)
+{
+    if (str.empty() || str.size() >= label.size())
+    {
+        return false;
+    }
+
+    std::size_t start = 0;
+    while (start <= str.size())
+    {
+        auto end = impl::FindChar(str, '.', start);
+        if (end == std::string_view::npos)
+        {
+            end = str.size();
+        }
+
+        auto const identifier = str.substr(start, end - start);
+        if (identifier.empty() || !std::ranges::all_of(identifier, IsIdentifierChar))
+        {
+            return false;
+        }
+        //Numeric prerelease identifiers must not include leading zeros
+        if (isPrerelease && IsDigits(identifier) && identifier.size() > 1 && identifier[0] == '0')
+        {
+            return false;
+        }
+
+        start = end + 1;
+    }
+
+    std::ranges::copy(str, label.begin());
+    return true;
+}
+
+}//namespace impl
+
+constexpr TagKey Tag::key() const
+{
+    TagKey result;
+    std::size_t index = 0;
+
+    for (uint32_t const value : {this->major, this->minor, this->patch})
+    {
+        result._data[index++] = static_cast<uint8_t>(value >> 24);
+        result._data[index++] = static_cast<uint8_t>(value >> 16);
+        result._data[index++] = static_cast<uint8_t>(value >> 8);
+        result._data[index++] = static_cast<uint8_t>(value);
+    }
+
+    if (!this->isPrerelease())
+    {
+        result._data[index] = 0x02;
+        return result;
+    }
+    result._data[index++] = 0x01;
+
+    auto const prereleaseLabel = this->getPrerelease();
+    std::size_t start = 0;
+    while (start < prereleaseLabel.size())
+    {
+        auto end = impl::FindChar(prereleaseLabel, '.', start);
+        if (end == std::string_view::npos)
+        {
+            end = prereleaseLabel.size();
+        }
+        auto const identifier = prereleaseLabel.substr(start, end - start);
+
+        if (impl::IsDigits(identifier))
+        {
+            result._data[index++] = 0x01;
+            result._data[index++] = static_cast<uint8_t>(identifier.size());
+            for (char const c : identifier)
+            {
+                result._data[index++] = static_cast<uint8_t>(c);
+            }
+        }
+        else
+        {
+            result._data[index++] = 0x02;
+            for (char const c : identifier)
+            {
+                result._data[index++] = static_cast<uint8_t>(c);
+            }
+            result._data[index++] = 0x00;
+        }
+
+        start = end + 1;
+    }
+    return result;
+}
+
+constexpr std::optional<Tag> ParseTag(std::string_view tag)
+{
+    if (!tag.empty() && tag[0] == 'v')
+    {
+        tag.remove_prefix(1);
+    }
+
+    Tag result{};
+
+    auto const buildPos = impl::FindChar(tag, '+');
+    if (buildPos != std::string_view::npos)
+    {
+        if (!impl::ParseLabel(tag.substr(buildPos + 1), result.build, false))
+        {
+            return std::nullopt;
+        }
+        tag = tag.substr(0, buildPos);
+    }
+
+    auto const prereleasePos = impl::FindChar(tag, '-');
+    if (prereleasePos != std::string_view::npos)
+    {
+        if (!impl::ParseLabel(tag.substr(prereleasePos + 1), result.prerelease, true))
+        {
+            return std::nullopt;
+        }
+        tag = tag.substr(0, prereleasePos);
+    }
+
+    auto const firstDot = impl::FindChar(tag, '.');
+    auto const secondDot = firstDot == std::string_view::npos ? std::string_view::npos : impl::FindChar(tag, '.', firstDot + 1);
+    if (secondDot == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    auto const major = impl::ParseNumber(tag.substr(0, firstDot));
+    auto const minor = impl::ParseNumber(tag.substr(firstDot + 1, secondDot - firstDot - 1));
+    auto const patch = impl::ParseNumber(tag.substr(secondDot + 1));
+    if (!major || !minor || !patch)
+    {
+        return std::nullopt;
+    }
+
+    result.major = *major;
+    result.minor = *minor;
+    result.patch = *patch;
+    return result;
+}
+
+consteval Tag MakeTag(std::string_view tag)
+{
+    auto const result = ParseTag(tag);
+    if (!result)
+    {
+        //Reaching a throw during constant evaluation is a compile error
+        throw "Malformed tag, expected a SemVer 2.0 tag like \"v1.4.2\"";
+    }
+    return *result;
+}
+
+inline namespace literals
+{
+
+[[nodiscard]] consteval Tag operator""_tag(char const* str, std::size_t size)
+{
+    return MakeTag({str, size});
+}
+
+}//namespace literals
 
 }//namespace updater